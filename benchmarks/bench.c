@@ -0,0 +1,300 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * End-to-end benchmark of HttpRequest_fire against an embedded loopback server.
+ *
+ * usage: bench [-c concurrency] [-n requests] [-b response body bytes] [-u request body bytes] [-k 0|1] [-w warmup]
+ *
+ * Reports throughput, latency percentiles, client CPU time per request and allocations per request.
+ * Allocations are counted interposing malloc, calloc and realloc (glibc only): every allocation made by the client
+ * threads is accounted, libcurl ones included.
+ */
+
+#define _GNU_SOURCE
+
+#include <http.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <loopback/loopback_server.h>
+
+struct Options {
+    size_t concurrency;
+    size_t requests;
+    size_t responseSize;
+    size_t requestSize;
+    size_t warmup;
+    bool keepAlive;
+};
+
+struct Worker {
+    pthread_t thread;
+    const struct Options *options;
+    Atom url;
+    size_t requests;
+    uint64_t *latencies;
+    uint64_t cpu;
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    size_t failures;
+};
+
+static __thread uint64_t allocations = 0;
+static __thread uint64_t allocatedBytes = 0;
+
+#ifdef __GLIBC__
+#define COUNTING_ALLOCATIONS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t numberOfMembers, size_t memberSize);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    allocations++;
+    allocatedBytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t numberOfMembers, size_t memberSize) {
+    allocations++;
+    allocatedBytes += numberOfMembers * memberSize;
+    return __libc_calloc(numberOfMembers, memberSize);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocations++;
+    allocatedBytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static uint64_t threadCpuTime(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return ((uint64_t) usage.ru_utime.tv_sec + (uint64_t) usage.ru_stime.tv_sec) * 1000000000 +
+           ((uint64_t) usage.ru_utime.tv_usec + (uint64_t) usage.ru_stime.tv_usec) * 1000;
+}
+
+static bool fire(const struct Worker *worker, TextView requestBody) {
+    const struct Options *options = worker->options;
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(
+            options->requestSize > 0 ? HTTP_METHOD_POST : HTTP_METHOD_GET, worker->url
+    );
+    HttpRequestBuilder_setKeepAlive(builder, options->keepAlive);
+    if (options->requestSize > 0) {
+        Text body = Text_duplicate(requestBody);
+        HttpRequestBuilder_setBody(builder, &body);
+    }
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    if (Http_FireResult_isError(result)) {
+        HttpRequest_delete(request);
+        return false;
+    }
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    const bool succeed = HTTP_STATUS_OK == HttpResponse_getStatus(response) &&
+                         options->responseSize == Text_length(HttpResponse_getBody(response));
+    HttpResponse_delete(response);
+    return succeed;
+}
+
+static void *run(void *argument) {
+    struct Worker *worker = argument;
+    const struct Options *options = worker->options;
+    Text requestBody = Text_withCapacity(options->requestSize);
+    for (size_t i = 0; i < options->requestSize; i++) {
+        requestBody = Text_appendLiteral(&requestBody, "x");
+    }
+
+    for (size_t i = 0; i < options->warmup; i++) {
+        fire(worker, requestBody);
+    }
+
+    const uint64_t cpu = threadCpuTime();
+    const uint64_t allocationsBefore = allocations, allocatedBytesBefore = allocatedBytes;
+    for (size_t i = 0; i < worker->requests; i++) {
+        const uint64_t start = now();
+        worker->failures += fire(worker, requestBody) ? 0 : 1;
+        worker->latencies[i] = now() - start;
+    }
+    worker->allocations = allocations - allocationsBefore;
+    worker->allocatedBytes = allocatedBytes - allocatedBytesBefore;
+    worker->cpu = threadCpuTime() - cpu;
+
+    Text_delete(requestBody);
+    return NULL;
+}
+
+static int compareLatencies(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const uint64_t *sorted, const size_t count, const double quantile) {
+    size_t index = (size_t) (quantile * (double) count);
+    if (index >= count) {
+        index = count - 1;
+    }
+    return (double) sorted[index] / 1000.0;
+}
+
+static size_t parseSize(const char *text) {
+    char *end = NULL;
+    const unsigned long long value = strtoull(text, &end, 10);
+    if (NULL == end || '\0' != *end) {
+        fprintf(stderr, "Invalid number: %s\n", text);
+        exit(EXIT_FAILURE);
+    }
+    return (size_t) value;
+}
+
+static void parseOptions(int argc, char **argv, struct Options *options) {
+    int option;
+    while (-1 != (option = getopt(argc, argv, "c:n:b:u:k:w:"))) {
+        switch (option) {
+            case 'c':
+                options->concurrency = parseSize(optarg);
+                break;
+            case 'n':
+                options->requests = parseSize(optarg);
+                break;
+            case 'b':
+                options->responseSize = parseSize(optarg);
+                break;
+            case 'u':
+                options->requestSize = parseSize(optarg);
+                break;
+            case 'k':
+                options->keepAlive = 0 != parseSize(optarg);
+                break;
+            case 'w':
+                options->warmup = parseSize(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-c concurrency] [-n requests] [-b response body bytes] "
+                                "[-u request body bytes] [-k 0|1] [-w warmup]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (0 == options->concurrency || options->requests < options->concurrency) {
+        fprintf(stderr, "Requests must be at least as many as concurrency, and concurrency greater than 0\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char **argv) {
+    struct Options options = {
+            .concurrency=4, .requests=10000, .responseSize=1024, .requestSize=0, .warmup=100, .keepAlive=true
+    };
+    parseOptions(argc, argv, &options);
+
+    struct LoopbackServer *server = LoopbackServer_start(options.keepAlive);
+    if (NULL == server) {
+        fprintf(stderr, "Unable to start the loopback server\n");
+        return EXIT_FAILURE;
+    }
+
+    Http_initialize();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/bytes/%zu", LoopbackServer_getPort(server), options.responseSize);
+    const Atom atom = Atom_fromLiteral(url);
+
+    struct Worker *workers = calloc(options.concurrency, sizeof(*workers));
+    uint64_t *latencies = calloc(options.requests, sizeof(*latencies));
+    if (NULL == workers || NULL == latencies) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0, offset = 0; i < options.concurrency; i++) {
+        workers[i].options = &options;
+        workers[i].url = atom;
+        workers[i].requests = options.requests / options.concurrency + (i < options.requests % options.concurrency);
+        workers[i].latencies = latencies + offset;
+        offset += workers[i].requests;
+    }
+
+    const uint64_t start = now();
+    for (size_t i = 0; i < options.concurrency; i++) {
+        if (0 != pthread_create(&workers[i].thread, NULL, run, &workers[i])) {
+            fprintf(stderr, "Unable to start worker\n");
+            return EXIT_FAILURE;
+        }
+    }
+    uint64_t cpu = 0, allocationsTotal = 0, allocatedBytesTotal = 0;
+    size_t failures = 0;
+    for (size_t i = 0; i < options.concurrency; i++) {
+        pthread_join(workers[i].thread, NULL);
+        cpu += workers[i].cpu;
+        allocationsTotal += workers[i].allocations;
+        allocatedBytesTotal += workers[i].allocatedBytes;
+        failures += workers[i].failures;
+    }
+    const double elapsed = (double) (now() - start) / 1e9;
+    const double requests = (double) options.requests;
+
+    qsort(latencies, options.requests, sizeof(*latencies), compareLatencies);
+    printf("requests:     %zu (%zu failed), concurrency %zu, response body %zu bytes, request body %zu bytes, "
+           "keep-alive %s, %zu connections\n",
+           options.requests, failures, options.concurrency, options.responseSize, options.requestSize,
+           options.keepAlive ? "on" : "off", LoopbackServer_getConnections(server));
+    printf("throughput:   %.1f req/s\n", requests / elapsed);
+    printf("latency:      p50 %.1fus, p99 %.1fus, p999 %.1fus, max %.1fus\n",
+           percentile(latencies, options.requests, 0.5), percentile(latencies, options.requests, 0.99),
+           percentile(latencies, options.requests, 0.999), (double) latencies[options.requests - 1] / 1000.0);
+    printf("cpu:          %.1fus/req (client threads)\n", (double) cpu / 1000.0 / requests);
+#ifdef COUNTING_ALLOCATIONS
+    printf("allocations:  %.1f/req, %.1f bytes/req\n",
+           (double) allocationsTotal / requests, (double) allocatedBytesTotal / requests);
+#else
+    (void) allocatedBytesTotal;
+    (void) allocationsTotal;
+    printf("allocations:  not available\n");
+#endif
+
+    free(latencies);
+    free(workers);
+    Http_terminate();
+    LoopbackServer_stop(server);
+    return 0 == failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
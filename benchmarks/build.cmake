@@ -0,0 +1,8 @@
+add_executable(text-quoted-benchmark ${CMAKE_CURRENT_LIST_DIR}/text_quoted.c)
+target_link_libraries(text-quoted-benchmark PRIVATE text)
+
+add_executable(bench ${CMAKE_CURRENT_LIST_DIR}/bench.c)
+target_link_libraries(bench PRIVATE http loopback-server Threads::Threads)
+
+add_executable(microbenchmarks ${CMAKE_CURRENT_LIST_DIR}/microbenchmarks.c)
+target_link_libraries(microbenchmarks PRIVATE text atom alligator)
@@ -0,0 +1,329 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmarks of the dependencies sitting on the request path: Text, Atom and Alligator.
+ *
+ * usage: microbenchmarks [min milliseconds per run [runs [threadCache]]]
+ *
+ * Every benchmark is calibrated doubling its iterations until a run lasts at least the given time (default 50ms),
+ * then it is run the given number of times (default 5).
+ * Results are printed one per line as JSON objects, so that runs can be compared across commits:
+ * {"benchmark": "...", "iterations": N, "runs": R, "min_ns_per_op": ..., "median_ns_per_op": ...}
+ *
+ * Benchmarks leaving state behind, such as atoms that are never freed, run in a process of their own so that they do
+ * not skew the following ones.
+ * The allocator can only be installed before anything is allocated, so the benchmarks of the thread cache run in a
+ * new instance of this program, started with threadCache as third argument: there only the Alligator benchmarks run.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <atom/atom.h>
+#include <text/text.h>
+#include <alligator/alligator.h>
+
+#define MAX_RUNS    32
+
+typedef void (*Body)(size_t iterations, void *context);
+
+struct Benchmark {
+    const char *name;
+    Body body;
+    void *context;
+};
+
+static volatile size_t sink = 0;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static double measure(const struct Benchmark *benchmark, const size_t iterations) {
+    const double start = now();
+    benchmark->body(iterations, benchmark->context);
+    return now() - start;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    const double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(const struct Benchmark *benchmark, const double minNanoseconds, const size_t runs) {
+    size_t iterations = 1;
+    while (measure(benchmark, iterations) < minNanoseconds && iterations < SIZE_MAX / 2) {
+        iterations *= 2;
+    }
+
+    double nanosecondsPerOp[MAX_RUNS];
+    for (size_t i = 0; i < runs; i++) {
+        nanosecondsPerOp[i] = measure(benchmark, iterations) / (double) iterations;
+    }
+    qsort(nanosecondsPerOp, runs, sizeof(nanosecondsPerOp[0]), compareDoubles);
+    printf("{\"benchmark\": \"%s\", \"iterations\": %zu, \"runs\": %zu, \"min_ns_per_op\": %.3f, "
+           "\"median_ns_per_op\": %.3f}\n",
+           benchmark->name, iterations, runs, nanosecondsPerOp[0], nanosecondsPerOp[runs / 2]);
+    fflush(stdout);
+}
+
+/*
+ * Runs the benchmark in a child process, after setup (if not NULL) has been called there with the benchmark context.
+ *
+ * @return false if the child did not exit successfully.
+ */
+static bool runIsolated(const struct Benchmark *benchmark, void (*setup)(void *context), const double minNanoseconds,
+                        const size_t runs) {
+    fflush(stdout);
+    const pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return false;
+    }
+    if (0 == child) {
+        if (NULL != setup) {
+            setup(benchmark->context);
+        }
+        run(benchmark, minNanoseconds, runs);
+        exit(EXIT_SUCCESS);
+    }
+    int status = 0;
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status)) {
+        fprintf(stderr, "%s: benchmark process failed\n", benchmark->name);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Text
+ */
+static void textAppendFormat(size_t iterations, void *context) {
+    (void) context;
+    Text text = Text_new();
+    for (size_t i = 0; i < iterations; i++) {
+        if (Text_length(text) > 4096) {
+            Text_clear(text);
+        }
+        text = Text_appendFormat(&text, "%zu: %s,", i, "value");
+    }
+    sink += Text_length(text);
+    Text_delete(text);
+}
+
+static void textInsertBytes(size_t iterations, void *context) {
+    (void) context;
+    Text text = Text_withCapacity(1024 + 16);
+    for (size_t i = 0; i < 1024; i++) {
+        text = Text_appendLiteral(&text, "x");
+    }
+    for (size_t i = 0; i < iterations; i++) {
+        text = Text_insertBytes(&text, 512, "12345678", 8);
+        Text_eraseRange(text, 512, 520);
+    }
+    sink += Text_length(text);
+    Text_delete(text);
+}
+
+static void textQuoted(size_t iterations, void *context) {
+    const char *input = context;
+    const size_t size = strlen(input);
+    for (size_t i = 0; i < iterations; i++) {
+        Text text = Text_quoted(input, size);
+        sink += Text_length(text);
+        Text_delete(text);
+    }
+}
+
+static void textExpandToFit(size_t iterations, void *context) {
+    const size_t target = *(const size_t *) context;
+    for (size_t i = 0; i < iterations; i++) {
+        Text text = Text_new();
+        for (size_t length = 64; length <= target; length *= 2) {
+            text = Text_expandToFit(&text, length);
+        }
+        sink += Text_capacity(text);
+        Text_delete(text);
+    }
+}
+
+/*
+ * Atom
+ */
+struct AtomKeys {
+    char (*keys)[32];
+    size_t count;
+    size_t next;
+};
+
+static void fillKeys(struct AtomKeys *keys, const char *prefix, const size_t count) {
+    keys->keys = Option_unwrap(Alligator_malloc(count * sizeof(keys->keys[0])));
+    keys->count = count;
+    keys->next = 0;
+    for (size_t i = 0; i < count; i++) {
+        snprintf(keys->keys[i], sizeof(keys->keys[i]), "%s/%zu", prefix, i);
+    }
+}
+
+static void fillTable(void *context) {
+    const struct AtomKeys *keys = context;
+    for (size_t i = 0; i < keys->count; i++) {
+        sink += (size_t) Atom_fromLiteral(keys->keys[i]);
+    }
+}
+
+static void atomHit(size_t iterations, void *context) {
+    struct AtomKeys *keys = context;
+    for (size_t i = 0; i < iterations; i++) {
+        sink += (size_t) Atom_fromLiteral(keys->keys[i % keys->count]);
+    }
+}
+
+// Misses are looked up without being interned, so that the table stays at its fill level.
+static void atomMiss(size_t iterations, void *context) {
+    struct AtomKeys *keys = context;
+    char key[48];
+    for (size_t i = 0; i < iterations; i++) {
+        const int length = snprintf(key, sizeof(key), "miss/%zu", keys->next++);
+        sink += (size_t) Atom_find(key, (size_t) length);
+    }
+}
+
+/*
+ * Alligator
+ */
+static void alligatorMallocFree(size_t iterations, void *context) {
+    const size_t size = *(const size_t *) context;
+    for (size_t i = 0; i < iterations; i++) {
+        void *memory = Option_unwrap(Alligator_malloc(size));
+        sink += (size_t) memory;
+        Alligator_free(memory);
+    }
+}
+
+static void runAlligator(const char *allocator, const double minNanoseconds, const size_t runs) {
+    size_t sizes[] = {16, 256, 4096, 65536};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "Alligator_malloc+free/%s%zu", allocator, sizes[i]);
+        const struct Benchmark benchmark = {name, alligatorMallocFree, &sizes[i]};
+        run(&benchmark, minNanoseconds, runs);
+    }
+}
+
+/*
+ * Runs this program again with threadCache as third argument and waits for it.
+ *
+ * @return false if the new instance did not exit successfully.
+ */
+static bool runThreadCache(char *program, const double minNanoseconds, const size_t runs) {
+    char milliseconds[32], runsArgument[32];
+    snprintf(milliseconds, sizeof(milliseconds), "%f", minNanoseconds / 1e6);
+    snprintf(runsArgument, sizeof(runsArgument), "%zu", runs);
+    char *arguments[] = {program, milliseconds, runsArgument, "threadCache", NULL};
+
+    fflush(stdout);
+    const pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return false;
+    }
+    if (0 == child) {
+        execvp(program, arguments);
+        perror(program);
+        _exit(EXIT_FAILURE);
+    }
+    int status = 0;
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status)) {
+        fprintf(stderr, "Alligator_malloc+free/threadCache: benchmark process failed\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const double minNanoseconds = (argc > 1 ? strtod(argv[1], NULL) : 50.0) * 1e6;
+    size_t runs = argc > 2 ? strtoul(argv[2], NULL, 10) : 5;
+    if (runs < 1 || runs > MAX_RUNS) {
+        fprintf(stderr, "runs must be between 1 and %d\n", MAX_RUNS);
+        return EXIT_FAILURE;
+    }
+    if (argc > 3) {
+        if (0 != strcmp(argv[3], "threadCache")) {
+            fprintf(stderr, "unknown allocator: %s\n", argv[3]);
+            return EXIT_FAILURE;
+        }
+        Alligator_setAllocator(Alligator_threadCacheAllocator());
+        runAlligator("threadCache/", minNanoseconds, runs);
+        return EXIT_SUCCESS;
+    }
+
+    char quotedInput[1025];
+    for (size_t i = 0; i < sizeof(quotedInput) - 1; i++) {
+        quotedInput[i] = 0 == (i + 1) % 32 ? '"' : (char) ('a' + i % 26);
+    }
+    quotedInput[sizeof(quotedInput) - 1] = '\0';
+
+    size_t expandTarget = 1024 * 1024;
+    const struct Benchmark textBenchmarks[] = {
+            {"Text_appendFormat",          textAppendFormat, NULL},
+            {"Text_insertBytes/1KiB",      textInsertBytes,  NULL},
+            {"Text_quoted/1KiB",           textQuoted,       quotedInput},
+            {"Text_expandToFit/1MiB",      textExpandToFit,  &expandTarget},
+    };
+    for (size_t i = 0; i < sizeof(textBenchmarks) / sizeof(textBenchmarks[0]); i++) {
+        run(&textBenchmarks[i], minNanoseconds, runs);
+    }
+
+    // atoms are never freed, every fill level is benchmarked on a table of its own
+    bool succeeded = true;
+    const size_t fillLevels[] = {1000, 10000, 100000};
+    for (size_t level = 0; level < sizeof(fillLevels) / sizeof(fillLevels[0]); level++) {
+        struct AtomKeys keys;
+        fillKeys(&keys, "hit", fillLevels[level]);
+        char hitName[64], missName[64];
+        snprintf(hitName, sizeof(hitName), "Atom_fromLiteral/hit/%zu", fillLevels[level]);
+        snprintf(missName, sizeof(missName), "Atom_find/miss/%zu", fillLevels[level]);
+        const struct Benchmark hit = {hitName, atomHit, &keys}, miss = {missName, atomMiss, &keys};
+        succeeded = runIsolated(&hit, fillTable, minNanoseconds, runs) && succeeded;
+        succeeded = runIsolated(&miss, fillTable, minNanoseconds, runs) && succeeded;
+        Alligator_free(keys.keys);
+    }
+
+    runAlligator("", minNanoseconds, runs);
+    succeeded = runThreadCache(argv[0], minNanoseconds, runs) && succeeded;
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,156 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compares Text_quoted against the previous byte-at-a-time implementation.
+ *
+ * usage: text-quoted-benchmark [size [iterations]]
+ */
+
+#include <time.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <text/text.h>
+
+typedef Text (*QuoteFn)(const void *bytes, size_t size);
+
+static Text legacyQuoted(const void *bytes, const size_t size) {
+    const char *data = bytes;
+    Text text = Text_withCapacity(size + size / 3);
+
+    text = Text_appendBytes(&text, "\"", 1);
+    for (size_t i = 0; i < size; i++) {
+        switch (*data) {
+            case '"':
+                text = Text_appendBytes(&text, "\\\"", 2);
+                break;
+            case '\\':
+                text = Text_appendBytes(&text, "\\\\", 2);
+                break;
+            case '/':
+                text = Text_appendBytes(&text, "\\/", 2);
+                break;
+            case '\b':
+                text = Text_appendBytes(&text, "\\b", 2);
+                break;
+            case '\f':
+                text = Text_appendBytes(&text, "\\f", 2);
+                break;
+            case '\n':
+                text = Text_appendBytes(&text, "\\n", 2);
+                break;
+            case '\r':
+                text = Text_appendBytes(&text, "\\r", 2);
+                break;
+            case '\t':
+                text = Text_appendBytes(&text, "\\t", 2);
+                break;
+            default:
+                if (isprint(*data)) {
+                    text = Text_appendFormat(&text, "%c", *data);
+                } else {
+                    text = Text_appendFormat(&text, "\\u%04hhx", *data);
+                }
+                break;
+        }
+        data++;
+    }
+    text = Text_appendBytes(&text, "\"", 1);
+
+    return text;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double measure(QuoteFn quote, const char *input, const size_t size, const size_t iterations) {
+    size_t checksum = 0;
+    const double start = now();
+    for (size_t i = 0; i < iterations; i++) {
+        Text text = quote(input, size);
+        checksum += Text_length(text);
+        Text_delete(text);
+    }
+    const double elapsed = now() - start;
+    if (0 == checksum) {
+        fputs("unexpected empty output\n", stderr);
+    }
+    return elapsed;
+}
+
+static void fill(char *buffer, const size_t size, const size_t escapeEvery) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789,.:";
+    static const char escapes[] = "\"\\/\n\t";
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = (0 == escapeEvery || (i + 1) % escapeEvery)
+                    ? alphabet[i % (sizeof(alphabet) - 1)]
+                    : escapes[(i / escapeEvery) % (sizeof(escapes) - 1)];
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 64 * 1024;
+    const size_t iterations = argc > 2 ? strtoul(argv[2], NULL, 10) : 200;
+    const size_t densities[] = {0, 256, 32, 4};
+    char *input = malloc(size ? size : 1);
+
+    if (NULL == input) {
+        fputs("Out of memory\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-14s %12s %12s %12s %9s\n", "escape every", "legacy MB/s", "current MB/s", "ns/byte", "speedup");
+    for (size_t i = 0; i < sizeof(densities) / sizeof(densities[0]); i++) {
+        fill(input, size, densities[i]);
+
+        Text expected = legacyQuoted(input, size), actual = Text_quoted(input, size);
+        if (!Text_equals(expected, actual)) {
+            fputs("Text_quoted output differs from the legacy implementation\n", stderr);
+            return EXIT_FAILURE;
+        }
+        Text_delete(expected);
+        Text_delete(actual);
+
+        const double legacy = measure(legacyQuoted, input, size, iterations);
+        const double current = measure(Text_quoted, input, size, iterations);
+        const double megabytes = (double) size * iterations / (1024.0 * 1024.0);
+        char label[32];
+        snprintf(label, sizeof(label), densities[i] ? "%zu bytes" : "never", densities[i]);
+        printf("%-14s %12.1f %12.1f %12.3f %8.1fx\n",
+               label, megabytes / legacy, megabytes / current,
+               current * 1e9 / ((double) size * iterations), legacy / current);
+    }
+
+    free(input);
+    return EXIT_SUCCESS;
+}
@@ -26,33 +26,635 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <panic/panic.h>
 #include "alligator.h"
 #include "alligator_config.h"
 
+static __thread struct Alligator_Counters counters = {0};
+
+/*
+ * System allocator
+ */
+static void *systemMalloc(void *context, const size_t size) {
+    (void) context;
+    return __Alligator_malloc(size);
+}
+
+static void *systemCalloc(void *context, const size_t numberOfMembers, const size_t memberSize) {
+    (void) context;
+    return __Alligator_calloc(numberOfMembers, memberSize);
+}
+
+static void *systemRealloc(void *context, void *ptr, const size_t newSize) {
+    (void) context;
+    return __Alligator_realloc(ptr, newSize);
+}
+
+static void systemFree(void *context, void *ptr) {
+    (void) context;
+    __Alligator_free(ptr);
+}
+
+#if (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L) || (defined(__cplusplus) && __cplusplus >= 201103L)
+
+static void *systemAlignedAlloc(void *context, const size_t alignment, const size_t size) {
+    (void) context;
+    return __Alligator_aligned_alloc(alignment, size);
+}
+
+#else
+
+#define systemAlignedAlloc NULL
+
+#endif
+
+static struct Alligator_Allocator allocator = {
+        .malloc=systemMalloc,
+        .calloc=systemCalloc,
+        .realloc=systemRealloc,
+        .free=systemFree,
+        .aligned_alloc=systemAlignedAlloc,
+        .context=NULL,
+};
+
+/*
+ * Thread cache allocator
+ *
+ * Every block is preceded by a header holding its usable size and the address returned by the system allocator,
+ * which differs from the header address only for aligned blocks. Blocks up to ALLIGATOR_THREAD_CACHE_MAX_SIZE are
+ * rounded up to their size class. While cached, the first word of the block links to the next cached block of the
+ * same class.
+ */
+#define THREAD_CACHE_MIN_SIZE   16
+#define THREAD_CACHE_CLASSES    9
+
+struct Header {
+    void *base;
+    size_t size;
+};
+
+struct ThreadCache {
+    void *heads[THREAD_CACHE_CLASSES];
+    size_t lengths[THREAD_CACHE_CLASSES];
+    int registered;
+};
+
+static __thread struct ThreadCache threadCache = {{0}, {0}, 0};
+static pthread_key_t threadCacheKey;
+static pthread_once_t threadCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+static size_t threadCache_classOf(const size_t size) {
+#if defined(__GNUC__) || defined(__clang__)
+    if (size <= THREAD_CACHE_MIN_SIZE) {
+        return 0;
+    }
+    // ceil(log2(size)) - log2(THREAD_CACHE_MIN_SIZE)
+    return (size_t) (sizeof(unsigned long) * CHAR_BIT - __builtin_clzl((unsigned long) size - 1)) - 4;
+#else
+    size_t sizeClass = 0;
+    for (size_t classSize = THREAD_CACHE_MIN_SIZE; classSize < size; classSize <<= 1) {
+        sizeClass++;
+    }
+    return sizeClass;
+#endif
+}
+
+static size_t threadCache_sizeOf(const size_t sizeClass) {
+    return (size_t) THREAD_CACHE_MIN_SIZE << sizeClass;
+}
+
+static struct Header *threadCache_headerOf(void *ptr) {
+    return (struct Header *) ptr - 1;
+}
+
+static int threadCache_isCacheable(const struct Header *header) {
+    return header->base == header && header->size <= ALLIGATOR_THREAD_CACHE_MAX_SIZE;
+}
+
+static void threadCache_flush(void *cache) {
+    struct ThreadCache *self = cache;
+    for (size_t sizeClass = 0; sizeClass < THREAD_CACHE_CLASSES; sizeClass++) {
+        while (self->heads[sizeClass]) {
+            void *block = self->heads[sizeClass];
+            memcpy(&self->heads[sizeClass], block, sizeof(void *));
+            __Alligator_free(threadCache_headerOf(block));
+        }
+        self->lengths[sizeClass] = 0;
+    }
+    self->registered = 0;
+}
+
+static void threadCache_createKey(void) {
+    pthread_key_create(&threadCacheKey, threadCache_flush);
+}
+
+static void *threadCache_malloc(void *context, const size_t size) {
+    (void) context;
+    struct Header *header = NULL;
+
+    if (size <= ALLIGATOR_THREAD_CACHE_MAX_SIZE) {
+        const size_t sizeClass = threadCache_classOf(size);
+        void *block = threadCache.heads[sizeClass];
+        if (block) {
+            memcpy(&threadCache.heads[sizeClass], block, sizeof(void *));
+            threadCache.lengths[sizeClass]--;
+            return block;
+        }
+        header = __Alligator_malloc(sizeof(*header) + threadCache_sizeOf(sizeClass));
+        if (header) {
+            header->size = threadCache_sizeOf(sizeClass);
+        }
+    } else if (size <= SIZE_MAX - sizeof(*header)) {
+        header = __Alligator_malloc(sizeof(*header) + size);
+        if (header) {
+            header->size = size;
+        }
+    }
+
+    if (!header) {
+        return NULL;
+    }
+    header->base = header;
+    return header + 1;
+}
+
+static void *threadCache_calloc(void *context, const size_t numberOfMembers, const size_t memberSize) {
+    if (memberSize > 0 && numberOfMembers > SIZE_MAX / memberSize) {
+        return NULL;
+    }
+    void *memory = threadCache_malloc(context, numberOfMembers * memberSize);
+    if (memory) {
+        memset(memory, 0, numberOfMembers * memberSize);
+    }
+    return memory;
+}
+
+static void threadCache_free(void *context, void *ptr) {
+    (void) context;
+    if (!ptr) {
+        return;
+    }
+
+    struct Header *header = threadCache_headerOf(ptr);
+    const size_t sizeClass = threadCache_classOf(header->size);
+    if (threadCache_isCacheable(header) && threadCache.lengths[sizeClass] < ALLIGATOR_THREAD_CACHE_DEPTH) {
+        if (!threadCache.registered) {
+            pthread_once(&threadCacheKeyOnce, threadCache_createKey);
+            pthread_setspecific(threadCacheKey, &threadCache);
+            threadCache.registered = 1;
+        }
+        memcpy(ptr, &threadCache.heads[sizeClass], sizeof(void *));
+        threadCache.heads[sizeClass] = ptr;
+        threadCache.lengths[sizeClass]++;
+    } else {
+        __Alligator_free(header->base);
+    }
+}
+
+static void *threadCache_realloc(void *context, void *ptr, const size_t newSize) {
+    if (!ptr) {
+        return threadCache_malloc(context, newSize);
+    }
+
+    struct Header *header = threadCache_headerOf(ptr);
+    if (threadCache_isCacheable(header) && newSize <= header->size) {
+        return ptr;
+    }
+    if (header->base == header && header->size > ALLIGATOR_THREAD_CACHE_MAX_SIZE &&
+        newSize > ALLIGATOR_THREAD_CACHE_MAX_SIZE) {
+        if (newSize > SIZE_MAX - sizeof(*header)) {
+            return NULL;
+        }
+        header = __Alligator_realloc(header, sizeof(*header) + newSize);
+        if (!header) {
+            return NULL;
+        }
+        header->base = header;
+        header->size = newSize;
+        return header + 1;
+    }
+
+    void *memory = threadCache_malloc(context, newSize);
+    if (memory) {
+        memcpy(memory, ptr, header->size < newSize ? header->size : newSize);
+        threadCache_free(context, ptr);
+    }
+    return memory;
+}
+
+static void *threadCache_alignedAlloc(void *context, const size_t alignment, const size_t size) {
+    (void) context;
+    if (0 == alignment || 0 != (alignment & (alignment - 1)) ||
+        size > SIZE_MAX - sizeof(struct Header) - alignment) {
+        return NULL;
+    }
+
+    char *base = __Alligator_malloc(sizeof(struct Header) + alignment + size);
+    if (!base) {
+        return NULL;
+    }
+    const uintptr_t start = (uintptr_t) (base + sizeof(struct Header));
+    void *memory = (void *) ((start + alignment - 1) & ~(uintptr_t) (alignment - 1));
+    struct Header *header = threadCache_headerOf(memory);
+    header->base = base;
+    header->size = size;
+    return memory;
+}
+
+/*
+ * Tracking allocator
+ *
+ * Every thread counts the allocations it performs and the ones it frees in a tracker of its own, trackers are
+ * never freed and are handed over to the next thread in need of one when their thread exits.
+ * Counters of trackers have a single writer, the owner thread, and are read by snapshots without locking.
+ * Live and peak bytes are shared by all threads instead, so that memory freed by a thread other than the one that
+ * allocated it is accounted exactly.
+ *
+ * Tags are assigned a slot on their first allocation, slot 0 holds untagged allocations and the ones exceeding
+ * ALLIGATOR_MAX_TAGS. Blocks remember their slot, so that they are accounted to it until they are freed.
+ */
+struct TrackingHeader {
+    size_t slot;
+    size_t size;
+};
+
+struct TagCounters {
+    size_t allocations;
+    size_t frees;
+};
+
+struct SharedCounters {
+    const char *tag;
+    size_t liveBytes;
+    size_t peakBytes;
+};
+
+struct SizeClassCounters {
+    size_t allocations;
+    size_t frees;
+    size_t allocatedBytes;
+    size_t freedBytes;
+};
+
+struct Tracker {
+    struct Tracker *next;
+    int owned;
+    struct TagCounters tags[ALLIGATOR_MAX_TAGS];
+    struct SizeClassCounters sizeClasses[ALLIGATOR_SIZE_CLASSES];
+};
+
+static __thread const char *currentTag = NULL;
+static __thread struct Tracker *localTracker = NULL;
+static struct Tracker *trackers = NULL;
+static pthread_key_t trackerKey;
+static pthread_once_t trackerKeyOnce = PTHREAD_ONCE_INIT;
+
+static struct SharedCounters sharedTags[ALLIGATOR_MAX_TAGS];
+static struct SharedCounters sharedTotal;
+
+static uint64_t tracking_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+static void tracking_add(size_t *counter, const size_t value) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static size_t tracking_read(const size_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void tracking_grow(struct SharedCounters *counters, const size_t size) {
+    const size_t live = __atomic_add_fetch(&counters->liveBytes, size, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&counters->peakBytes, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&counters->peakBytes, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void tracking_shrink(struct SharedCounters *counters, const size_t size) {
+    __atomic_sub_fetch(&counters->liveBytes, size, __ATOMIC_RELAXED);
+}
+
+static int tracking_sameTag(const char *a, const char *b) {
+    return a == b || (a && b && 0 == strcmp(a, b));
+}
+
+static void tracking_releaseTracker(void *tracker) {
+    __atomic_store_n(&((struct Tracker *) tracker)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void tracking_createKey(void) {
+    pthread_key_create(&trackerKey, tracking_releaseTracker);
+}
+
+static struct Tracker *tracking_acquireTracker(void) {
+    pthread_once(&trackerKeyOnce, tracking_createKey);
+    struct Tracker *tracker = __atomic_load_n(&trackers, __ATOMIC_ACQUIRE);
+    for (; NULL != tracker; tracker = tracker->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&tracker->owned, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (NULL == tracker) {
+        // trackers are bookkeeping of the tracking allocator itself, they are not accounted
+        tracker = __Alligator_calloc(1, sizeof(*tracker));
+        if (NULL == tracker) {
+            return NULL;
+        }
+        tracker->owned = 1;
+        tracker->next = __atomic_load_n(&trackers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&trackers, &tracker->next, tracker, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    pthread_setspecific(trackerKey, tracker);
+    return tracker;
+}
+
+static size_t tracking_slotOf(const char *tag) {
+    if (NULL == tag) {
+        return 0;
+    }
+    for (size_t i = 1; i < ALLIGATOR_MAX_TAGS; i++) {
+        const char *slot = __atomic_load_n(&sharedTags[i].tag, __ATOMIC_ACQUIRE);
+        if (NULL == slot &&
+            __atomic_compare_exchange_n(&sharedTags[i].tag, &slot, tag, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return i;
+        }
+        if (tracking_sameTag(slot, tag)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+static size_t tracking_sizeClassOf(const size_t size) {
+    const size_t sizeClass = threadCache_classOf(size);
+    return sizeClass < ALLIGATOR_SIZE_CLASSES ? sizeClass : ALLIGATOR_SIZE_CLASSES - 1;
+}
+
+static void tracking_onAllocate(const struct TrackingHeader *header) {
+    if (NULL == localTracker && NULL == (localTracker = tracking_acquireTracker())) {
+        return;
+    }
+    tracking_add(&localTracker->tags[header->slot].allocations, 1);
+    tracking_grow(&sharedTags[header->slot], header->size);
+    tracking_grow(&sharedTotal, header->size);
+    struct SizeClassCounters *sizeClass = &localTracker->sizeClasses[tracking_sizeClassOf(header->size)];
+    tracking_add(&sizeClass->allocations, 1);
+    tracking_add(&sizeClass->allocatedBytes, header->size);
+}
+
+static void tracking_onFree(const struct TrackingHeader *header) {
+    if (NULL == localTracker && NULL == (localTracker = tracking_acquireTracker())) {
+        return;
+    }
+    tracking_add(&localTracker->tags[header->slot].frees, 1);
+    tracking_shrink(&sharedTags[header->slot], header->size);
+    tracking_shrink(&sharedTotal, header->size);
+    struct SizeClassCounters *sizeClass = &localTracker->sizeClasses[tracking_sizeClassOf(header->size)];
+    tracking_add(&sizeClass->frees, 1);
+    tracking_add(&sizeClass->freedBytes, header->size);
+}
+
+static void *tracking_malloc(void *context, const size_t size) {
+    const struct Alligator_Allocator *parent = context;
+    if (size > SIZE_MAX - sizeof(struct TrackingHeader)) {
+        return NULL;
+    }
+    struct TrackingHeader *header = parent->malloc(parent->context, sizeof(*header) + size);
+    if (!header) {
+        return NULL;
+    }
+    header->slot = tracking_slotOf(currentTag);
+    header->size = size;
+    tracking_onAllocate(header);
+    return header + 1;
+}
+
+static void *tracking_calloc(void *context, const size_t numberOfMembers, const size_t memberSize) {
+    const struct Alligator_Allocator *parent = context;
+    if (memberSize > 0 && numberOfMembers > (SIZE_MAX - sizeof(struct TrackingHeader)) / memberSize) {
+        return NULL;
+    }
+    struct TrackingHeader *header = parent->calloc(
+            parent->context, 1, sizeof(*header) + numberOfMembers * memberSize
+    );
+    if (!header) {
+        return NULL;
+    }
+    header->slot = tracking_slotOf(currentTag);
+    header->size = numberOfMembers * memberSize;
+    tracking_onAllocate(header);
+    return header + 1;
+}
+
+static void *tracking_realloc(void *context, void *ptr, const size_t newSize) {
+    const struct Alligator_Allocator *parent = context;
+    if (!ptr) {
+        return tracking_malloc(context, newSize);
+    }
+    if (newSize > SIZE_MAX - sizeof(struct TrackingHeader)) {
+        return NULL;
+    }
+
+    // a reallocation keeps the tag of the original allocation
+    struct TrackingHeader previous = *((struct TrackingHeader *) ptr - 1);
+    struct TrackingHeader *header = parent->realloc(
+            parent->context, (struct TrackingHeader *) ptr - 1, sizeof(*header) + newSize
+    );
+    if (!header) {
+        return NULL;
+    }
+    header->size = newSize;
+    tracking_onFree(&previous);
+    tracking_onAllocate(header);
+    return header + 1;
+}
+
+static void tracking_free(void *context, void *ptr) {
+    const struct Alligator_Allocator *parent = context;
+    if (!ptr) {
+        return;
+    }
+    struct TrackingHeader *header = (struct TrackingHeader *) ptr - 1;
+    tracking_onFree(header);
+    parent->free(parent->context, header);
+}
+
+/*
+ * Public API
+ *
+ * Blocks can only be freed by the allocator that allocated them, which is why the allocator can no longer be changed
+ * once memory has been allocated through it.
+ */
+static int allocated = 0;
+
+static void markAllocated(void) {
+    if (!__atomic_load_n(&allocated, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&allocated, 1, __ATOMIC_RELAXED);
+    }
+}
+
 #if (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L) || (defined(__cplusplus) && __cplusplus >= 201103L)
 
 Option Alligator_aligned_alloc(size_t alignment, size_t size) {
-    void *memory = __Alligator_aligned_alloc(alignment, size);
+    void *memory = allocator.aligned_alloc ? allocator.aligned_alloc(allocator.context, alignment, size) : NULL;
+    if (memory) {
+        markAllocated();
+        __Alligator_onAllocate(counters, size);
+    }
     return memory ? Option_some(memory) : None;
 }
 
 #endif
 
 Option Alligator_malloc(const size_t size) {
-    void *memory = __Alligator_malloc(size);
+    void *memory = allocator.malloc(allocator.context, size);
+    if (memory) {
+        markAllocated();
+        __Alligator_onAllocate(counters, size);
+    }
     return memory ? Option_some(memory) : None;
 }
 
 Option Alligator_calloc(const size_t numberOfMembers, const size_t memberSize) {
-    void *memory = __Alligator_calloc(numberOfMembers, memberSize);
+    void *memory = allocator.calloc(allocator.context, numberOfMembers, memberSize);
+    if (memory) {
+        markAllocated();
+        __Alligator_onAllocate(counters, numberOfMembers * memberSize);
+    }
     return memory ? Option_some(memory) : None;
 }
 
 Option Alligator_realloc(void *ptr, size_t newSize) {
-    void *memory = __Alligator_realloc(ptr, newSize);
+    void *memory = allocator.realloc(allocator.context, ptr, newSize);
+    if (memory) {
+        markAllocated();
+        if (ptr) {
+            __Alligator_onReallocate(counters, newSize);
+        } else {
+            __Alligator_onAllocate(counters, newSize);
+        }
+    }
     return memory ? Option_some(memory) : None;
 }
 
 void Alligator_free(void *ptr) {
-    __Alligator_free(ptr);
+    if (ptr) {
+        __Alligator_onFree(counters);
+    }
+    allocator.free(allocator.context, ptr);
+}
+
+struct Alligator_Counters Alligator_getCounters(void) {
+    return counters;
+}
+
+struct Alligator_Allocator Alligator_systemAllocator(void) {
+    return (struct Alligator_Allocator) {
+            .malloc=systemMalloc,
+            .calloc=systemCalloc,
+            .realloc=systemRealloc,
+            .free=systemFree,
+            .aligned_alloc=systemAlignedAlloc,
+            .context=NULL,
+    };
+}
+
+struct Alligator_Allocator Alligator_threadCacheAllocator(void) {
+    return (struct Alligator_Allocator) {
+            .malloc=threadCache_malloc,
+            .calloc=threadCache_calloc,
+            .realloc=threadCache_realloc,
+            .free=threadCache_free,
+            .aligned_alloc=threadCache_alignedAlloc,
+            .context=NULL,
+    };
+}
+
+struct Alligator_Allocator Alligator_getAllocator(void) {
+    return allocator;
+}
+
+struct Alligator_Allocator Alligator_setAllocator(const struct Alligator_Allocator newAllocator) {
+    assert(newAllocator.malloc);
+    assert(newAllocator.calloc);
+    assert(newAllocator.realloc);
+    assert(newAllocator.free);
+    if (__atomic_load_n(&allocated, __ATOMIC_RELAXED)) {
+        Panic_terminate("The allocator can not be changed once memory has been allocated\n");
+    }
+    const struct Alligator_Allocator previous = allocator;
+    allocator = newAllocator;
+    return previous;
+}
+
+struct Alligator_Allocator Alligator_trackingAllocator(const struct Alligator_Allocator *parent) {
+    assert(parent);
+    return (struct Alligator_Allocator) {
+            .malloc=tracking_malloc,
+            .calloc=tracking_calloc,
+            .realloc=tracking_realloc,
+            .free=tracking_free,
+            .aligned_alloc=NULL,
+            .context=(void *) parent,
+    };
+}
+
+const char *Alligator_enterTag(const char *tag) {
+    const char *previous = currentTag;
+    if (NULL == previous) {
+        currentTag = tag;
+    }
+    return previous;
+}
+
+void Alligator_exitTag(const char *previous) {
+    currentTag = previous;
+}
+
+struct Alligator_Stats Alligator_getStats(void) {
+    struct Alligator_Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.timestamp = tracking_now();
+    stats.liveBytes = tracking_read(&sharedTotal.liveBytes);
+    stats.peakBytes = tracking_read(&sharedTotal.peakBytes);
+
+    // slots are claimed in order and never released, so the tags of a snapshot are a prefix of them
+    stats.tagsLength = 1;
+    for (size_t i = 1; i < ALLIGATOR_MAX_TAGS; i++) {
+        const char *tag = __atomic_load_n(&sharedTags[i].tag, __ATOMIC_ACQUIRE);
+        if (NULL == tag) {
+            break;
+        }
+        stats.tags[stats.tagsLength++].tag = tag;
+    }
+    for (size_t i = 0; i < stats.tagsLength; i++) {
+        stats.tags[i].liveBytes = tracking_read(&sharedTags[i].liveBytes);
+        stats.tags[i].peakBytes = tracking_read(&sharedTags[i].peakBytes);
+    }
+
+    for (const struct Tracker *tracker = __atomic_load_n(&trackers, __ATOMIC_ACQUIRE); tracker; tracker = tracker->next) {
+        for (size_t i = 0; i < stats.tagsLength; i++) {
+            const size_t allocations = tracking_read(&tracker->tags[i].allocations);
+            stats.tags[i].liveAllocations += allocations - tracking_read(&tracker->tags[i].frees);
+            stats.tags[i].allocations += allocations;
+        }
+        for (size_t i = 0; i < ALLIGATOR_SIZE_CLASSES; i++) {
+            const struct SizeClassCounters *counters = &tracker->sizeClasses[i];
+            stats.sizeClasses[i].liveAllocations +=
+                    tracking_read(&counters->allocations) - tracking_read(&counters->frees);
+            stats.sizeClasses[i].liveBytes +=
+                    tracking_read(&counters->allocatedBytes) - tracking_read(&counters->freedBytes);
+        }
+    }
+    return stats;
 }
@@ -33,6 +33,7 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include <option/option.h>
 
 #if !(defined(__GNUC__) || defined(__clang__))
@@ -46,6 +47,42 @@ extern "C" {
 #define ALLIGATOR_VERSION_IS_RELEASE  0
 #define ALLIGATOR_VERSION_HEX         0x002400
 
+/**
+ * Requests up to this size are served from the per-thread caches by the allocator returned from
+ * Alligator_threadCacheAllocator, larger ones go straight to the system allocator.
+ */
+#define ALLIGATOR_THREAD_CACHE_MAX_SIZE     4096
+
+/**
+ * Number of freed blocks kept by each thread for each size class, the exceeding ones go back to the system allocator.
+ */
+#define ALLIGATOR_THREAD_CACHE_DEPTH        32
+
+/**
+ * Distinct tags accounted by the allocator returned from Alligator_trackingAllocator, including untagged allocations.
+ * Allocations with further tags are accounted as untagged.
+ */
+#define ALLIGATOR_MAX_TAGS                  16
+
+/**
+ * Size classes accounted by the allocator returned from Alligator_trackingAllocator: class 0 holds allocations up to
+ * 16 bytes, class i those up to 16 << i bytes, the last one also all the larger allocations.
+ */
+#define ALLIGATOR_SIZE_CLASSES              24
+
+/**
+ * An allocator that alligator forwards its calls to, every function receives the allocator context as first argument.
+ * aligned_alloc may be NULL if the allocator does not support it, Alligator_aligned_alloc will always fail then.
+ */
+struct Alligator_Allocator {
+    void *(*malloc)(void *context, size_t size);
+    void *(*calloc)(void *context, size_t numberOfMembers, size_t memberSize);
+    void *(*realloc)(void *context, void *ptr, size_t newSize);
+    void (*free)(void *context, void *ptr);
+    void *(*aligned_alloc)(void *context, size_t alignment, size_t size);
+    void *context;
+};
+
 #if (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L) || (defined(__cplusplus) && __cplusplus >= 201103L)
 
 extern Option Alligator_aligned_alloc(size_t alignment, size_t size)
@@ -64,6 +101,121 @@ __attribute__((__warn_unused_result__));
 
 extern void Alligator_free(void *ptr);
 
+/**
+ * Returns the allocator built on top of the functions configured in alligator_config.h, which is also the default one.
+ */
+extern struct Alligator_Allocator Alligator_systemAllocator(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns an allocator that keeps freed blocks up to ALLIGATOR_THREAD_CACHE_MAX_SIZE in per-thread caches,
+ * one for each power of two size class, serving later requests of the same class without locking.
+ * Blocks can be freed on any thread, cached ones go back to the system allocator when their thread exits.
+ */
+extern struct Alligator_Allocator Alligator_threadCacheAllocator(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns an allocator that forwards to parent and accounts every live allocation by tag and by size class,
+ * see Alligator_getStats. Each allocation carries a 16 bytes header with its size and tag, counters are kept per
+ * thread so the overhead is a few stores on the allocating and on the freeing thread.
+ * Aligned allocations are not supported.
+ *
+ * @attention parent must not be NULL and must outlive the returned allocator.
+ */
+extern struct Alligator_Allocator Alligator_trackingAllocator(const struct Alligator_Allocator *parent)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the allocator currently in use.
+ */
+extern struct Alligator_Allocator Alligator_getAllocator(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Sets the allocator used by every subsequent call to alligator, process-wide.
+ * Memory must be freed by the allocator that allocated it, so this must be called at startup, before anything is
+ * allocated through alligator and before other threads are started: the process panics otherwise.
+ *
+ * @attention malloc, calloc, realloc and free must not be NULL.
+ * @return The previous allocator.
+ */
+extern struct Alligator_Allocator Alligator_setAllocator(struct Alligator_Allocator allocator);
+
+/**
+ * Sets the tag of the allocations performed by the calling thread from now on, unless a tag is already set:
+ * the outermost tag wins so that, for example, the texts allocated while building a response are accounted to it.
+ * Tags are compared by content and are never copied, string literals are meant to be used.
+ *
+ * @return The previous tag, to be restored with Alligator_exitTag.
+ */
+extern const char *Alligator_enterTag(const char *tag)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Restores the tag returned by the matching Alligator_enterTag.
+ */
+extern void Alligator_exitTag(const char *previous);
+
+/**
+ * Statistics of the allocations sharing a tag.
+ */
+struct Alligator_TagStats {
+    const char *tag;                /* NULL for untagged allocations */
+    size_t liveAllocations;
+    size_t liveBytes;
+    size_t peakBytes;               /* highest liveBytes reached */
+    size_t allocations;             /* since the tracking allocator has been created */
+};
+
+/**
+ * Statistics of the allocations sharing a size class.
+ */
+struct Alligator_SizeClassStats {
+    size_t liveAllocations;
+    size_t liveBytes;
+};
+
+/**
+ * A snapshot of the allocations performed through the allocator returned by Alligator_trackingAllocator.
+ */
+struct Alligator_Stats {
+    uint64_t timestamp;             /* CLOCK_MONOTONIC nanoseconds */
+    size_t liveBytes;
+    size_t peakBytes;               /* highest liveBytes reached, across all tags */
+    size_t tagsLength;
+    struct Alligator_TagStats tags[ALLIGATOR_MAX_TAGS];
+    struct Alligator_SizeClassStats sizeClasses[ALLIGATOR_SIZE_CLASSES];
+};
+
+/**
+ * Takes a snapshot of the tracked allocations of all threads. Counters of different threads are read one after the
+ * other while they keep changing, so the snapshot is only consistent for quiescent threads.
+ * Snapshots do not affect each other: rates, such as allocations per second, are the difference of the counters of
+ * two snapshots over the difference of their timestamps.
+ * All counters are 0 if the tracking allocator has never been used.
+ */
+extern struct Alligator_Stats Alligator_getStats(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Allocations performed on a thread, see Alligator_getCounters.
+ */
+struct Alligator_Counters {
+    size_t allocations;     /* successful aligned_alloc, malloc, calloc and realloc calls on NULL pointers */
+    size_t reallocations;   /* successful realloc calls on non-NULL pointers, freed by their own free calls */
+    size_t frees;           /* free calls on non-NULL pointers */
+    size_t bytes;           /* bytes requested by the counted allocations and reallocations */
+};
+
+/**
+ * Returns the allocations performed so far by the calling thread.
+ * Counters only grow, take the difference of two snapshots to measure a section of code.
+ * All counters are 0 when alligator is built with ALLIGATOR_DISABLE_COUNTERS.
+ */
+extern struct Alligator_Counters Alligator_getCounters(void)
+__attribute__((__warn_unused_result__));
+
 #ifdef __cplusplus
 }
 #endif
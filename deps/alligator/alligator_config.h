@@ -65,6 +65,34 @@ extern "C" {
 #define __Alligator_free(ptr) \
     free((ptr))
 
+/*
+ * Allocation counting hooks, invoked on the calling thread counters after every successful allocation and every free.
+ * Define ALLIGATOR_DISABLE_COUNTERS to compile them out.
+ */
+#ifdef ALLIGATOR_DISABLE_COUNTERS
+
+#define __Alligator_onAllocate(counters, size) \
+    ((void) (counters), (void) (size))
+
+#define __Alligator_onReallocate(counters, size) \
+    ((void) (counters), (void) (size))
+
+#define __Alligator_onFree(counters) \
+    ((void) (counters))
+
+#else
+
+#define __Alligator_onAllocate(counters, size) \
+    ((counters).allocations++, (counters).bytes += (size))
+
+#define __Alligator_onReallocate(counters, size) \
+    ((counters).reallocations++, (counters).bytes += (size))
+
+#define __Alligator_onFree(counters) \
+    ((counters).frees++)
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
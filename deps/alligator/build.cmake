@@ -5,3 +5,6 @@ file(GLOB ARCHIVE_HEADERS ${CMAKE_CURRENT_LIST_DIR}/*.h)
 file(GLOB ARCHIVE_SOURCES ${CMAKE_CURRENT_LIST_DIR}/*.c)
 add_library(${ARCHIVE_NAME} ${ARCHIVE_HEADERS} ${ARCHIVE_SOURCES})
 target_link_libraries(${ARCHIVE_NAME} PUBLIC option)
+target_link_libraries(${ARCHIVE_NAME} PRIVATE panic)
+find_package(Threads REQUIRED)
+target_link_libraries(${ARCHIVE_NAME} PRIVATE Threads::Threads)
@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include <alligator/alligator.h>
 #include "atom.h"
 
@@ -64,6 +65,13 @@ __attribute__((__nonnull__));
 
 static bool initialized = false;
 static struct Atom_Node *table[ATOM_TABLE_SIZE] = {0};
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+Atom_lock(void);
+
+static void
+Atom_unlock(void);
 
 /*
  *
@@ -71,7 +79,11 @@ static struct Atom_Node *table[ATOM_TABLE_SIZE] = {0};
 Atom Atom_fromBytes(const void *const bytes, const size_t length) {
     assert(bytes);
     assert(length < SIZE_MAX);
-    return Atom_put(bytes, length, Atom_hash(bytes, length))->bytes;
+    const uint32_t hash = Atom_hash(bytes, length);
+    Atom_lock();
+    Atom atom = Atom_put(bytes, length, hash)->bytes;
+    Atom_unlock();
+    return atom;
 }
 
 Atom Atom_fromLiteral(const char *const literal) {
@@ -80,6 +92,16 @@ Atom Atom_fromLiteral(const char *const literal) {
     return Atom_fromBytes(literal, strlen(literal));
 }
 
+Atom Atom_find(const void *const bytes, const size_t length) {
+    assert(bytes);
+    assert(length < SIZE_MAX);
+    const uint32_t hash = Atom_hash(bytes, length);
+    Atom_lock();
+    struct Atom_Node *node = Atom_fetch(bytes, length, hash);
+    Atom_unlock();
+    return NULL == node ? NULL : node->bytes;
+}
+
 Atom Atom_fromInteger(const long long number) {
     char buffer[64] = {0};
     const size_t bufferSize = sizeof(buffer) / sizeof(buffer[0]);
@@ -117,7 +139,9 @@ bool Atom_equals(Atom atom, Atom other) {
 struct Atom_Node *Atom_Node_new(const void *const bytes, const size_t length, const uint32_t hash) {
     assert(bytes);
     assert(length < SIZE_MAX);
+    const char *tag = Alligator_enterTag("Atom");
     struct Atom_Node *self = Option_unwrap(Alligator_malloc(length + 1));
+    Alligator_exitTag(tag);
     memcpy(self->bytes, bytes, length);
     self->hash = hash;
     self->length = length;
@@ -154,7 +178,9 @@ struct Atom_Node *Atom_put(const void *const bytes, const size_t length, const u
     if (NULL == node) {
         const size_t index = hash % ATOM_TABLE_SIZE;
 
+        const char *tag = Alligator_enterTag("Atom");
         node = Option_unwrap(Alligator_malloc(sizeof(*node) + length + 1));
+        Alligator_exitTag(tag);
         node->next = table[index];
         node->length = length;
         node->hash = hash;
@@ -203,6 +229,22 @@ void Atom_assertValidInstance(Atom atom) {
     (void) atom;
 #ifndef NDEBUG
     struct Atom_Node *node = ((struct Atom_Node *) atom) - 1;
-    assert(NULL != Atom_fetch(node->bytes, node->length, node->hash));
+    Atom_lock();
+    const bool valid = NULL != Atom_fetch(node->bytes, node->length, node->hash);
+    Atom_unlock();
+    assert(valid);
+    (void) valid;
 #endif
 }
+
+void Atom_lock(void) {
+    if (0 != pthread_mutex_lock(&mutex)) {
+        abort();
+    }
+}
+
+void Atom_unlock(void) {
+    if (0 != pthread_mutex_unlock(&mutex)) {
+        abort();
+    }
+}
@@ -53,6 +53,7 @@ extern "C" {
  * One of the advantages of atoms is that comparing two byte sequences for equality is performed by simply comparing pointers.
  * Another advantage is that using atoms saves space because there’s only one occurrence of each sequence.
  * Atoms are often used as keys in data structures that are indexed by sequences of arbitrary bytes instead of by integers.
+ * Atoms can be created concurrently from multiple threads, the table is guarded by a mutex.
  */
 typedef const char *Atom;
 
@@ -90,6 +91,18 @@ extern Atom
 Atom_fromFloating(long double number)
 __attribute__((__warn_unused_result__));
 
+/**
+ * Gets the Atom instance from a sequence of bytes without creating it.
+ *
+ * @attention bytes must not be NULL.
+ * @attention length must be < SIZE_MAX.
+ *
+ * @return The Atom instance or NULL if it does not exist.
+ */
+extern Atom
+Atom_find(const void *bytes, size_t length)
+__attribute__((__warn_unused_result__, __nonnull__));
+
 /**
  * Gets the length of the atom.
  *
@@ -1,2 +1,3 @@
 add_library(atom ${CMAKE_CURRENT_LIST_DIR}/atom.h ${CMAKE_CURRENT_LIST_DIR}/atom.c)
-target_link_libraries(atom PRIVATE alligator)
+find_package(Threads REQUIRED)
+target_link_libraries(atom PRIVATE alligator Threads::Threads)
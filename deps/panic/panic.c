@@ -36,7 +36,7 @@
 static Panic_Callback globalCallback = NULL;
 
 Panic_Callback Panic_registerCallback(const Panic_Callback callback) {
-    const Panic_Callback backup = callback;
+    const Panic_Callback backup = globalCallback;
     globalCallback = callback;
     return backup;
 }
@@ -27,10 +27,14 @@
  */
 
 #include <stdio.h>
-#include <ctype.h>
 #include <assert.h>
 #include <stdint.h>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include <panic/panic.h>
 #include <alligator/alligator.h>
 #include "text.h"
@@ -60,8 +64,233 @@ static size_t calculateNewCapacity(size_t currentCapacity, const size_t targetCa
     return currentCapacity;
 }
 
-static bool isTrimmable(char c) {
-    return isspace(c) || isblank(c) || !isprint(c);
+/*
+ * ASCII fast paths.
+ *
+ * Case folding, trimming and case insensitive comparisons only consider ASCII, they do not depend on the current
+ * locale and process 16 bytes at a time when SSE2 is available.
+ * A byte is trimmable when it is not printable ASCII, that is less or equal than ' ' or greater or equal than 0x7F.
+ */
+static bool isTrimmable(const unsigned char c) {
+    return c <= 0x20 || c >= 0x7F;
+}
+
+static unsigned char asciiLower(const unsigned char c) {
+    return (unsigned char) ((unsigned) (c - 'A') < 26U ? c + 0x20 : c);
+}
+
+static unsigned char asciiUpper(const unsigned char c) {
+    return (unsigned char) ((unsigned) (c - 'a') < 26U ? c - 0x20 : c);
+}
+
+#if defined(__SSE2__)
+
+static __m128i lowerBlock(const __m128i block) {
+    // signed comparisons: bytes >= 0x80 are negative and never in range
+    const __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)),
+                                          _mm_cmplt_epi8(block, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(block, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+
+static __m128i upperBlock(const __m128i block) {
+    const __m128i isLower = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('a' - 1)),
+                                          _mm_cmplt_epi8(block, _mm_set1_epi8('z' + 1)));
+    return _mm_andnot_si128(_mm_and_si128(isLower, _mm_set1_epi8(0x20)), block);
+}
+
+static unsigned printableMask(const __m128i block) {
+    const __m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(0x7F)),
+                                               _mm_cmpgt_epi8(block, _mm_set1_epi8(0x20)));
+    return (unsigned) _mm_movemask_epi8(printable);
+}
+
+#endif
+
+static void lowerBytes(unsigned char *bytes, const size_t size) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        __m128i *block = (__m128i *) (bytes + i);
+        _mm_storeu_si128(block, lowerBlock(_mm_loadu_si128(block)));
+    }
+#endif
+    for (; i < size; i++) {
+        bytes[i] = asciiLower(bytes[i]);
+    }
+}
+
+static void upperBytes(unsigned char *bytes, const size_t size) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        __m128i *block = (__m128i *) (bytes + i);
+        _mm_storeu_si128(block, upperBlock(_mm_loadu_si128(block)));
+    }
+#endif
+    for (; i < size; i++) {
+        bytes[i] = asciiUpper(bytes[i]);
+    }
+}
+
+static bool bytesEqualIgnoreCase(const unsigned char *a, const unsigned char *b, const size_t size) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        const __m128i x = lowerBlock(_mm_loadu_si128((const __m128i *) (a + i)));
+        const __m128i y = lowerBlock(_mm_loadu_si128((const __m128i *) (b + i)));
+        if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) {
+            return false;
+        }
+    }
+#endif
+    for (; i < size; i++) {
+        if (asciiLower(a[i]) != asciiLower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t leadingTrimmable(const unsigned char *bytes, const size_t size) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        const unsigned mask = printableMask(_mm_loadu_si128((const __m128i *) (bytes + i)));
+        if (0 != mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < size && isTrimmable(bytes[i]); i++) {}
+    return i;
+}
+
+static size_t trailingTrimmable(const unsigned char *bytes, const size_t size) {
+    size_t end = size;
+#if defined(__SSE2__)
+    for (; end >= 16; end -= 16) {
+        const unsigned mask = printableMask(_mm_loadu_si128((const __m128i *) (bytes + end - 16)));
+        if (0 != mask) {
+            return size - end + __builtin_clz(mask) - 16;
+        }
+    }
+#endif
+    for (; end > 0 && isTrimmable(bytes[end - 1]); end--) {}
+    return size - end;
+}
+
+/*
+ * JSON escaping.
+ *
+ * A byte can be copied verbatim when it is printable ASCII (0x20 - 0x7E) other than '"', '\\' and '/'.
+ * Runs of such bytes are located 32 (AVX2) or 16 (SSE2) at a time and copied in bulk, so that only the bytes
+ * that actually need escaping are handled one at a time.
+ */
+static bool needsEscape(const unsigned char c) {
+    return c < 0x20 || c >= 0x7F || '"' == c || '\\' == c || '/' == c;
+}
+
+#if defined(__AVX2__)
+
+static size_t safeRunLength(const unsigned char *data, const size_t size) {
+    size_t i = 0;
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i slash = _mm256_set1_epi8('/');
+    for (; i + 32 <= size; i += 32) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i *) (data + i));
+        // signed comparison: catches both control characters and bytes >= 0x80
+        __m256i unsafe = _mm256_cmpgt_epi8(space, chunk);
+        unsafe = _mm256_or_si256(unsafe, _mm256_cmpeq_epi8(chunk, del));
+        unsafe = _mm256_or_si256(unsafe, _mm256_cmpeq_epi8(chunk, quote));
+        unsafe = _mm256_or_si256(unsafe, _mm256_cmpeq_epi8(chunk, backslash));
+        unsafe = _mm256_or_si256(unsafe, _mm256_cmpeq_epi8(chunk, slash));
+        const unsigned mask = (unsigned) _mm256_movemask_epi8(unsafe);
+        if (0 != mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    for (; i < size && !needsEscape(data[i]); i++) {}
+    return i;
+}
+
+#elif defined(__SSE2__)
+
+static size_t safeRunLength(const unsigned char *data, const size_t size) {
+    size_t i = 0;
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i slash = _mm_set1_epi8('/');
+    for (; i + 16 <= size; i += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        // signed comparison: catches both control characters and bytes >= 0x80
+        __m128i unsafe = _mm_cmplt_epi8(chunk, space);
+        unsafe = _mm_or_si128(unsafe, _mm_cmpeq_epi8(chunk, del));
+        unsafe = _mm_or_si128(unsafe, _mm_cmpeq_epi8(chunk, quote));
+        unsafe = _mm_or_si128(unsafe, _mm_cmpeq_epi8(chunk, backslash));
+        unsafe = _mm_or_si128(unsafe, _mm_cmpeq_epi8(chunk, slash));
+        const unsigned mask = (unsigned) _mm_movemask_epi8(unsafe);
+        if (0 != mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    for (; i < size && !needsEscape(data[i]); i++) {}
+    return i;
+}
+
+#else
+
+static size_t safeRunLength(const unsigned char *data, const size_t size) {
+    size_t i = 0;
+    for (; i < size && !needsEscape(data[i]); i++) {}
+    return i;
+}
+
+#endif
+
+static size_t escape(const unsigned char c, char buffer[6]) {
+    static const char hex[] = "0123456789abcdef";
+    buffer[0] = '\\';
+    switch (c) {
+        case '"':
+        case '\\':
+        case '/': {
+            buffer[1] = (char) c;
+            return 2;
+        }
+        case '\b': {
+            buffer[1] = 'b';
+            return 2;
+        }
+        case '\f': {
+            buffer[1] = 'f';
+            return 2;
+        }
+        case '\n': {
+            buffer[1] = 'n';
+            return 2;
+        }
+        case '\r': {
+            buffer[1] = 'r';
+            return 2;
+        }
+        case '\t': {
+            buffer[1] = 't';
+            return 2;
+        }
+        default: {
+            buffer[1] = 'u';
+            buffer[2] = '0';
+            buffer[3] = '0';
+            buffer[4] = hex[c >> 4];
+            buffer[5] = hex[c & 0x0F];
+            return 6;
+        }
+    }
 }
 
 struct Text_Header {
@@ -70,6 +299,14 @@ struct Text_Header {
     char *content;
 };
 
+static Text appendRaw(Text *ref, const void *bytes, const size_t size) {
+    Text self = Text_expandToFit(ref, Text_length(*ref) + size);
+    struct Text_Header *header = (struct Text_Header *) self - 1;
+    memcpy(self + header->length, bytes, size);
+    self[header->length += size] = 0;
+    return self;
+}
+
 Text Text_new(void) {
     return Text_withCapacity(TEXT_DEFAULT_CAPACITY);
 }
@@ -79,69 +316,52 @@ Text Text_withCapacity(size_t capacity) {
     if (capacity < TEXT_DEFAULT_CAPACITY) {
         capacity = TEXT_DEFAULT_CAPACITY;
     }
+    const char *tag = Alligator_enterTag("Text");
     struct Text_Header *header = Option_unwrap(Alligator_malloc(
             sizeof(*header) + sizeof(header->content[0]) * (capacity + 1)
     ));
+    Alligator_exitTag(tag);
     header->content = (char *) (header + 1);
     header->content[header->length = 0] = 0;
     header->content[header->capacity = capacity] = 0;
     return header->content;
 }
 
+size_t Text_overhead(void) {
+    return sizeof(struct Text_Header);
+}
+
+Text Text_inPlace(void *memory, const size_t size) {
+    assert(memory);
+    assert(size > sizeof(struct Text_Header));
+    struct Text_Header *header = memory;
+    header->content = (char *) (header + 1);
+    header->content[header->length = 0] = 0;
+    header->content[header->capacity = size - sizeof(*header) - 1] = 0;
+    return header->content;
+}
+
 Text Text_quoted(const void *bytes, const size_t size) {
     assert(bytes);
     assert(size < SIZE_MAX);
 
-    const char *data = bytes;
-    Text text = Text_withCapacity(size + size / 3);
+    const unsigned char *data = bytes;
+    Text text = Text_withCapacity(size + size / 8 + 2);
 
-    text = Text_appendBytes(&text, "\"", 1);
-    for (size_t i = 0; i < size; i++) {
-        switch (*data) {
-            case '"': {
-                text = Text_appendBytes(&text, "\\\"", 2);
-                break;
-            }
-            case '\\': {
-                text = Text_appendBytes(&text, "\\\\", 2);
-                break;
-            }
-            case '/': {
-                text = Text_appendBytes(&text, "\\/", 2);
-                break;
-            }
-            case '\b': {
-                text = Text_appendBytes(&text, "\\b", 2);
-                break;
-            }
-            case '\f': {
-                text = Text_appendBytes(&text, "\\f", 2);
-                break;
-            }
-            case '\n': {
-                text = Text_appendBytes(&text, "\\n", 2);
-                break;
-            }
-            case '\r': {
-                text = Text_appendBytes(&text, "\\r", 2);
-                break;
-            }
-            case '\t': {
-                text = Text_appendBytes(&text, "\\t", 2);
-                break;
-            }
-            default: {
-                if (isprint(*data)) {
-                    text = Text_appendFormat(&text, "%c", *data);
-                } else {
-                    text = Text_appendFormat(&text, "\\u%04hhx", *data);
-                }
-                break;
-            }
+    text = appendRaw(&text, "\"", 1);
+    for (size_t i = 0; i < size;) {
+        const size_t run = safeRunLength(data + i, size - i);
+        if (run > 0) {
+            text = appendRaw(&text, data + i, run);
+            i += run;
+        }
+        if (i < size) {
+            char buffer[6];
+            text = appendRaw(&text, buffer, escape(data[i], buffer));
+            i++;
         }
-        data++;
     }
-    text = Text_appendBytes(&text, "\"", 1);
+    text = appendRaw(&text, "\"", 1);
 
     return text;
 }
@@ -410,41 +630,31 @@ void Text_eraseRange(Text self, const size_t start, const size_t end) {
     }
 }
 
-void Text_trimLeft(Text self) {     // TODO test
+void Text_trimLeft(Text self) {
     assert(self);
-    char *cursor = self;
-    for (const char *end = cursor + Text_length(self); cursor < end && isTrimmable(*cursor); cursor++) {}
-    Text_eraseRange(self, 0, cursor - self);
+    Text_eraseRange(self, 0, leadingTrimmable((const unsigned char *) self, Text_length(self)));
 }
 
-void Text_trimRight(Text self) {    // TODO test
+void Text_trimRight(Text self) {
     assert(self);
-    char *cursor;
     const size_t length = Text_length(self);
-    for (cursor = self + length; self < cursor && isTrimmable(*cursor); cursor--) {}
-    Text_eraseRange(self, (isTrimmable(*cursor) ? cursor : cursor + 1) - self, length);
+    Text_eraseRange(self, length - trailingTrimmable((const unsigned char *) self, length), length);
 }
 
-void Text_trim(Text self) {         // TODO test
+void Text_trim(Text self) {
     assert(self);
-    Text_trimLeft(self);
     Text_trimRight(self);
+    Text_trimLeft(self);
 }
 
 void Text_lower(Text self) {
     assert(self);
-    const size_t length = Text_length(self);
-    for (size_t i = 0; i < length; i++) {
-        self[i] = (char) tolower(self[i]);
-    }
+    lowerBytes((unsigned char *) self, Text_length(self));
 }
 
 void Text_upper(Text self) {
     assert(self);
-    const size_t length = Text_length(self);
-    for (size_t i = 0; i < length; i++) {
-        self[i] = (char) toupper(self[i]);
-    }
+    upperBytes((unsigned char *) self, Text_length(self));
 }
 
 void Text_clear(Text self) {
@@ -536,6 +746,26 @@ bool Text_equals(const TextView self, const TextView other) {
     return length == Text_length(other) && 0 == memcmp(self, other, length);
 }
 
+bool Text_equalsIgnoreCase(const TextView self, const TextView other) {
+    assert(self);
+    assert(other);
+    const size_t length = Text_length(self);
+    return length == Text_length(other) &&
+           bytesEqualIgnoreCase((const unsigned char *) self, (const unsigned char *) other, length);
+}
+
+bool Text_startsWith(const TextView self, const void *const bytes, const size_t size) {
+    assert(self);
+    assert(bytes);
+    return size <= Text_length(self) && 0 == memcmp(self, bytes, size);
+}
+
+bool Text_startsWithIgnoreCase(const TextView self, const void *const bytes, const size_t size) {
+    assert(self);
+    assert(bytes);
+    return size <= Text_length(self) && bytesEqualIgnoreCase((const unsigned char *) self, bytes, size);
+}
+
 void Text_delete(Text self) {
     if (self) {
         struct Text_Header *header = (struct Text_Header *) self - 1;
@@ -74,6 +74,28 @@ __attribute__((__warn_unused_result__));
 extern Text Text_withCapacity(size_t capacity)
 __attribute__((__warn_unused_result__));
 
+/**
+ * Gets the number of bytes a text needs besides its content and terminator.
+ *
+ * @return the size of the text bookkeeping.
+ */
+extern size_t Text_overhead(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Creates an empty text inside memory that is not owned by the text, its capacity is size - Text_overhead() - 1.
+ *
+ * @attention memory must not be NULL and must be suitably aligned for a pointer.
+ * @attention size must be greater than Text_overhead().
+ * @attention the text must neither be expanded nor deleted, memory is released by its owner once the text is unused.
+ *
+ * @param memory The memory the text is placed in.
+ * @param size The size of memory.
+ * @return a new text instance.
+ */
+extern Text Text_inPlace(void *memory, size_t size)
+__attribute__((__warn_unused_result__, __nonnull__));
+
 /**
  * Creates a new JSON compliant quoted instance of text starting from bytes.
  *
@@ -435,7 +457,7 @@ extern void Text_eraseRange(Text self, size_t start, size_t end)
 __attribute__((__nonnull__));
 
 /**
- * Removes leading whitespace from left.
+ * Removes leading whitespace and non printable ASCII characters from left.
  *
  * @param self The text instance.
  */
@@ -443,7 +465,7 @@ extern void Text_trimLeft(Text self)
 __attribute__((__nonnull__));
 
 /**
- * Removes leading whitespace from right.
+ * Removes trailing whitespace and non printable ASCII characters from right.
  *
  * @param self The text instance.
  */
@@ -451,7 +473,7 @@ extern void Text_trimRight(Text self)
 __attribute__((__nonnull__));
 
 /**
- * Removes leading whitespace from both endings.
+ * Removes whitespace and non printable ASCII characters from both endings.
  *
  * @param self The text instance.
  */
@@ -460,6 +482,7 @@ __attribute__((__nonnull__));
 
 /**
  * To lower case.
+ * Note: Only ASCII letters are affected, regardless of the current locale.
  *
  * @param self The text instance.
  */
@@ -468,6 +491,7 @@ __attribute__((__nonnull__));
 
 /**
  * To upper case.
+ * Note: Only ASCII letters are affected, regardless of the current locale.
  *
  * @param self The text instance.
  */
@@ -577,6 +601,33 @@ __attribute__((__warn_unused_result__, __nonnull__));
 extern bool Text_equals(TextView self, TextView other)
 __attribute__((__warn_unused_result__, __nonnull__));
 
+/**
+ * Checks for equality ignoring the case of ASCII letters.
+ *
+ * @attention self must not be NULL.
+ * @attention other must not be NULL.
+ */
+extern bool Text_equalsIgnoreCase(TextView self, TextView other)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Checks if the text starts with the given bytes array.
+ *
+ * @attention self must not be NULL.
+ * @attention bytes must not be NULL.
+ */
+extern bool Text_startsWith(TextView self, const void *bytes, size_t size)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Checks if the text starts with the given bytes array ignoring the case of ASCII letters.
+ *
+ * @attention self must not be NULL.
+ * @attention bytes must not be NULL.
+ */
+extern bool Text_startsWithIgnoreCase(TextView self, const void *bytes, size_t size)
+__attribute__((__warn_unused_result__, __nonnull__));
+
 /**
  * Deletes an instance of a text.
  * If NULL nothing will be done.
@@ -26,6 +26,9 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -51,6 +54,9 @@
 #define TRAITS_UNIT_BUFFER_CAPACITY                     1024
 #define TRAITS_UNIT_INDENTATION_STEP                    2
 #define TRAITS_UNIT_INDENTATION_START                   0
+#define TRAITS_UNIT_BENCHMARK_WARMUP_NS                 10000000
+#define TRAITS_UNIT_BENCHMARK_SAMPLE_NS                 10000000
+#define TRAITS_UNIT_BENCHMARK_SAMPLES                   10
 
 /*
  * Forward declare traits subject (this should come from the test file Describe macro)
@@ -91,6 +97,13 @@ typedef struct traits_unit_trait_result_t {
     size_t all;
 } traits_unit_trait_result_t;
 
+typedef struct traits_unit_benchmark_result_t {
+    size_t iterations;
+    double mean;
+    double stddev;
+    double min;
+} traits_unit_benchmark_result_t;
+
 typedef enum traits_unit_feature_result_t {
     TRAITS_UNIT_FEATURE_RESULT_SUCCEED,
     TRAITS_UNIT_FEATURE_RESULT_SKIPPED,
@@ -98,6 +111,11 @@ typedef enum traits_unit_feature_result_t {
     TRAITS_UNIT_FEATURE_RESULT_TODO,
 } traits_unit_feature_result_t;
 
+/*
+ * Define internal global variables depending on internal types
+ */
+static traits_unit_benchmark_result_t *global_benchmark_result = NULL;
+
 /*
  * Declare internal functions
  */
@@ -136,6 +154,15 @@ traits_unit_teardown(void);
 static void
 traits_unit_register_teardown_on_exit(void);
 
+static uint64_t
+traits_unit_benchmark_clock(void);
+
+static uint64_t
+traits_unit_benchmark_measure(traits_unit_feature_fn *feature, size_t iterations);
+
+static void
+traits_unit_benchmark_feature(traits_unit_feature_fn *feature, traits_unit_benchmark_result_t *result);
+
 static traits_unit_trait_result_t
 traits_unit_run_trait(size_t indentation_level, traits_unit_trait_t *trait, traits_unit_buffer_t *buffer);
 
@@ -242,6 +269,7 @@ main(int argc, char *argv[]) {
         /* Run features of traits in traits_list */
         traits_unit_trait_t *trait = NULL;
         buffer = traits_unit_buffer_new(TRAITS_UNIT_BUFFER_CAPACITY);
+        global_benchmark_result = traits_unit_shared_malloc(sizeof(*global_benchmark_result));
         traits_unit_print(indentation_level, "Describing: %s\n", traits_unit_subject.subject);
         indentation_level += TRAITS_UNIT_INDENTATION_STEP;
         for (size_t i = 0; (trait = traits_list[i]) && trait->trait_name; i++) {
@@ -256,6 +284,8 @@ main(int argc, char *argv[]) {
         traits_unit_report(
                 indentation_level, counter_succeed, counter_skipped, counter_failed, counter_todo, counter_all
         );
+        traits_unit_shared_free(global_benchmark_result, sizeof(*global_benchmark_result));
+        global_benchmark_result = NULL;
         traits_unit_buffer_delete(&buffer);
     }
 
@@ -409,6 +439,58 @@ traits_unit_print(size_t indentation_level, const char *fmt, ...) {
     va_end(args);
 }
 
+uint64_t
+traits_unit_benchmark_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+uint64_t
+traits_unit_benchmark_measure(traits_unit_feature_fn *feature, size_t iterations) {
+    const uint64_t start = traits_unit_benchmark_clock();
+    for (size_t i = 0; i < iterations; i++) {
+        feature();
+    }
+    return traits_unit_benchmark_clock() - start;
+}
+
+void
+traits_unit_benchmark_feature(traits_unit_feature_fn *feature, traits_unit_benchmark_result_t *result) {
+    assert(feature);
+    assert(result);
+    double samples[TRAITS_UNIT_BENCHMARK_SAMPLES];
+    size_t iterations = 1;
+
+    /* Warm up caches, branch predictors and lazily initialized state */
+    for (const uint64_t start = traits_unit_benchmark_clock();
+         traits_unit_benchmark_clock() - start < TRAITS_UNIT_BENCHMARK_WARMUP_NS;) {
+        feature();
+    }
+
+    /* Double the iterations until a single sample lasts long enough to be measured */
+    while (traits_unit_benchmark_measure(feature, iterations) < TRAITS_UNIT_BENCHMARK_SAMPLE_NS) {
+        iterations *= 2;
+    }
+
+    /* Collect samples */
+    result->iterations = iterations;
+    result->mean = 0;
+    for (size_t i = 0; i < TRAITS_UNIT_BENCHMARK_SAMPLES; i++) {
+        samples[i] = (double) traits_unit_benchmark_measure(feature, iterations) / (double) iterations;
+        result->mean += samples[i];
+        result->min = (0 == i || samples[i] < result->min) ? samples[i] : result->min;
+    }
+    result->mean /= TRAITS_UNIT_BENCHMARK_SAMPLES;
+
+    /* Sample standard deviation */
+    result->stddev = 0;
+    for (size_t i = 0; i < TRAITS_UNIT_BENCHMARK_SAMPLES; i++) {
+        result->stddev += (samples[i] - result->mean) * (samples[i] - result->mean);
+    }
+    result->stddev = sqrt(result->stddev / (TRAITS_UNIT_BENCHMARK_SAMPLES - 1));
+}
+
 void
 traits_unit_teardown(void) {
     if (!global_feature) {
@@ -498,7 +580,11 @@ traits_unit_fork_and_run_feature(traits_unit_feature_t *feature, traits_unit_buf
         traits_unit_register_teardown_on_exit();
 
         /* Run feature */
-        feature->feature();
+        if (TRAITS_UNIT_ACTION_BENCHMARK == feature->action) {
+            traits_unit_benchmark_feature(feature->feature, global_benchmark_result);
+        } else {
+            feature->feature();
+        }
 
         /* Close fd */
         close(fd);
@@ -534,12 +620,23 @@ traits_unit_run_feature(size_t indentation_level, traits_unit_feature_t *feature
     traits_unit_feature_result_t result;
     traits_unit_print(indentation_level, "Feature: %s... ", feature->feature_name);
     switch (feature->action) {
-        case TRAITS_UNIT_ACTION_RUN: {
+        case TRAITS_UNIT_ACTION_RUN:
+        case TRAITS_UNIT_ACTION_BENCHMARK: {
             traits_unit_buffer_clear(buffer);
+            memset(global_benchmark_result, 0, sizeof(*global_benchmark_result));
             const int exit_status = traits_unit_fork_and_run_feature(feature, buffer);
             if (EXIT_SUCCESS == exit_status) {
                 result = TRAITS_UNIT_FEATURE_RESULT_SUCCEED;
-                traits_unit_print(0, "succeed\n");
+                if (TRAITS_UNIT_ACTION_BENCHMARK == feature->action) {
+                    traits_unit_print(
+                            0, "%.2f ns/op (stddev %.2f, min %.2f, %d samples x %zu iterations)\n",
+                            global_benchmark_result->mean, global_benchmark_result->stddev,
+                            global_benchmark_result->min, TRAITS_UNIT_BENCHMARK_SAMPLES,
+                            global_benchmark_result->iterations
+                    );
+                } else {
+                    traits_unit_print(0, "succeed\n");
+                }
             } else {
                 result = TRAITS_UNIT_FEATURE_RESULT_FAILED;
                 if (!WIFEXITED(exit_status)) {
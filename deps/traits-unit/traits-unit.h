@@ -47,11 +47,11 @@ extern "C" {
 * Versioning
 */
 #define TRAITS_UNIT_VERSION_MAJOR       3
-#define TRAITS_UNIT_VERSION_MINOR       0
+#define TRAITS_UNIT_VERSION_MINOR       1
 #define TRAITS_UNIT_VERSION_PATCH       0
 #define TRAITS_UNIT_VERSION_SUFFIX      ""
 #define TRAITS_UNIT_VERSION_IS_RELEASE  1
-#define TRAITS_UNIT_VERSION_HEX         0x030000
+#define TRAITS_UNIT_VERSION_HEX         0x030100
 
 /*
  * Constants
@@ -75,7 +75,8 @@ typedef void traits_unit_feature_fn(void);
 typedef enum traits_unit_action_t {
     TRAITS_UNIT_ACTION_RUN,
     TRAITS_UNIT_ACTION_SKIP,
-    TRAITS_UNIT_ACTION_TODO
+    TRAITS_UNIT_ACTION_TODO,
+    TRAITS_UNIT_ACTION_BENCHMARK
 } traits_unit_action_t;
 
 typedef struct traits_unit_feature_t {
@@ -146,6 +147,14 @@ main(int argc, char *argv[]);
 #define Todo(...)                               \
     __TRAITS_UNIT_FEATURE_TODO(__VA_ARGS__, __TraitsUnitDefaultFixture, __TraitsUnitDefaultFixture)
 
+/*
+ * Runs the feature body repeatedly as a single operation: after a warmup the iterations count is calibrated
+ * so that each sample lasts long enough to be measured, then mean, standard deviation and min ns/op are reported.
+ * The fixture is set up once before the warmup and torn down after the last sample.
+ */
+#define Benchmark(...)                          \
+    __TRAITS_UNIT_FEATURE_BENCHMARK(__VA_ARGS__, __TraitsUnitDefaultFixture, __TraitsUnitDefaultFixture)
+
 /*
  * Helper macro to handle signals
  */
@@ -180,6 +189,9 @@ main(int argc, char *argv[]);
 #define __TRAITS_UNIT_FEATURE_TODO(Name, Fixture, ...)              \
     {.feature_name=__TRAITS_UNIT_TO_STRING(Name), .feature=__TRAITS_UNIT_FEATURE_ID(Name), .fixture=&__TRAITS_UNIT_FIXTURE_ID(Fixture), .action=TRAITS_UNIT_ACTION_TODO}
 
+#define __TRAITS_UNIT_FEATURE_BENCHMARK(Name, Fixture, ...)         \
+    {.feature_name=__TRAITS_UNIT_TO_STRING(Name), .feature=__TRAITS_UNIT_FEATURE_ID(Name), .fixture=&__TRAITS_UNIT_FIXTURE_ID(Fixture), .action=TRAITS_UNIT_ACTION_BENCHMARK}
+
 extern jmp_buf __traits_unit_jump_buffer;
 
 extern void
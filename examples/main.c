@@ -91,15 +91,22 @@ void printRequest(const struct HttpRequest *request) {
 }
 
 void printResponse(const struct HttpResponse *response) {
+    const struct HttpTimings timings = HttpResponse_getTimings(response);
     printf("\n"
            "status: %d %s\n"
            "effectiveUrl: %s\n"
            "headers:\n---------------------------------------\n%s\n---------------------------------------\n"
            "body:\n---------------------------------------\n%s\n---------------------------------------\n"
+           "timings (us): dns %llu, connect %llu, tls %llu, pretransfer %llu, firstByte %llu, transfer %llu, "
+           "redirect %llu, total %llu\n"
            "\n",
            HttpResponse_getStatus(response), HttpStatus_explain(HttpResponse_getStatus(response)),
            HttpResponse_getUrl(response),
            HttpResponse_getHeaders(response),
-           HttpResponse_getBody(response)
+           HttpResponse_getBody(response),
+           (unsigned long long) timings.dns, (unsigned long long) timings.connect,
+           (unsigned long long) timings.tls, (unsigned long long) timings.pretransfer,
+           (unsigned long long) timings.firstByte, (unsigned long long) timings.transfer,
+           (unsigned long long) timings.redirect, (unsigned long long) timings.total
     );
 }
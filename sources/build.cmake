@@ -1,10 +1,23 @@
 add_library(http
         ${CMAKE_CURRENT_LIST_DIR}/http.h ${CMAKE_CURRENT_LIST_DIR}/http.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_cache.h ${CMAKE_CURRENT_LIST_DIR}/http_cache.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_disk_cache.h ${CMAKE_CURRENT_LIST_DIR}/http_disk_cache.c
         ${CMAKE_CURRENT_LIST_DIR}/http_error.h ${CMAKE_CURRENT_LIST_DIR}/http_error.c
         ${CMAKE_CURRENT_LIST_DIR}/http_fire_result.h ${CMAKE_CURRENT_LIST_DIR}/http_fire_result.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_hooks.h
+        ${CMAKE_CURRENT_LIST_DIR}/http_mapped_text.h ${CMAKE_CURRENT_LIST_DIR}/http_mapped_text.c
         ${CMAKE_CURRENT_LIST_DIR}/http_maybe_text.h ${CMAKE_CURRENT_LIST_DIR}/http_maybe_text.c
         ${CMAKE_CURRENT_LIST_DIR}/http_method.h ${CMAKE_CURRENT_LIST_DIR}/http_method.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_metrics.h ${CMAKE_CURRENT_LIST_DIR}/http_metrics.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_probes.h
         ${CMAKE_CURRENT_LIST_DIR}/http_request.h ${CMAKE_CURRENT_LIST_DIR}/http_request.c
         ${CMAKE_CURRENT_LIST_DIR}/http_response.h ${CMAKE_CURRENT_LIST_DIR}/http_response.c
-        ${CMAKE_CURRENT_LIST_DIR}/http_status.h ${CMAKE_CURRENT_LIST_DIR}/http_status.c)
-target_link_libraries(http PRIVATE curl atom text error panic option alligator)
+        ${CMAKE_CURRENT_LIST_DIR}/http_rope.h ${CMAKE_CURRENT_LIST_DIR}/http_rope.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_shared_cache.h ${CMAKE_CURRENT_LIST_DIR}/http_shared_cache.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_shared_text.h ${CMAKE_CURRENT_LIST_DIR}/http_shared_text.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_single_flight.h ${CMAKE_CURRENT_LIST_DIR}/http_single_flight.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_slow_log.h ${CMAKE_CURRENT_LIST_DIR}/http_slow_log.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_status.h ${CMAKE_CURRENT_LIST_DIR}/http_status.c
+        ${CMAKE_CURRENT_LIST_DIR}/http_timings.h
+        ${CMAKE_CURRENT_LIST_DIR}/http_trace.h ${CMAKE_CURRENT_LIST_DIR}/http_trace.c)
+target_link_libraries(http PRIVATE curl Threads::Threads atom text error panic option alligator)
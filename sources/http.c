@@ -27,19 +27,176 @@
  */
 
 #include <http.h>
+#include <http_probes.h>
+#include <time.h>
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <curl/curl.h>
 #include <panic/panic.h>
+#include <alligator/alligator.h>
+
+#ifdef HTTP_PROBES_ENABLED
+#define HTTP_PROBE_SEMAPHORE __attribute__((section(".probes")))
+volatile unsigned short http_request__start_semaphore HTTP_PROBE_SEMAPHORE = 0;
+volatile unsigned short http_connect__done_semaphore HTTP_PROBE_SEMAPHORE = 0;
+volatile unsigned short http_headers__received_semaphore HTTP_PROBE_SEMAPHORE = 0;
+volatile unsigned short http_body__complete_semaphore HTTP_PROBE_SEMAPHORE = 0;
+volatile unsigned short http_request__error_semaphore HTTP_PROBE_SEMAPHORE = 0;
+#endif
 
 static Text emptyString = NULL;
+static pthread_once_t emptyStringOnce = PTHREAD_ONCE_INIT;
 static bool initialized = false;
+static struct HttpHooks hooks = {
+        .beforeSend=NULL, .headersReceived=NULL, .firstBodyByte=NULL, .completed=NULL, .failed=NULL, .context=NULL
+};
+
+#define TRANSFER_MAX_POLL_MILLISECONDS   1000
+
+/*
+ * Every thread reuses its own easy and multi handles: the connection cache of the multi handle keeps connections
+ * alive across requests.
+ * The handles of every thread are linked together so that Http_terminate can clean them up before libcurl; threads
+ * find their handles cleaned up (easy and multi set to NULL) and initialize them again, their memory is freed when
+ * they exit.
+ */
+struct Handles {
+    struct Handles *next;
+    struct Handles *previous;
+    CURL *easy;
+    CURLM *multi;
+};
+
+static __thread struct Handles *localHandles = NULL;
+static pthread_key_t handlesKey;
+static pthread_once_t handlesKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t handlesLock = PTHREAD_MUTEX_INITIALIZER;
+static struct Handles *allHandles = NULL;
+
+/*
+ * Entries served stale while revalidating, and entries refreshed ahead of their expiration, are refreshed by a pool
+ * of background threads started on demand, consuming a queue of copies of the requests that hit them.
+ */
+struct Refresh {
+    struct Refresh *next;
+    const struct HttpRequest *request;
+    const struct HttpCacheEntry *entry;
+};
+
+struct Refresher {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    pthread_t threads[HTTP_CACHE_REFRESH_THREADS];
+    struct Refresh *first;
+    struct Refresh *last;
+    bool running;
+    bool stopping;
+};
+
+static struct Refresher refresher = {
+        .lock=PTHREAD_MUTEX_INITIALIZER, .wakeup=PTHREAD_COND_INITIALIZER, .first=NULL, .last=NULL, .running=false,
+        .stopping=false
+};
+
+struct RopeReader {
+    const struct HttpRope *rope;
+    HttpRope_Cursor cursor;
+};
+
+/*
+ * The state of an ongoing transfer.
+ * Times are monotonic and expressed in microseconds, hooks are those registered when the transfer started.
+ */
+struct Transfer {
+    const struct HttpRequest *request;
+    CURL *curlHandler;
+    FILE *headersFile;
+    FILE *bodyFile;
+    uint64_t startTime;
+    uint64_t firstByteTime;
+    uint64_t windowStartTime;
+    curl_off_t windowStartBytes;
+    curl_off_t uploadSize;
+    struct HttpHooks hooks;
+    bool bodyStarted;
+    Error error;
+};
 
 static void cleanupEmptyString(void) {
     Text_delete(emptyString);
 }
 
-static Text readFile(FILE *file) {
+static void createEmptyString(void) {
+    emptyString = Text_new();
+    atexit(cleanupEmptyString);
+}
+
+// Must be called holding handlesLock.
+static void cleanupHandles(struct Handles *self) {
+    assert(self);
+    if (NULL != self->easy) {
+        curl_multi_cleanup(self->multi);
+        curl_easy_cleanup(self->easy);
+        self->easy = NULL;
+        self->multi = NULL;
+        if (NULL == self->previous) {
+            allHandles = self->next;
+        } else {
+            self->previous->next = self->next;
+        }
+        if (NULL != self->next) {
+            self->next->previous = self->previous;
+        }
+    }
+}
+
+static void deleteHandles(void *handles) {
+    assert(handles);
+    pthread_mutex_lock(&handlesLock);
+    cleanupHandles(handles);
+    pthread_mutex_unlock(&handlesLock);
+    Alligator_free(handles);
+}
+
+static void createHandlesKey(void) {
+    if (0 != pthread_key_create(&handlesKey, deleteHandles)) {
+        Panic_terminate("Unable to create handles thread key\n");
+    }
+}
+
+static struct Handles *getHandles(void) {
+    if (NULL == localHandles) {
+        pthread_once(&handlesKeyOnce, createHandlesKey);
+        struct Handles *handles = Option_unwrap(Alligator_malloc(sizeof(*handles)));
+        handles->easy = NULL;
+        handles->multi = NULL;
+        if (0 != pthread_setspecific(handlesKey, handles)) {
+            Panic_terminate("Unable to set handles thread key\n");
+        }
+        localHandles = handles;
+    }
+    if (NULL == localHandles->easy) {
+        struct Handles *handles = localHandles;
+        handles->easy = curl_easy_init();
+        handles->multi = curl_multi_init();
+        if (NULL == handles->easy || NULL == handles->multi) {
+            Panic_terminate("Out of memory\n");
+        }
+        pthread_mutex_lock(&handlesLock);
+        handles->previous = NULL;
+        handles->next = allHandles;
+        if (NULL != allHandles) {
+            allHandles->previous = handles;
+        }
+        allHandles = handles;
+        pthread_mutex_unlock(&handlesLock);
+    }
+    return localHandles;
+}
+
+static size_t fileLength(FILE *file) {
     assert(file);
     const long start = ftell(file);
     if (start < 0) {
@@ -53,7 +210,12 @@ static Text readFile(FILE *file) {
         Panic_terminate("Unable to determinate file size\n");
     }
     rewind(file);
-    const size_t length = (size_t) end;
+    return (size_t) end;
+}
+
+static Text readFile(FILE *file) {
+    assert(file);
+    const size_t length = fileLength(file);
     Text text = Text_withCapacity(length);
     const size_t read = fread(text, sizeof(text[0]), length, file);
     if (read != length) {
@@ -64,6 +226,279 @@ static Text readFile(FILE *file) {
     return text;
 }
 
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+static uint64_t phase(const curl_off_t end, const curl_off_t start) {
+    return end > start ? (uint64_t) (end - start) : 0;
+}
+
+static curl_off_t latest(const curl_off_t time, const curl_off_t previous) {
+    return time > previous ? time : previous;
+}
+
+static struct HttpTimings readTimings(CURL *curlHandler) {
+    assert(curlHandler);
+    curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0, firstByte = 0, total = 0, redirect = 0;
+    curl_off_t uploaded = 0, downloaded = 0;
+    long headerBytes = 0;
+
+    curl_easy_getinfo(curlHandler, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(curlHandler, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curlHandler, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curlHandler, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curlHandler, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+    curl_easy_getinfo(curlHandler, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curlHandler, CURLINFO_REDIRECT_TIME_T, &redirect);
+    curl_easy_getinfo(curlHandler, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+    curl_easy_getinfo(curlHandler, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    curl_easy_getinfo(curlHandler, CURLINFO_HEADER_SIZE, &headerBytes);
+
+    /*
+     * Every libcurl time is measured from the start, those of skipped steps are 0: appconnect for plain connections,
+     * connect and appconnect for reused ones. Each mark is raised to the previous one so that the phases add up.
+     */
+    connect = latest(connect, dns);
+    tls = latest(tls, connect);
+    pretransfer = latest(pretransfer, tls);
+    firstByte = latest(firstByte, pretransfer);
+    total = latest(total, firstByte);
+    return (struct HttpTimings) {
+            .dns=phase(dns, 0),
+            .connect=phase(connect, dns),
+            .tls=phase(tls, connect),
+            .pretransfer=phase(pretransfer, tls),
+            .firstByte=phase(firstByte, pretransfer),
+            .transfer=phase(total, firstByte),
+            .redirect=phase(redirect, 0),
+            .total=phase(total, 0),
+            .bytesUploaded=(uint64_t) uploaded,
+            .bytesDownloaded=(uint64_t) downloaded,
+            .headerBytes=(uint64_t) headerBytes
+    };
+}
+
+/*
+ * Timings of a transfer still in progress: libcurl refreshes the total time only now and then, so it is replaced with
+ * the time elapsed so far.
+ */
+static struct HttpTimings readPartialTimings(const struct Transfer *transfer) {
+    assert(transfer);
+    struct HttpTimings timings = readTimings(transfer->curlHandler);
+    const uint64_t started = timings.dns + timings.connect + timings.tls + timings.pretransfer + timings.firstByte;
+    timings.total = now() - transfer->startTime;
+    timings.transfer = timings.total > started ? timings.total - started : 0;
+    return timings;
+}
+
+static curl_off_t transferredBytes(CURL *curlHandler) {
+    curl_off_t downloaded = 0, uploaded = 0;
+    curl_easy_getinfo(curlHandler, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    curl_easy_getinfo(curlHandler, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+    return downloaded + uploaded;
+}
+
+static size_t writeHeaders(char *buffer, size_t size, size_t count, void *userdata) {
+    assert(userdata);
+    struct Transfer *transfer = userdata;
+    if (0 == transfer->firstByteTime) {
+        transfer->firstByteTime = transfer->windowStartTime = now();
+        transfer->windowStartBytes = transferredBytes(transfer->curlHandler);
+    }
+    const size_t written = fwrite(buffer, size, count, transfer->headersFile) * size;
+
+    // an empty line ends a block of headers, its status is looked up only for the probe and the hook
+    const bool reported = HTTP_PROBE_HEADERS_RECEIVED_ENABLED() || NULL != transfer->hooks.headersReceived;
+    const size_t length = size * count;
+    if (reported && length > 0 && length <= 2 && ('\r' == buffer[0] || '\n' == buffer[0])) {
+        long status = 0;
+        curl_easy_getinfo(transfer->curlHandler, CURLINFO_RESPONSE_CODE, &status);
+        HTTP_PROBE_HEADERS_RECEIVED(HttpRequest_getUrl(transfer->request), status);
+        if (NULL != transfer->hooks.headersReceived) {
+            const struct HttpTimings timings = readPartialTimings(transfer);
+            transfer->hooks.headersReceived(transfer->request, (enum HttpStatus) status, &timings,
+                                            transfer->hooks.context);
+        }
+    }
+    return written;
+}
+
+/*
+ * Used in place of the default write function only when the first body byte hook is registered.
+ */
+static size_t writeBody(char *buffer, size_t size, size_t count, void *userdata) {
+    assert(userdata);
+    struct Transfer *transfer = userdata;
+    if (!transfer->bodyStarted) {
+        transfer->bodyStarted = true;
+        const struct HttpTimings timings = readPartialTimings(transfer);
+        transfer->hooks.firstBodyByte(transfer->request, &timings, transfer->hooks.context);
+    }
+    return fwrite(buffer, size, count, transfer->bodyFile) * size;
+}
+
+#if defined(HTTP_PROBES_ENABLED) && LIBCURL_VERSION_NUM >= 0x075000
+/*
+ * Called by libcurl once the connection is ready, right before the request is sent.
+ */
+static int connectDone(void *userdata, char *primaryIp, char *localIp, int primaryPort, int localPort) {
+    assert(userdata);
+    const struct Transfer *transfer = userdata;
+    (void) localIp;
+    (void) localPort;
+    HTTP_PROBE_CONNECT_DONE(HttpRequest_getUrl(transfer->request), primaryIp, primaryPort);
+    return CURL_PREREQFUNC_OK;
+}
+#endif
+
+static int traceDebug(CURL *curlHandler, curl_infotype type, char *data, size_t size, void *userdata) {
+    (void) curlHandler;
+    (void) userdata;
+    switch (type) {
+        case CURLINFO_TEXT:
+            HttpTrace_record(HTTP_TRACE_TEXT, data, size);
+            break;
+        case CURLINFO_HEADER_IN:
+            HttpTrace_record(HTTP_TRACE_HEADER_IN, data, size);
+            break;
+        case CURLINFO_HEADER_OUT:
+            HttpTrace_record(HTTP_TRACE_HEADER_OUT, data, size);
+            break;
+        case CURLINFO_DATA_IN:
+            HttpTrace_record(HTTP_TRACE_DATA_IN, data, size);
+            break;
+        case CURLINFO_DATA_OUT:
+            HttpTrace_record(HTTP_TRACE_DATA_OUT, data, size);
+            break;
+        case CURLINFO_SSL_DATA_IN:
+            HttpTrace_record(HTTP_TRACE_TLS_DATA_IN, data, size);
+            break;
+        case CURLINFO_SSL_DATA_OUT:
+            HttpTrace_record(HTTP_TRACE_TLS_DATA_OUT, data, size);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+/*
+ * Checks the deadlines that libcurl does not enforce by itself with millisecond resolution.
+ *
+ * @return Ok if the transfer can go on, else the error the transfer must be aborted with;
+ * *wait is lowered to the number of milliseconds before the next deadline.
+ */
+static Error checkDeadlines(CURL *curlHandler, struct Transfer *transfer, long *wait) {
+    assert(curlHandler);
+    assert(transfer);
+    assert(wait);
+    const uint64_t currentTime = now();
+    const size_t firstByteTimeout = HttpRequest_getFirstByteTimeout(transfer->request);
+    const size_t lowSpeedLimit = HttpRequest_getLowSpeedLimit(transfer->request);
+    const size_t lowSpeedTime = HttpRequest_getLowSpeedTime(transfer->request);
+    const bool checkSpeed = lowSpeedLimit > 0 && lowSpeedTime > 0;
+
+    if (0 == transfer->firstByteTime && firstByteTimeout > 0) {
+        const uint64_t deadline = transfer->startTime + (uint64_t) firstByteTimeout * 1000;
+        if (currentTime >= deadline) {
+            return HttpError_FirstByteTimedOut;
+        }
+        if ((deadline - currentTime) / 1000 + 1 < (uint64_t) *wait) {
+            *wait = (long) ((deadline - currentTime) / 1000 + 1);
+        }
+    }
+
+    // the request body is sent before the first byte of the response, its window starts at the first byte sent
+    if (checkSpeed && 0 == transfer->firstByteTime && transfer->uploadSize > 0) {
+        curl_off_t uploaded = 0;
+        curl_easy_getinfo(curlHandler, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+        if (0 == uploaded || uploaded >= transfer->uploadSize) {
+            return Ok;
+        }
+        if (0 == transfer->windowStartTime) {
+            transfer->windowStartTime = currentTime;
+            transfer->windowStartBytes = transferredBytes(curlHandler);
+        }
+    }
+    if (checkSpeed && 0 != transfer->windowStartTime) {
+        const uint64_t deadline = transfer->windowStartTime + (uint64_t) lowSpeedTime * 1000;
+        if (currentTime >= deadline) {
+            const curl_off_t bytes = transferredBytes(curlHandler);
+            const uint64_t elapsed = currentTime - transfer->windowStartTime;
+            if ((uint64_t) (bytes - transfer->windowStartBytes) * 1000000 < (uint64_t) lowSpeedLimit * elapsed) {
+                return HttpError_TransferStalled;
+            }
+            transfer->windowStartTime = currentTime;
+            transfer->windowStartBytes = bytes;
+        } else if ((deadline - currentTime) / 1000 + 1 < (uint64_t) *wait) {
+            *wait = (long) ((deadline - currentTime) / 1000 + 1);
+        }
+    }
+    return Ok;
+}
+
+/*
+ * Drives the transfer through a multi handle, so that deadlines can be checked between socket events.
+ * When a deadline is exceeded the transfer is aborted and transfer->error is set.
+ */
+static CURLcode perform(CURLM *multiHandler, CURL *curlHandler, struct Transfer *transfer) {
+    assert(multiHandler);
+    assert(curlHandler);
+    assert(transfer);
+    CURLcode result = CURLE_OK;
+    int running = 1;
+
+    transfer->startTime = now();
+    curl_multi_add_handle(multiHandler, curlHandler);
+
+    while (running) {
+        long wait = TRANSFER_MAX_POLL_MILLISECONDS;
+        if (CURLM_OK != curl_multi_perform(multiHandler, &running)) {
+            result = CURLE_FAILED_INIT;
+            break;
+        }
+        if (!running) {
+            int pending;
+            CURLMsg *message;
+            while (NULL != (message = curl_multi_info_read(multiHandler, &pending))) {
+                if (CURLMSG_DONE == message->msg) {
+                    result = message->data.result;
+                }
+            }
+            break;
+        }
+        if (Ok != (transfer->error = checkDeadlines(curlHandler, transfer, &wait))) {
+            result = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+        if (CURLM_OK != curl_multi_poll(multiHandler, NULL, 0, (int) wait, NULL)) {
+            result = CURLE_FAILED_INIT;
+            break;
+        }
+    }
+
+    curl_multi_remove_handle(multiHandler, curlHandler);
+    return result;
+}
+
+static size_t readRope(char *buffer, size_t size, size_t count, void *userdata) {
+    assert(userdata);
+    struct RopeReader *reader = userdata;
+    return HttpRope_read(reader->rope, &reader->cursor, buffer, size * count);
+}
+
+static int seekRope(void *userdata, curl_off_t offset, int origin) {
+    assert(userdata);
+    struct RopeReader *reader = userdata;
+    if (SEEK_SET != origin || offset < 0) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    return HttpRope_seek(reader->rope, &reader->cursor, (size_t) offset) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
 void Http_initialize(void) {
     if (!initialized) {
         const CURLcode e = curl_global_init(CURL_GLOBAL_ALL);
@@ -74,51 +509,101 @@ void Http_initialize(void) {
     }
 }
 
+static void deleteRefresh(struct Refresh *refresh) {
+    HttpCacheEntry_endRefresh(refresh->entry);
+    HttpCacheEntry_release(refresh->entry);
+    Alligator_free(refresh);
+}
+
+static void stopRefresher(void) {
+    pthread_mutex_lock(&refresher.lock);
+    const bool running = refresher.running;
+    refresher.stopping = true;
+    pthread_cond_broadcast(&refresher.wakeup);
+    pthread_mutex_unlock(&refresher.lock);
+    for (size_t i = 0; running && i < HTTP_CACHE_REFRESH_THREADS; i++) {
+        pthread_join(refresher.threads[i], NULL);
+    }
+
+    pthread_mutex_lock(&refresher.lock);
+    while (NULL != refresher.first) {
+        struct Refresh *refresh = refresher.first;
+        refresher.first = refresh->next;
+        HttpRequest_delete(refresh->request);
+        deleteRefresh(refresh);
+    }
+    refresher.last = NULL;
+    refresher.running = false;
+    refresher.stopping = false;
+    pthread_mutex_unlock(&refresher.lock);
+}
+
 void Http_terminate(void) {
     if (initialized) {
+        stopRefresher();
+        if (NULL != localHandles) {
+            pthread_setspecific(handlesKey, NULL);
+            deleteHandles(localHandles);
+            localHandles = NULL;
+        }
+        pthread_mutex_lock(&handlesLock);
+        while (NULL != allHandles) {
+            cleanupHandles(allHandles);
+        }
+        pthread_mutex_unlock(&handlesLock);
         curl_global_cleanup();
+        initialized = false;
     }
 }
 
+struct HttpHooks Http_registerHooks(const struct HttpHooks newHooks) {
+    const struct HttpHooks previousHooks = hooks;
+    hooks = newHooks;
+    return previousHooks;
+}
+
 TextView Http_getEmptyString(void) {
-    if (NULL == emptyString) {
-        emptyString = Text_new();
-        atexit(cleanupEmptyString);
-    }
+    pthread_once(&emptyStringOnce, createEmptyString);
     return emptyString;
 }
 
-Http_FireResult HttpRequest_fire(const struct HttpRequest **ref) {
-    assert(ref);
-    assert(*ref);
-    assert(initialized);
+static Http_FireResult fireRequest(const struct HttpRequest **ref, TextView conditionalHeaders) {
     Error error;
     CURL *curlHandler = NULL;
     struct curl_slist *curlHeaders = NULL;
     const struct HttpRequest *request = *ref;
     FILE *responseHeadersFile, *responseBodyFile = NULL;
 
-    curlHandler = curl_easy_init();
-    if (NULL == curlHandler) {
-        Panic_terminate("Out of memory\n");
-    }
+    struct Handles *handles = getHandles();
+    curlHandler = handles->easy;
 
     responseHeadersFile = tmpfile();
     if (NULL == responseHeadersFile) {
         Panic_terminate("Unable to open temporary file\n");
     }
-
     responseBodyFile = tmpfile();
     if (NULL == responseBodyFile) {
         Panic_terminate("Unable to open temporary file\n");
     }
 
+    struct Transfer transfer = {
+            .request=request, .curlHandler=curlHandler, .headersFile=responseHeadersFile, .bodyFile=responseBodyFile,
+            .uploadSize=0, .hooks=hooks, .bodyStarted=false, .error=Ok
+    };
+
     if (Text_length(HttpRequest_getHeaders(request)) > 0) {
         curlHeaders = curl_slist_append(curlHeaders, HttpRequest_getHeaders(request));
         if (NULL == curlHeaders) {
             Panic_terminate("Out of memory\n");
         }
     }
+    if (NULL != conditionalHeaders && !Text_isEmpty(conditionalHeaders)) {
+        struct curl_slist *headers = curl_slist_append(curlHeaders, conditionalHeaders);
+        if (NULL == headers) {
+            Panic_terminate("Out of memory\n");
+        }
+        curlHeaders = headers;
+    }
 
     // Set request url and method
     curl_easy_setopt(curlHandler, CURLOPT_URL, HttpRequest_getUrl(request));
@@ -128,36 +613,80 @@ Http_FireResult HttpRequest_fire(const struct HttpRequest **ref) {
     curl_easy_setopt(curlHandler, CURLOPT_HTTPHEADER, curlHeaders);
 
     // Set request body
-    TextView requestBody = HttpRequest_getBody(request);
-    curl_easy_setopt(curlHandler, CURLOPT_POSTFIELDS, requestBody);
-    curl_easy_setopt(curlHandler, CURLOPT_POSTFIELDSIZE, Text_length(requestBody));
+    struct RopeReader ropeReader = {.rope=HttpRequest_getRope(request)};
+    if (NULL != ropeReader.rope) {
+        ropeReader.cursor = HttpRope_begin(ropeReader.rope);
+        curl_easy_setopt(curlHandler, CURLOPT_POST, 1L);
+        curl_easy_setopt(curlHandler, CURLOPT_READFUNCTION, readRope);
+        curl_easy_setopt(curlHandler, CURLOPT_READDATA, &ropeReader);
+        curl_easy_setopt(curlHandler, CURLOPT_SEEKFUNCTION, seekRope);
+        curl_easy_setopt(curlHandler, CURLOPT_SEEKDATA, &ropeReader);
+        curl_easy_setopt(curlHandler, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) HttpRope_length(ropeReader.rope));
+        transfer.uploadSize = (curl_off_t) HttpRope_length(ropeReader.rope);
+    } else {
+        TextView requestBody = HttpRequest_getBody(request);
+        curl_easy_setopt(curlHandler, CURLOPT_POSTFIELDS, requestBody);
+        curl_easy_setopt(curlHandler, CURLOPT_POSTFIELDSIZE, Text_length(requestBody));
+        transfer.uploadSize = (curl_off_t) Text_length(requestBody);
+    }
 
     // Set request parameters
     curl_easy_setopt(curlHandler, CURLOPT_FOLLOWLOCATION, HttpRequest_getFollowLocation(request));
     curl_easy_setopt(curlHandler, CURLOPT_SSL_VERIFYPEER, HttpRequest_getPeerVerification(request));
     curl_easy_setopt(curlHandler, CURLOPT_SSL_VERIFYHOST, HttpRequest_getHostVerification(request));
-    curl_easy_setopt(curlHandler, CURLOPT_TIMEOUT, HttpRequest_getTimeout(request));
+    curl_easy_setopt(curlHandler, CURLOPT_TIMEOUT_MS, (long) HttpRequest_getTotalTimeout(request));
+    curl_easy_setopt(curlHandler, CURLOPT_CONNECTTIMEOUT_MS, (long) HttpRequest_getConnectTimeout(request));
+    curl_easy_setopt(curlHandler, CURLOPT_FRESH_CONNECT, HttpRequest_getKeepAlive(request) ? 0L : 1L);
+    curl_easy_setopt(curlHandler, CURLOPT_FORBID_REUSE, HttpRequest_getKeepAlive(request) ? 0L : 1L);
 
     // Set request callbacks in order to store the response data
-    curl_easy_setopt(curlHandler, CURLOPT_HEADERDATA, responseHeadersFile);
-    curl_easy_setopt(curlHandler, CURLOPT_WRITEDATA, responseBodyFile);
+    curl_easy_setopt(curlHandler, CURLOPT_HEADERFUNCTION, writeHeaders);
+    curl_easy_setopt(curlHandler, CURLOPT_HEADERDATA, &transfer);
+    if (NULL != transfer.hooks.firstBodyByte) {
+        curl_easy_setopt(curlHandler, CURLOPT_WRITEFUNCTION, writeBody);
+        curl_easy_setopt(curlHandler, CURLOPT_WRITEDATA, &transfer);
+    } else {
+        curl_easy_setopt(curlHandler, CURLOPT_WRITEDATA, responseBodyFile);
+    }
 
-#ifdef HTTP_DEBUG
-    // Set verbose debug output
-    curl_easy_setopt(curlHandler, CURLOPT_VERBOSE, 1L);
+#if defined(HTTP_PROBES_ENABLED) && LIBCURL_VERSION_NUM >= 0x075000
+    if (HTTP_PROBE_CONNECT_DONE_ENABLED()) {
+        curl_easy_setopt(curlHandler, CURLOPT_PREREQFUNCTION, connectDone);
+        curl_easy_setopt(curlHandler, CURLOPT_PREREQDATA, &transfer);
+    }
 #endif
 
-    const CURLcode e = curl_easy_perform(curlHandler);
+    // Set debug output into the trace ring
+    const bool tracing = Http_isTracing();
+    if (tracing) {
+        curl_easy_setopt(curlHandler, CURLOPT_VERBOSE, 1L);
+        curl_easy_setopt(curlHandler, CURLOPT_DEBUGFUNCTION, traceDebug);
+        HttpTrace_requestStarted(HttpMethod_explain(HttpRequest_getMethod(request)), HttpRequest_getUrl(request));
+    }
+
+    if (NULL != transfer.hooks.beforeSend) {
+        transfer.hooks.beforeSend(request, transfer.hooks.context);
+    }
+
+    HTTP_PROBE_REQUEST_START(HttpMethod_explain(HttpRequest_getMethod(request)), HttpRequest_getUrl(request));
+    const CURLcode e = perform(handles->multi, curlHandler, &transfer);
     switch (e) {
         case CURLE_OK:
             error = Ok;
             break;
+        case CURLE_ABORTED_BY_CALLBACK:
+            error = Ok == transfer.error ? HttpError_NetworkingError : transfer.error;
+            break;
         case CURLE_COULDNT_CONNECT:
             error = HttpError_ConnectionFailed;
             break;
-        case CURLE_OPERATION_TIMEDOUT:
-            error = HttpError_ConnectionTimedOut;
+        case CURLE_OPERATION_TIMEDOUT: {
+            // reused connections report no connect time, the transfer starts once the connection is ready
+            curl_off_t pretransferTime = 0;
+            curl_easy_getinfo(curlHandler, CURLINFO_PRETRANSFER_TIME_T, &pretransferTime);
+            error = 0 == pretransferTime ? HttpError_ConnectionTimedOut : HttpError_TransferTimedOut;
             break;
+        }
         case CURLE_SSL_CONNECT_ERROR:
             error = HttpError_ConnectionSSLFailed;
             break;
@@ -178,7 +707,25 @@ Http_FireResult HttpRequest_fire(const struct HttpRequest **ref) {
             error = HttpError_NetworkingError;
     }
 
+    long responseStatus = 0;
+    curl_easy_getinfo(curlHandler, CURLINFO_RESPONSE_CODE, &responseStatus);
+    const struct HttpTimings timings = readTimings(curlHandler);
+    HttpMetrics_record(HttpRequest_getUrl(request), (enum HttpStatus) responseStatus, error, &timings);
+    long connects = 0;
+    curl_easy_getinfo(curlHandler, CURLINFO_NUM_CONNECTS, &connects);
+    HttpSlowLog_record(HttpMethod_explain(HttpRequest_getMethod(request)), HttpRequest_getUrl(request),
+                       (enum HttpStatus) responseStatus, error, &timings, 0 == connects && timings.headerBytes > 0);
+    if (tracing) {
+        if (Ok == error) {
+            HttpTrace_requestCompleted((enum HttpStatus) responseStatus, &timings);
+        } else {
+            HttpTrace_requestFailed(error, &timings);
+        }
+    }
+
     if (Ok == error) {
+        HTTP_PROBE_BODY_COMPLETE(HttpRequest_getUrl(request), responseStatus, timings.bytesDownloaded,
+                                 timings.bytesUploaded);
         struct HttpResponseBuilder *responseBuilder = HttpResponseBuilder_new(ref);
 
         // set response effective url
@@ -188,33 +735,186 @@ Http_FireResult HttpRequest_fire(const struct HttpRequest **ref) {
             HttpResponseBuilder_setUrl(responseBuilder, Atom_fromLiteral(tmp));
         }
 
+        // set response timings
+        HttpResponseBuilder_setTimings(responseBuilder, timings);
+
         // set response status
-        long responseStatus;
-        curl_easy_getinfo(curlHandler, CURLINFO_RESPONSE_CODE, &responseStatus);
         HttpResponseBuilder_setStatus(responseBuilder, (enum HttpStatus) responseStatus);
 
-        // set response headers
+        // set response headers and body, accounting their texts to the response
+        const char *tag = Alligator_enterTag("HttpResponse");
         Text responseHeaders = readFile(responseHeadersFile);
         HttpResponseBuilder_setHeaders(responseBuilder, &responseHeaders);
-
-        // set response body
-        Text responseBody = readFile(responseBodyFile);
-        HttpResponseBuilder_setBody(responseBuilder, &responseBody);
+        const size_t mappedBodyThreshold = Http_getMappedBodyThreshold();
+        const size_t responseBodyLength = fileLength(responseBodyFile);
+        if (mappedBodyThreshold > 0 && responseBodyLength >= mappedBodyThreshold) {
+            const struct HttpSharedText *responseBody = HttpMappedText_fromFile(responseBodyFile, responseBodyLength);
+            HttpResponseBuilder_setSharedBody(responseBuilder, responseBody);
+            HttpSharedText_release(responseBody);
+        } else {
+            Text responseBody = readFile(responseBodyFile);
+            HttpResponseBuilder_setBody(responseBuilder, &responseBody);
+        }
+        Alligator_exitTag(tag);
 
         // perform cleanups
         curl_slist_free_all(curlHeaders);
-        curl_easy_cleanup(curlHandler);
+        curl_easy_reset(curlHandler);
         fclose(responseHeadersFile);
         fclose(responseBodyFile);
 
-        return Http_FireResult_ok(HttpResponseBuilder_build(&responseBuilder));
+        // release the request body once curl can no longer rewind it (redirects and auth may resend it)
+        const size_t requestBodyLength = NULL != ropeReader.rope ? HttpRope_length(ropeReader.rope) :
+                                         Text_length(HttpRequest_getBody(request));
+        if (requestBodyLength >= HttpRequest_getBodyReleaseThreshold(request)) {
+            HttpRequest_releaseBody(request);
+        }
+
+        const struct HttpResponse *response = HttpResponseBuilder_build(&responseBuilder);
+        if (NULL != transfer.hooks.completed) {
+            transfer.hooks.completed(request, response, &timings, transfer.hooks.context);
+        }
+        return Http_FireResult_ok(response);
     } else {
+        HTTP_PROBE_REQUEST_ERROR(HttpRequest_getUrl(request), Error_explain(error));
+
         // perform cleanups
         curl_slist_free_all(curlHeaders);
-        curl_easy_cleanup(curlHandler);
+        curl_easy_reset(curlHandler);
         fclose(responseHeadersFile);
         fclose(responseBodyFile);
 
+        if (NULL != transfer.hooks.failed) {
+            transfer.hooks.failed(request, error, &timings, transfer.hooks.context);
+        }
         return Http_FireResult_error(error);
     }
 }
+
+static bool isServerFailure(const enum HttpStatus status) {
+    return HTTP_STATUS_INTERNAL_SERVER_ERROR == status || HTTP_STATUS_BAD_GATEWAY == status ||
+           HTTP_STATUS_SERVICE_UNAVAILABLE == status || HTTP_STATUS_GATEWAY_TIMEOUT == status;
+}
+
+/*
+ * Sends the request to the server, revalidating the cache entry if any and storing the response if cacheable.
+ * If staleIfError, entries allowing it with stale-if-error answer in place of errors and server failures.
+ */
+static Http_FireResult fetch(const struct HttpRequest **ref, const bool cacheable, const struct HttpCacheEntry *entry,
+                             const bool staleIfError) {
+    if (!cacheable) {
+        return fireRequest(ref, NULL);
+    }
+    Http_FireResult result = fireRequest(ref, NULL == entry ? NULL : HttpCacheEntry_getConditionalHeaders(entry));
+    if (Http_FireResult_isOk(result)) {
+        const struct HttpResponse *response = Http_FireResult_unwrap(result);
+        if (NULL != entry && HTTP_STATUS_NOT_MODIFIED == HttpResponse_getStatus(response)) {
+            response = HttpCacheEntry_revalidate(entry, &response);
+            return Http_FireResult_ok(response);
+        }
+        if (staleIfError && NULL != entry && isServerFailure(HttpResponse_getStatus(response)) &&
+            HttpCacheEntry_allowsStaleIfError(entry, HttpResponse_getRequest(response))) {
+            const struct HttpRequest *request = HttpResponse_takeRequest(&response);
+            return Http_FireResult_ok(HttpCacheEntry_respondStale(entry, &request));
+        }
+        HttpCache_store(response);
+    } else if (staleIfError && NULL != entry && HttpCacheEntry_allowsStaleIfError(entry, *ref)) {
+        return Http_FireResult_ok(HttpCacheEntry_respondStale(entry, ref));
+    }
+    return result;
+}
+
+static void *refreshEntries(void *argument) {
+    (void) argument;
+    pthread_mutex_lock(&refresher.lock);
+    while (true) {
+        while (!refresher.stopping && NULL == refresher.first) {
+            pthread_cond_wait(&refresher.wakeup, &refresher.lock);
+        }
+        if (refresher.stopping) {
+            break;
+        }
+        struct Refresh *refresh = refresher.first;
+        refresher.first = refresh->next;
+        refresher.last = NULL == refresher.first ? NULL : refresher.last;
+        pthread_mutex_unlock(&refresher.lock);
+
+        Http_FireResult result = fetch(&refresh->request, true, refresh->entry, false);
+        if (Http_FireResult_isOk(result)) {
+            HttpResponse_delete(Http_FireResult_unwrap(result));
+        } else {
+            HttpRequest_delete(refresh->request);
+        }
+        deleteRefresh(refresh);
+        pthread_mutex_lock(&refresher.lock);
+    }
+    pthread_mutex_unlock(&refresher.lock);
+    return NULL;
+}
+
+// Queues the refresh of entry with a copy of request, unless the entry is already being refreshed.
+static void scheduleRefresh(const struct HttpRequest *request, const struct HttpCacheEntry *entry) {
+    if (!HttpCacheEntry_beginRefresh(entry)) {
+        return;
+    }
+    const char *tag = Alligator_enterTag("HttpCache");
+    struct Refresh *refresh = Option_unwrap(Alligator_malloc(sizeof(*refresh)));
+    Alligator_exitTag(tag);
+    refresh->next = NULL;
+    refresh->request = HttpRequest_duplicateWithoutBody(request);
+    refresh->entry = HttpCacheEntry_retain(entry);
+
+    pthread_mutex_lock(&refresher.lock);
+    if (!refresher.running) {
+        for (size_t i = 0; i < HTTP_CACHE_REFRESH_THREADS; i++) {
+            if (0 != pthread_create(&refresher.threads[i], NULL, refreshEntries, NULL)) {
+                Panic_terminate("Unable to start the cache refresher\n");
+            }
+        }
+        refresher.running = true;
+    }
+    if (NULL == refresher.last) {
+        refresher.first = refresh;
+    } else {
+        refresher.last->next = refresh;
+    }
+    refresher.last = refresh;
+    pthread_cond_signal(&refresher.wakeup);
+    pthread_mutex_unlock(&refresher.lock);
+}
+
+Http_FireResult HttpRequest_fire(const struct HttpRequest **ref) {
+    assert(ref);
+    assert(*ref);
+    assert(initialized);
+    const bool cacheable = HttpCache_accepts(*ref);
+    const struct HttpCacheEntry *entry = cacheable ? HttpCache_lookup(*ref) : NULL;
+    if (NULL != entry && HttpCacheEntry_isFresh(entry, *ref)) {
+        if (HttpCacheEntry_isExpiring(entry)) {
+            scheduleRefresh(*ref, entry);
+        }
+        const struct HttpResponse *response = HttpCacheEntry_respond(entry, ref);
+        HttpCacheEntry_release(entry);
+        return Http_FireResult_ok(response);
+    }
+    if (NULL != entry && HttpCacheEntry_allowsStaleWhileRevalidate(entry, *ref)) {
+        scheduleRefresh(*ref, entry);
+        const struct HttpResponse *response = HttpCacheEntry_respondStale(entry, ref);
+        HttpCacheEntry_release(entry);
+        return Http_FireResult_ok(response);
+    }
+
+    // identical requests in flight share the transfer of the first one
+    bool leader = true;
+    struct HttpFlight *flight = HttpSingleFlight_accepts(*ref) ? HttpSingleFlight_join(*ref, &leader) : NULL;
+    if (!leader) {
+        HttpCacheEntry_release(entry);
+        return HttpFlight_await(flight, ref);
+    }
+    Http_FireResult result = fetch(ref, cacheable, entry, true);
+    HttpCacheEntry_release(entry);
+    if (NULL != flight) {
+        HttpFlight_land(flight, result);
+    }
+    return result;
+}
@@ -35,13 +35,25 @@
 #include <text/text.h>
 #include <error/error.h>
 
+#include <http_cache.h>
+#include <http_disk_cache.h>
 #include <http_error.h>
 #include <http_fire_result.h>
+#include <http_hooks.h>
+#include <http_mapped_text.h>
 #include <http_maybe_text.h>
 #include <http_method.h>
+#include <http_metrics.h>
 #include <http_request.h>
 #include <http_response.h>
+#include <http_rope.h>
+#include <http_shared_cache.h>
+#include <http_shared_text.h>
+#include <http_single_flight.h>
+#include <http_slow_log.h>
 #include <http_status.h>
+#include <http_timings.h>
+#include <http_trace.h>
 
 #if !(defined(__GNUC__) || defined(__clang__))
 #define __attribute__(...)
@@ -61,8 +73,12 @@ extern void Http_initialize(void);
 /**
  * Terminates the http module freeing memory.
  * 
+ * The connections kept alive by every thread are closed, threads still running open new ones once the module is
+ * initialized again.
+ *
  * @attention must be called at least once in every program that uses the http module; After calling this functions 
  * it's not allowed to fire a request without calling Http_initialize() before.
+ * @attention must not be called while requests are being fired on other threads.
  */
 extern void Http_terminate(void);
 
@@ -0,0 +1,1122 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <time.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <curl/curl.h>
+#include <panic/panic.h>
+#include <alligator/alligator.h>
+
+#define INITIAL_BUCKETS     16
+#define RECORD_MAGIC        UINT64_C(0x6874747072656331)
+#define RECORD_TEXTS        6
+#define RECORD_ALIGNMENT    16
+#define RECORD_PARTS        (RECORD_TEXTS + 3)
+
+/*
+ * Entries are immutable once stored, but for their references and refreshing flag: revalidations store a refreshed
+ * copy sharing the same body.
+ * The cache holds a reference to every stored entry, lookups hand out further references.
+ */
+struct HttpCacheEntry {
+    struct HttpCacheEntry *next;        // bucket chain
+    struct HttpCacheEntry *newer;       // least recently used list
+    struct HttpCacheEntry *older;
+    Atom url;
+    Atom effectiveUrl;
+    Text vary;                          // request header names listed by Vary, NULL if none
+    Text varyValues;                    // values of those request headers, each one followed by a newline
+    Text headers;                       // the last block of the response headers
+    Text conditionalHeaders;
+    const struct HttpSharedText *body;
+    uint64_t hash;
+    time_t responseTime;
+    time_t initialAge;
+    time_t lifetime;
+    size_t size;
+    size_t references;
+    time_t staleWhileRevalidate;        // seconds the entry may be served stale while refreshed in the background
+    time_t staleIfError;                // seconds the entry may be served stale when the server fails
+    enum HttpStatus status;
+    bool noCache;
+    bool mustRevalidate;
+    bool refreshing;
+};
+
+struct Shard {
+    pthread_mutex_t lock;
+    struct HttpCacheEntry **buckets;
+    size_t bucketsLength;
+    struct HttpCacheEntry *newest;
+    struct HttpCacheEntry *oldest;
+    size_t entries;
+    size_t bytes;
+    size_t hits;
+    size_t misses;
+    size_t revalidations;
+    size_t staleHits;
+    size_t refreshes;
+    size_t sharedLoads;
+    size_t diskLoads;
+    size_t stores;
+    size_t evictions;
+};
+
+/*
+ * Entries are written to the disk and shared caches as a record, followed by url, effective url, vary, vary values, headers and
+ * conditional headers, each one terminated by a NUL byte, then by the body, placed far enough from them to be mapped
+ * in place with HttpMappedText_fromPath or HttpMappedText_fromMapping.
+ */
+struct Record {
+    uint64_t magic;
+    uint64_t lengths[RECORD_TEXTS];
+    uint64_t bodyOffset;
+    uint64_t bodyLength;
+    uint32_t status;
+    uint32_t hasVary;
+};
+
+struct Field {
+    const char *name;
+    size_t nameLength;
+    const char *value;
+    size_t valueLength;
+};
+
+struct Directives {
+    long maxAge;                        // -1 if missing
+    long staleWhileRevalidate;
+    long staleIfError;
+    bool noStore;
+    bool noCache;
+    bool mustRevalidate;
+};
+
+static size_t capacity = 0;
+static size_t refreshAhead = 0;
+static struct Shard shards[HTTP_CACHE_SHARDS];
+static pthread_once_t shardsOnce = PTHREAD_ONCE_INIT;
+
+static void initializeShards(void) {
+    for (size_t i = 0; i < HTTP_CACHE_SHARDS; i++) {
+        if (0 != pthread_mutex_init(&shards[i].lock, NULL)) {
+            Panic_terminate("Unable to initialize mutex\n");
+        }
+    }
+}
+
+static struct Shard *getShard(const size_t index) {
+    pthread_once(&shardsOnce, initializeShards);
+    return &shards[index];
+}
+
+static struct Shard *shardOf(const uint64_t hash) {
+    return getShard(hash % HTTP_CACHE_SHARDS);
+}
+
+static uint64_t hashOf(Atom url) {
+    // atoms are interned: equal urls share the same address
+    uint64_t hash = (uint64_t) (uintptr_t) url;
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static size_t shardCapacity(void) {
+    return Http_getCacheCapacity() / HTTP_CACHE_SHARDS;
+}
+
+/*
+ * Headers parsing
+ */
+
+static bool isSpace(const char c) {
+    return ' ' == c || '\t' == c;
+}
+
+// Reads the next "name: value" line starting from cursor, skipping status lines and blank lines.
+static bool nextField(const char **cursor, struct Field *field) {
+    const char *line = *cursor;
+    while ('\0' != *line) {
+        const char *newline = strchr(line, '\n');
+        const char *next = NULL == newline ? line + strlen(line) : newline + 1;
+        const char *end = NULL == newline ? next : newline;
+        while (end > line && '\r' == end[-1]) {
+            end--;
+        }
+        const char *colon = memchr(line, ':', (size_t) (end - line));
+        if (NULL != colon && colon > line) {
+            const char *value = colon + 1;
+            while (value < end && isSpace(*value)) {
+                value++;
+            }
+            while (end > value && isSpace(end[-1])) {
+                end--;
+            }
+            field->name = line;
+            field->nameLength = (size_t) (colon - line);
+            field->value = value;
+            field->valueLength = (size_t) (end - value);
+            *cursor = next;
+            return true;
+        }
+        line = next;
+    }
+    *cursor = line;
+    return false;
+}
+
+static bool isNamed(const struct Field *field, const char *name, const size_t length) {
+    return field->nameLength == length && 0 == strncasecmp(field->name, name, length);
+}
+
+static bool findField(const char *headers, const char *name, const size_t length, struct Field *field) {
+    while (nextField(&headers, field)) {
+        if (isNamed(field, name, length)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads the next comma separated token of a list, trimmed.
+static bool nextToken(const char **cursor, const char *end, const char **token, size_t *length) {
+    const char *start = *cursor;
+    while (start < end && (isSpace(*start) || ',' == *start)) {
+        start++;
+    }
+    if (start >= end) {
+        *cursor = end;
+        return false;
+    }
+    const char *stop = memchr(start, ',', (size_t) (end - start));
+    *cursor = NULL == stop ? end : stop + 1;
+    stop = NULL == stop ? end : stop;
+    while (stop > start && isSpace(stop[-1])) {
+        stop--;
+    }
+    *token = start;
+    *length = (size_t) (stop - start);
+    return true;
+}
+
+static long parseSeconds(const char *digits, const size_t length) {
+    long seconds = 0;
+    size_t i = 0;
+    if (length > 0 && '"' == digits[0]) {
+        i++;
+    }
+    for (; i < length && digits[i] >= '0' && digits[i] <= '9'; i++) {
+        // saturate at about 68 years, as RFC 9111 suggests for delta-seconds overflows
+        seconds = seconds < INT32_MAX / 10 ? seconds * 10 + (digits[i] - '0') : INT32_MAX;
+    }
+    return seconds;
+}
+
+static bool isToken(const char *token, const size_t length, const char *name) {
+    const size_t nameLength = strlen(name);
+    return length >= nameLength && 0 == strncasecmp(token, name, nameLength) &&
+           (length == nameLength || '=' == token[nameLength]);
+}
+
+static struct Directives directivesOf(const char *headers) {
+    struct Directives directives = {
+            .maxAge=-1, .staleWhileRevalidate=0, .staleIfError=0, .noStore=false, .noCache=false, .mustRevalidate=false
+    };
+    struct Field field;
+    while (nextField(&headers, &field)) {
+        if (!isNamed(&field, "Cache-Control", 13) && !isNamed(&field, "Pragma", 6)) {
+            continue;
+        }
+        const char *cursor = field.value, *end = field.value + field.valueLength, *token = NULL;
+        size_t length = 0;
+        while (nextToken(&cursor, end, &token, &length)) {
+            if (isToken(token, length, "no-store")) {
+                directives.noStore = true;
+            } else if (isToken(token, length, "no-cache")) {
+                directives.noCache = true;
+            } else if (isToken(token, length, "max-age") && length > 8) {
+                directives.maxAge = parseSeconds(token + 8, length - 8);
+            } else if (isToken(token, length, "stale-while-revalidate") && length > 23) {
+                directives.staleWhileRevalidate = parseSeconds(token + 23, length - 23);
+            } else if (isToken(token, length, "stale-if-error") && length > 15) {
+                directives.staleIfError = parseSeconds(token + 15, length - 15);
+            } else if (isToken(token, length, "must-revalidate") || isToken(token, length, "proxy-revalidate")) {
+                directives.mustRevalidate = true;
+            }
+        }
+    }
+    return directives;
+}
+
+static time_t parseDate(const struct Field *field) {
+    char buffer[64];
+    if (field->valueLength >= sizeof(buffer)) {
+        return -1;
+    }
+    memcpy(buffer, field->value, field->valueLength);
+    buffer[field->valueLength] = '\0';
+    return curl_getdate(buffer, NULL);
+}
+
+// Copies the last block of headers, the one of the final response when redirects have been followed.
+static Text lastBlockOf(TextView headers) {
+    const char *block = headers;
+    for (const char *line = headers; NULL != line; line = strchr(line, '\n')) {
+        line += '\n' == *line;
+        if (0 == strncmp(line, "HTTP/", 5)) {
+            block = line;
+        }
+    }
+    return Text_fromBytes(block, Text_length(headers) - (size_t) (block - headers));
+}
+
+// Updates the stored headers with the ones of a 304 response, which must not change the body framing.
+static Text mergeHeaders(TextView stored, TextView update) {
+    const char *statusEnd = strchr(stored, '\n');
+    Text merged = Text_fromBytes(stored, NULL == statusEnd ? 0 : (size_t) (statusEnd + 1 - stored));
+    struct Field field, updated;
+    const char *cursor = stored;
+    while (nextField(&cursor, &field)) {
+        if (!findField(update, field.name, field.nameLength, &updated) || isNamed(&field, "Content-Length", 14)) {
+            merged = Text_appendFormat(&merged, "%.*s: %.*s\r\n", (int) field.nameLength, field.name,
+                                       (int) field.valueLength, field.value);
+        }
+    }
+    cursor = update;
+    while (nextField(&cursor, &field)) {
+        if (!isNamed(&field, "Content-Length", 14)) {
+            merged = Text_appendFormat(&merged, "%.*s: %.*s\r\n", (int) field.nameLength, field.name,
+                                       (int) field.valueLength, field.value);
+        }
+    }
+    return Text_appendLiteral(&merged, "\r\n");
+}
+
+/*
+ * Vary
+ */
+
+// Compares the request headers named by vary with the values stored for them.
+static bool varyMatches(const char *vary, const char *stored, TextView requestHeaders) {
+    if (NULL == vary) {
+        return true;
+    }
+    const char *cursor = vary, *end = vary + strlen(vary), *name = NULL;
+    size_t length = 0;
+    struct Field field;
+    while (nextToken(&cursor, end, &name, &length)) {
+        const char *storedEnd = strchr(stored, '\n');
+        if (NULL == storedEnd) {
+            return false;
+        }
+        const size_t storedLength = (size_t) (storedEnd - stored);
+        if (findField(requestHeaders, name, length, &field)) {
+            if (field.valueLength != storedLength || 0 != memcmp(field.value, stored, storedLength)) {
+                return false;
+            }
+        } else if (0 != storedLength) {
+            return false;
+        }
+        stored = storedEnd + 1;
+    }
+    return true;
+}
+
+static Text varyValuesOf(TextView vary, TextView requestHeaders) {
+    Text values = Text_new();
+    const char *cursor = vary, *end = vary + Text_length(vary), *name = NULL;
+    size_t length = 0;
+    struct Field field;
+    while (nextToken(&cursor, end, &name, &length)) {
+        if (findField(requestHeaders, name, length, &field)) {
+            values = Text_appendBytes(&values, field.value, field.valueLength);
+        }
+        values = Text_appendLiteral(&values, "\n");
+    }
+    return values;
+}
+
+/*
+ * Entries
+ */
+
+static bool isCacheableStatus(const enum HttpStatus status) {
+    switch (status) {
+        case HTTP_STATUS_OK:
+        case HTTP_STATUS_NON_AUTHORITATIVE_INFORMATION:
+        case HTTP_STATUS_NO_CONTENT:
+        case HTTP_STATUS_MULTIPLE_CHOICES:
+        case HTTP_STATUS_MOVED_PERMANENTLY:
+        case HTTP_STATUS_PERMANENT_REDIRECT:
+        case HTTP_STATUS_NOT_FOUND:
+        case HTTP_STATUS_METHOD_NOT_ALLOWED:
+        case HTTP_STATUS_GONE:
+        case HTTP_STATUS_URI_TOO_LONG:
+        case HTTP_STATUS_NOT_IMPLEMENTED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Redirections are stored as such only for requests not following them, and never answer requests following them.
+static bool answers(const enum HttpStatus status, const struct HttpRequest *request) {
+    return !HttpRequest_getFollowLocation(request) || status < 300 || status >= 400;
+}
+
+static size_t textMemoryUsage(TextView text) {
+    return NULL == text ? 0 : Text_overhead() + Text_capacity(text) + 1;
+}
+
+static void deleteEntry(struct HttpCacheEntry *self) {
+    Text_delete(self->vary);
+    Text_delete(self->varyValues);
+    Text_delete(self->headers);
+    Text_delete(self->conditionalHeaders);
+    HttpSharedText_release(self->body);
+    Alligator_free(self);
+}
+
+// Takes the ownership of the texts and of body, freshness is left to the caller while stale windows come from headers.
+static struct HttpCacheEntry *allocateEntry(Atom url, Atom effectiveUrl, enum HttpStatus status, Text vary,
+                                            Text varyValues, Text headers, Text conditionalHeaders,
+                                            const struct HttpSharedText *body) {
+    struct HttpCacheEntry *self = Option_unwrap(Alligator_malloc(sizeof(*self)));
+    self->next = self->newer = self->older = NULL;
+    self->url = url;
+    self->effectiveUrl = effectiveUrl;
+    self->vary = vary;
+    self->varyValues = varyValues;
+    self->headers = headers;
+    self->conditionalHeaders = conditionalHeaders;
+    self->body = body;
+    self->hash = hashOf(url);
+    self->responseTime = self->initialAge = self->lifetime = 0;
+    const struct Directives directives = directivesOf(headers);
+    self->staleWhileRevalidate = directives.staleWhileRevalidate;
+    self->staleIfError = directives.staleIfError;
+    self->references = 1;
+    self->status = status;
+    self->noCache = false;
+    self->mustRevalidate = directives.mustRevalidate;
+    self->refreshing = false;
+    self->size = sizeof(*self) + textMemoryUsage(vary) + textMemoryUsage(varyValues) + textMemoryUsage(headers) +
+                 textMemoryUsage(conditionalHeaders) + Text_length(HttpSharedText_get(body));
+    return self;
+}
+
+/*
+ * Creates an entry out of the last block of response headers, computing its freshness as RFC 9111 does without
+ * heuristics: responses lacking both an explicit lifetime and validators are not worth storing.
+ * Takes the ownership of headers and body, returns NULL if the response must not be stored, leaving headers to the
+ * caller.
+ */
+static struct HttpCacheEntry *newEntry(const struct HttpRequest *request, Atom effectiveUrl, enum HttpStatus status,
+                                       Text *headers, const struct HttpSharedText *body) {
+    const struct Directives directives = directivesOf(*headers);
+    const time_t now = time(NULL);
+    time_t date = now, expires = -1, age = 0;
+    bool hasExpires = false;
+    Text vary = NULL, conditionalHeaders = Text_new();
+    struct Field field;
+    const char *cursor = *headers;
+    while (nextField(&cursor, &field)) {
+        if (isNamed(&field, "Date", 4)) {
+            // dates in the future, due to skewed clocks, count as now
+            const time_t parsed = parseDate(&field);
+            date = -1 == parsed || parsed > now ? now : parsed;
+        } else if (isNamed(&field, "Expires", 7)) {
+            hasExpires = true;
+            expires = parseDate(&field);
+        } else if (isNamed(&field, "Age", 3)) {
+            age = parseSeconds(field.value, field.valueLength);
+        } else if (isNamed(&field, "ETag", 4)) {
+            conditionalHeaders = Text_appendFormat(&conditionalHeaders, "%sIf-None-Match: %.*s",
+                                                   Text_isEmpty(conditionalHeaders) ? "" : "\r\n",
+                                                   (int) field.valueLength, field.value);
+        } else if (isNamed(&field, "Last-Modified", 13)) {
+            conditionalHeaders = Text_appendFormat(&conditionalHeaders, "%sIf-Modified-Since: %.*s",
+                                                   Text_isEmpty(conditionalHeaders) ? "" : "\r\n",
+                                                   (int) field.valueLength, field.value);
+        } else if (isNamed(&field, "Vary", 4)) {
+            if (NULL == vary) {
+                vary = Text_new();
+            } else {
+                vary = Text_appendLiteral(&vary, ",");
+            }
+            vary = Text_appendBytes(&vary, field.value, field.valueLength);
+        }
+    }
+
+    time_t lifetime = 0;
+    if (directives.maxAge >= 0) {
+        lifetime = directives.maxAge;
+    } else if (hasExpires) {
+        lifetime = expires > date ? expires - date : 0;
+    }
+    const bool wildcard = NULL != vary && NULL != strchr(vary, '*');
+    if (directives.noStore || wildcard || (0 == lifetime && Text_isEmpty(conditionalHeaders))) {
+        Text_delete(vary);
+        Text_delete(conditionalHeaders);
+        HttpSharedText_release(body);
+        return NULL;
+    }
+
+    const char *tag = Alligator_enterTag("HttpCache");
+    Text varyValues = NULL == vary ? NULL : varyValuesOf(vary, HttpRequest_getHeaders(request));
+    struct HttpCacheEntry *self = allocateEntry(HttpRequest_getUrl(request), effectiveUrl, status, vary, varyValues,
+                                                *headers, conditionalHeaders, body);
+    Alligator_exitTag(tag);
+    self->responseTime = now;
+    self->initialAge = now - date > age ? now - date : age;
+    self->lifetime = lifetime;
+    self->noCache = directives.noCache;
+    *headers = NULL;
+    return self;
+}
+
+static bool isSameVariant(const struct HttpCacheEntry *self, const struct HttpCacheEntry *other) {
+    return self->url == other->url &&
+           (NULL == self->vary ? NULL == other->vary : NULL != other->vary && Text_equals(self->vary, other->vary)) &&
+           (NULL == self->varyValues || Text_equals(self->varyValues, other->varyValues));
+}
+
+/*
+ * Shards, every function expects the shard to be locked
+ */
+
+static struct HttpCacheEntry **bucketOf(struct Shard *shard, const uint64_t hash) {
+    return &shard->buckets[(hash / HTTP_CACHE_SHARDS) & (shard->bucketsLength - 1)];
+}
+
+static void pushNewest(struct Shard *shard, struct HttpCacheEntry *entry) {
+    entry->older = shard->newest;
+    entry->newer = NULL;
+    if (NULL != shard->newest) {
+        shard->newest->newer = entry;
+    } else {
+        shard->oldest = entry;
+    }
+    shard->newest = entry;
+}
+
+static void unlinkRecency(struct Shard *shard, struct HttpCacheEntry *entry) {
+    if (NULL != entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        shard->newest = entry->older;
+    }
+    if (NULL != entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        shard->oldest = entry->newer;
+    }
+    entry->newer = entry->older = NULL;
+}
+
+static void removeEntry(struct Shard *shard, struct HttpCacheEntry *entry) {
+    struct HttpCacheEntry **link = bucketOf(shard, entry->hash);
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    entry->next = NULL;
+    unlinkRecency(shard, entry);
+    shard->entries--;
+    shard->bytes -= entry->size;
+    HttpCacheEntry_release(entry);
+}
+
+static void evict(struct Shard *shard, const size_t limit) {
+    while (shard->bytes > limit) {
+        removeEntry(shard, shard->oldest);
+        shard->evictions++;
+    }
+}
+
+static void growBuckets(struct Shard *shard) {
+    const size_t length = 0 == shard->bucketsLength ? INITIAL_BUCKETS : shard->bucketsLength * 2;
+    struct HttpCacheEntry **previousBuckets = shard->buckets;
+    const size_t previousLength = shard->bucketsLength;
+    shard->buckets = Option_unwrap(Alligator_calloc(length, sizeof(shard->buckets[0])));
+    shard->bucketsLength = length;
+    for (size_t i = 0; i < previousLength; i++) {
+        struct HttpCacheEntry *entry = previousBuckets[i];
+        while (NULL != entry) {
+            struct HttpCacheEntry *next = entry->next;
+            struct HttpCacheEntry **bucket = bucketOf(shard, entry->hash);
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    Alligator_free(previousBuckets);
+}
+
+// Stores entry moving the reference of the caller into the cache.
+static void insert(struct HttpCacheEntry *entry) {
+    struct Shard *shard = shardOf(entry->hash);
+    pthread_mutex_lock(&shard->lock);
+    const size_t limit = shardCapacity();
+    if (entry->size > limit) {
+        pthread_mutex_unlock(&shard->lock);
+        HttpCacheEntry_release(entry);
+        return;
+    }
+    if (shard->entries >= shard->bucketsLength) {
+        const char *tag = Alligator_enterTag("HttpCache");
+        growBuckets(shard);
+        Alligator_exitTag(tag);
+    }
+    struct HttpCacheEntry **bucket = bucketOf(shard, entry->hash);
+    for (struct HttpCacheEntry *other = *bucket; NULL != other; other = other->next) {
+        if (isSameVariant(other, entry)) {
+            removeEntry(shard, other);
+            break;
+        }
+    }
+    entry->next = *bucket;
+    *bucket = entry;
+    pushNewest(shard, entry);
+    shard->entries++;
+    shard->bytes += entry->size;
+    shard->stores++;
+    evict(shard, limit);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Removes entry from memory, unless it has already been replaced.
+static void discard(const struct HttpCacheEntry *entry) {
+    struct Shard *shard = shardOf(entry->hash);
+    pthread_mutex_lock(&shard->lock);
+    if (shard->bucketsLength > 0) {
+        for (struct HttpCacheEntry *other = *bucketOf(shard, entry->hash); NULL != other; other = other->next) {
+            if (other == entry) {
+                removeEntry(shard, other);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+static void clearShard(struct Shard *shard) {
+    pthread_mutex_lock(&shard->lock);
+    evict(shard, 0);
+    Alligator_free(shard->buckets);
+    shard->buckets = NULL;
+    shard->bucketsLength = 0;
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/*
+ * Disk and shared memory
+ */
+
+static uint64_t hashBytes(uint64_t hash, const char *bytes, const size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) bytes[i]) * UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+// Unlike the in-memory hash, record keys must not depend on the address of the url.
+static uint64_t recordKeyOf(Atom url) {
+    return hashBytes(UINT64_C(0xcbf29ce484222325), url, strlen(url) + 1);
+}
+
+static uint64_t recordVariantOf(const struct HttpCacheEntry *self) {
+    uint64_t hash = recordKeyOf(self->url);
+    if (NULL != self->vary) {
+        hash = hashBytes(hash, self->vary, Text_length(self->vary) + 1);
+        hash = hashBytes(hash, self->varyValues, Text_length(self->varyValues) + 1);
+    }
+    return hash;
+}
+
+static struct HttpCacheFreshness freshnessOf(const struct HttpCacheEntry *self) {
+    return (struct HttpCacheFreshness) {
+            .responseTime=self->responseTime, .initialAge=self->initialAge, .lifetime=self->lifetime,
+            .noCache=self->noCache
+    };
+}
+
+// Describes self as parts, the first one being record, the others referring to self.
+static void recordOf(const struct HttpCacheEntry *self, struct Record *record, struct iovec parts[RECORD_PARTS]) {
+    static const char padding[256] = {0};
+    const char *texts[RECORD_TEXTS] = {
+            self->url, self->effectiveUrl, NULL == self->vary ? "" : self->vary,
+            NULL == self->varyValues ? "" : self->varyValues, self->headers, self->conditionalHeaders
+    };
+    TextView body = HttpSharedText_get(self->body);
+    *record = (struct Record) {
+            .magic=RECORD_MAGIC, .bodyLength=Text_length(body), .status=(uint32_t) self->status,
+            .hasVary=NULL != self->vary
+    };
+    size_t offset = sizeof(*record);
+    parts[0] = (struct iovec) {.iov_base=record, .iov_len=sizeof(*record)};
+    for (size_t i = 0; i < RECORD_TEXTS; i++) {
+        record->lengths[i] = strlen(texts[i]);
+        parts[i + 1] = (struct iovec) {.iov_base=(void *) texts[i], .iov_len=record->lengths[i] + 1};
+        offset += record->lengths[i] + 1;
+    }
+    record->bodyOffset = (offset + HttpMappedText_headroom() + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT *
+                         RECORD_ALIGNMENT;
+    assert(record->bodyOffset - offset <= sizeof(padding));
+    parts[RECORD_TEXTS + 1] = (struct iovec) {.iov_base=(void *) padding, .iov_len=record->bodyOffset - offset};
+    parts[RECORD_TEXTS + 2] = (struct iovec) {.iov_base=(void *) body, .iov_len=record->bodyLength + 1};
+}
+
+static void writeEntry(const struct HttpCacheEntry *self, const bool toSharedMemory, const bool toDisk) {
+    if (!toSharedMemory && !toDisk) {
+        return;
+    }
+    struct Record record;
+    struct iovec parts[RECORD_PARTS];
+    recordOf(self, &record, parts);
+    const uint64_t key = recordKeyOf(self->url);
+    const uint64_t variant = recordVariantOf(self);
+    if (toSharedMemory) {
+        (void) HttpSharedCache_store(key, variant, freshnessOf(self), parts, RECORD_PARTS);
+    }
+    if (toDisk) {
+        (void) HttpDiskCache_store(key, variant, freshnessOf(self), parts, RECORD_PARTS);
+    }
+}
+
+static bool isRecordValid(const struct Record *record) {
+    size_t textsSize = 0;
+    for (size_t i = 0; i < RECORD_TEXTS; i++) {
+        if (record->lengths[i] >= record->bodyOffset) {
+            return false;
+        }
+        textsSize += record->lengths[i] + 1;
+    }
+    return RECORD_MAGIC == record->magic && record->bodyOffset < SIZE_MAX / 2 && record->bodyLength < SIZE_MAX / 2 &&
+           0 == record->bodyOffset % RECORD_ALIGNMENT &&
+           sizeof(*record) + textsSize + HttpMappedText_headroom() <= record->bodyOffset;
+}
+
+// Builds the entry described by record if it answers request, taking the reference to body.
+static struct HttpCacheEntry *entryOf(const struct Record *record, const struct HttpSharedText *body,
+                                      const struct HttpRequest *request, const struct HttpCacheFreshness freshness) {
+    // the bytes preceding the body stay readable through the mapping
+    const char *texts[RECORD_TEXTS];
+    const char *cursor = HttpSharedText_get(body) - record->bodyOffset + sizeof(*record);
+    bool valid = true;
+    for (size_t i = 0; i < RECORD_TEXTS; i++) {
+        texts[i] = cursor;
+        valid = valid && '\0' == cursor[record->lengths[i]];
+        cursor += record->lengths[i] + 1;
+    }
+    Atom url = HttpRequest_getUrl(request);
+    valid = valid && 0 == strcmp(texts[0], url) && answers((enum HttpStatus) record->status, request) &&
+            varyMatches(record->hasVary ? texts[2] : NULL, texts[3], HttpRequest_getHeaders(request));
+    if (!valid) {
+        HttpSharedText_release(body);
+        return NULL;
+    }
+
+    const char *tag = Alligator_enterTag("HttpCache");
+    struct HttpCacheEntry *self = allocateEntry(
+            url, Atom_fromBytes(texts[1], record->lengths[1]), (enum HttpStatus) record->status,
+            record->hasVary ? Text_fromBytes(texts[2], record->lengths[2]) : NULL,
+            record->hasVary ? Text_fromBytes(texts[3], record->lengths[3]) : NULL,
+            Text_fromBytes(texts[4], record->lengths[4]), Text_fromBytes(texts[5], record->lengths[5]), body
+    );
+    Alligator_exitTag(tag);
+    self->responseTime = (time_t) freshness.responseTime;
+    self->initialAge = (time_t) freshness.initialAge;
+    self->lifetime = (time_t) freshness.lifetime;
+    self->noCache = freshness.noCache;
+    return self;
+}
+
+// Reads the entry stored at path if it answers request, mapping its body.
+static struct HttpCacheEntry *readEntry(TextView path, const struct HttpRequest *request,
+                                        const struct HttpCacheFreshness freshness) {
+    struct Record record;
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    const bool read = sizeof(record) == pread(fd, &record, sizeof(record), 0);
+    close(fd);
+    if (!read || !isRecordValid(&record)) {
+        return NULL;
+    }
+    const struct HttpSharedText *body = HttpMappedText_fromPath(path, record.bodyOffset, record.bodyLength);
+    return NULL == body ? NULL : entryOf(&record, body, request, freshness);
+}
+
+// Builds the entry held by a copy out of the shared cache if it answers request, taking the ownership of the copy.
+static struct HttpCacheEntry *adoptEntry(void *copy, const size_t size, const struct HttpRequest *request,
+                                         const struct HttpCacheFreshness freshness) {
+    struct Record record;
+    if (size < sizeof(record)) {
+        munmap(copy, size);
+        return NULL;
+    }
+    // the record is overwritten once the body is mapped in place
+    memcpy(&record, copy, sizeof(record));
+    if (!isRecordValid(&record)) {
+        munmap(copy, size);
+        return NULL;
+    }
+    const struct HttpSharedText *body = HttpMappedText_fromMapping(copy, size, record.bodyOffset, record.bodyLength);
+    return NULL == body ? NULL : entryOf(&record, body, request, freshness);
+}
+
+static struct HttpCacheEntry *loadSharedEntry(const struct HttpRequest *request) {
+    const uint64_t key = recordKeyOf(HttpRequest_getUrl(request));
+    struct HttpCacheEntry *entry = NULL;
+    struct HttpCacheFreshness freshness;
+    uint64_t variant = 0;
+    size_t cursor = 0;
+    size_t size = 0;
+    void *copy;
+    while (NULL == entry && NULL != (copy = HttpSharedCache_find(key, &cursor, &size, &variant, &freshness))) {
+        entry = adoptEntry(copy, size, request, freshness);
+    }
+    return entry;
+}
+
+static struct HttpCacheEntry *loadDiskEntry(const struct HttpRequest *request) {
+    const uint64_t key = recordKeyOf(HttpRequest_getUrl(request));
+    struct HttpCacheEntry *entry = NULL;
+    struct HttpCacheFreshness freshness;
+    uint64_t variant = 0;
+    size_t cursor = 0;
+    Text path = Text_new();
+    while (NULL == entry && HttpDiskCache_find(key, &cursor, &path, &variant, &freshness)) {
+        entry = readEntry(path, request, freshness);
+    }
+    Text_delete(path);
+    return entry;
+}
+
+/*
+ * Public API
+ */
+
+size_t Http_setCacheCapacity(const size_t bytes) {
+    const size_t previousCapacity = __atomic_exchange_n(&capacity, bytes, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < HTTP_CACHE_SHARDS; i++) {
+        struct Shard *shard = getShard(i);
+        if (0 == bytes) {
+            clearShard(shard);
+        } else {
+            pthread_mutex_lock(&shard->lock);
+            evict(shard, bytes / HTTP_CACHE_SHARDS);
+            pthread_mutex_unlock(&shard->lock);
+        }
+    }
+    return previousCapacity;
+}
+
+size_t Http_getCacheCapacity(void) {
+    return __atomic_load_n(&capacity, __ATOMIC_RELAXED);
+}
+
+size_t Http_setCacheRefreshAhead(const size_t seconds) {
+    return __atomic_exchange_n(&refreshAhead, seconds, __ATOMIC_RELAXED);
+}
+
+size_t Http_getCacheRefreshAhead(void) {
+    return __atomic_load_n(&refreshAhead, __ATOMIC_RELAXED);
+}
+
+struct HttpCacheStats Http_getCacheStats(void) {
+    struct HttpCacheStats stats = {0};
+    for (size_t i = 0; i < HTTP_CACHE_SHARDS; i++) {
+        struct Shard *shard = getShard(i);
+        pthread_mutex_lock(&shard->lock);
+        stats.hits += __atomic_load_n(&shard->hits, __ATOMIC_RELAXED);
+        stats.misses += __atomic_load_n(&shard->misses, __ATOMIC_RELAXED);
+        stats.revalidations += __atomic_load_n(&shard->revalidations, __ATOMIC_RELAXED);
+        stats.staleHits += __atomic_load_n(&shard->staleHits, __ATOMIC_RELAXED);
+        stats.refreshes += __atomic_load_n(&shard->refreshes, __ATOMIC_RELAXED);
+        stats.sharedLoads += __atomic_load_n(&shard->sharedLoads, __ATOMIC_RELAXED);
+        stats.diskLoads += __atomic_load_n(&shard->diskLoads, __ATOMIC_RELAXED);
+        stats.stores += shard->stores;
+        stats.evictions += shard->evictions;
+        stats.entries += shard->entries;
+        stats.bytes += shard->bytes;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    return stats;
+}
+
+void Http_clearCache(void) {
+    for (size_t i = 0; i < HTTP_CACHE_SHARDS; i++) {
+        clearShard(getShard(i));
+    }
+}
+
+bool HttpCache_accepts(const struct HttpRequest *request) {
+    assert(request);
+    if ((0 == Http_getCacheCapacity() && !Http_isSharedCacheOpen() && !Http_isDiskCacheOpen()) ||
+        HTTP_METHOD_GET != HttpRequest_getMethod(request) || !Text_isEmpty(HttpRequest_getBody(request)) ||
+        NULL != HttpRequest_getRope(request)) {
+        return false;
+    }
+    TextView headers = HttpRequest_getHeaders(request);
+    struct Field field;
+    const char *cursor = headers;
+    while (nextField(&cursor, &field)) {
+        if (isNamed(&field, "If-None-Match", 13) || isNamed(&field, "If-Modified-Since", 17) ||
+            isNamed(&field, "If-Range", 8) || isNamed(&field, "Range", 5)) {
+            return false;
+        }
+    }
+    return !directivesOf(headers).noStore;
+}
+
+const struct HttpCacheEntry *HttpCache_lookup(const struct HttpRequest *request) {
+    assert(request);
+    const uint64_t hash = hashOf(HttpRequest_getUrl(request));
+    struct Shard *shard = shardOf(hash);
+    struct HttpCacheEntry *found = NULL;
+    pthread_mutex_lock(&shard->lock);
+    if (shard->bucketsLength > 0) {
+        for (struct HttpCacheEntry *entry = *bucketOf(shard, hash); NULL != entry; entry = entry->next) {
+            if (entry->url == HttpRequest_getUrl(request) && answers(entry->status, request) &&
+                varyMatches(entry->vary, entry->varyValues, HttpRequest_getHeaders(request))) {
+                unlinkRecency(shard, entry);
+                pushNewest(shard, entry);
+                found = (struct HttpCacheEntry *) HttpCacheEntry_retain(entry);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    // promote entries found further away, insert drops them if they do not fit in memory
+    if (NULL == found && Http_isSharedCacheOpen() && NULL != (found = loadSharedEntry(request))) {
+        __atomic_add_fetch(&shard->sharedLoads, 1, __ATOMIC_RELAXED);
+        insert((struct HttpCacheEntry *) HttpCacheEntry_retain(found));
+    }
+    if (NULL == found && Http_isDiskCacheOpen() && NULL != (found = loadDiskEntry(request))) {
+        __atomic_add_fetch(&shard->diskLoads, 1, __ATOMIC_RELAXED);
+        writeEntry(found, Http_isSharedCacheOpen(), false);
+        insert((struct HttpCacheEntry *) HttpCacheEntry_retain(found));
+    }
+    if (NULL == found) {
+        __atomic_add_fetch(&shard->misses, 1, __ATOMIC_RELAXED);
+    }
+    return found;
+}
+
+void HttpCache_store(const struct HttpResponse *response) {
+    assert(response);
+    const struct HttpRequest *request = HttpResponse_getRequest(response);
+    // the response of a followed redirection belongs to another url, the redirection itself may not be cacheable
+    if (!HttpCache_accepts(request) || !isCacheableStatus(HttpResponse_getStatus(response)) ||
+        HttpResponse_getUrl(response) != HttpRequest_getUrl(request)) {
+        return;
+    }
+    Text headers = lastBlockOf(HttpResponse_getHeaders(response));
+    struct HttpCacheEntry *entry = newEntry(request, HttpResponse_getUrl(response), HttpResponse_getStatus(response),
+                                            &headers, HttpResponse_shareBody(response));
+    if (NULL != entry) {
+        writeEntry(entry, Http_isSharedCacheOpen(), Http_isDiskCacheOpen());
+        insert(entry);
+    } else {
+        Text_delete(headers);
+    }
+}
+
+static const struct HttpResponse *respond(const struct HttpCacheEntry *self, TextView headers,
+                                          const struct HttpRequest **ref, const struct HttpTimings timings) {
+    struct HttpResponseBuilder *builder = HttpResponseBuilder_new(ref);
+    HttpResponseBuilder_setTimings(builder, timings);
+    HttpResponseBuilder_setUrl(builder, self->effectiveUrl);
+    HttpResponseBuilder_setStatus(builder, self->status);
+    const char *tag = Alligator_enterTag("HttpResponse");
+    Text copy = Text_duplicate(headers);
+    Alligator_exitTag(tag);
+    HttpResponseBuilder_setHeaders(builder, &copy);
+    HttpResponseBuilder_setSharedBody(builder, self->body);
+    return HttpResponseBuilder_build(&builder);
+}
+
+const struct HttpResponse *HttpCacheEntry_revalidate(const struct HttpCacheEntry *self,
+                                                     const struct HttpResponse **ref) {
+    assert(self);
+    assert(ref);
+    assert(*ref);
+    const struct HttpTimings timings = HttpResponse_getTimings(*ref);
+    Text update = lastBlockOf(HttpResponse_getHeaders(*ref));
+    Text headers = mergeHeaders(self->headers, update);
+    Text_delete(update);
+    const struct HttpRequest *request = HttpResponse_takeRequest(ref);
+    struct HttpCacheEntry *refreshed = newEntry(request, self->effectiveUrl, self->status, &headers,
+                                                HttpSharedText_retain(self->body));
+    if (NULL != refreshed) {
+        const uint64_t key = recordKeyOf(refreshed->url);
+        const uint64_t variant = recordVariantOf(refreshed);
+        if (Http_isSharedCacheOpen()) {
+            HttpSharedCache_refresh(key, variant, freshnessOf(refreshed));
+        }
+        if (Http_isDiskCacheOpen()) {
+            HttpDiskCache_refresh(key, variant, freshnessOf(refreshed));
+        }
+        self = HttpCacheEntry_retain(refreshed);
+        insert(refreshed);
+    } else {
+        // the merged headers forbid storing the response, the stored one is no longer valid either
+        self = HttpCacheEntry_retain(self);
+        discard(self);
+        const uint64_t key = recordKeyOf(self->url);
+        const uint64_t variant = recordVariantOf(self);
+        if (Http_isSharedCacheOpen()) {
+            HttpSharedCache_remove(key, variant);
+        }
+        if (Http_isDiskCacheOpen()) {
+            HttpDiskCache_remove(key, variant);
+        }
+    }
+    __atomic_add_fetch(&shardOf(self->hash)->revalidations, 1, __ATOMIC_RELAXED);
+    const struct HttpResponse *response = respond(self, NULL == refreshed ? headers : self->headers, &request, timings);
+    if (NULL == refreshed) {
+        Text_delete(headers);
+    }
+    HttpCacheEntry_release(self);
+    return response;
+}
+
+const struct HttpCacheEntry *HttpCacheEntry_retain(const struct HttpCacheEntry *self) {
+    assert(self);
+    struct HttpCacheEntry *mutableSelf = (struct HttpCacheEntry *) self;
+    __atomic_fetch_add(&mutableSelf->references, 1, __ATOMIC_RELAXED);
+    return self;
+}
+
+static time_t ageOf(const struct HttpCacheEntry *self) {
+    const time_t now = time(NULL);
+    return self->initialAge + (now > self->responseTime ? now - self->responseTime : 0);
+}
+
+bool HttpCacheEntry_isFresh(const struct HttpCacheEntry *self, const struct HttpRequest *request) {
+    assert(self);
+    assert(request);
+    const time_t age = ageOf(self);
+    const struct Directives directives = directivesOf(HttpRequest_getHeaders(request));
+    if (directives.noCache || (directives.maxAge >= 0 && age > directives.maxAge)) {
+        return false;
+    }
+    return !self->noCache && age < self->lifetime;
+}
+
+bool HttpCacheEntry_isExpiring(const struct HttpCacheEntry *self) {
+    assert(self);
+    const time_t ahead = (time_t) Http_getCacheRefreshAhead();
+    return ahead > 0 && !self->noCache && self->lifetime - ageOf(self) <= ahead;
+}
+
+bool HttpCacheEntry_allowsStaleWhileRevalidate(const struct HttpCacheEntry *self, const struct HttpRequest *request) {
+    assert(self);
+    assert(request);
+    const time_t age = ageOf(self);
+    const struct Directives directives = directivesOf(HttpRequest_getHeaders(request));
+    if (self->noCache || self->mustRevalidate || directives.noCache ||
+        (directives.maxAge >= 0 && age > directives.maxAge)) {
+        return false;
+    }
+    return age < self->lifetime + self->staleWhileRevalidate;
+}
+
+bool HttpCacheEntry_allowsStaleIfError(const struct HttpCacheEntry *self, const struct HttpRequest *request) {
+    assert(self);
+    assert(request);
+    const time_t age = ageOf(self);
+    const struct Directives directives = directivesOf(HttpRequest_getHeaders(request));
+    if (self->noCache || self->mustRevalidate || directives.noCache ||
+        (directives.maxAge >= 0 && age > directives.maxAge)) {
+        return false;
+    }
+    return age < self->lifetime + self->staleIfError;
+}
+
+bool HttpCacheEntry_beginRefresh(const struct HttpCacheEntry *self) {
+    assert(self);
+    struct HttpCacheEntry *mutableSelf = (struct HttpCacheEntry *) self;
+    bool refreshing = false;
+    if (!__atomic_compare_exchange_n(&mutableSelf->refreshing, &refreshing, true, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_RELAXED)) {
+        return false;
+    }
+    __atomic_add_fetch(&shardOf(self->hash)->refreshes, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void HttpCacheEntry_endRefresh(const struct HttpCacheEntry *self) {
+    assert(self);
+    struct HttpCacheEntry *mutableSelf = (struct HttpCacheEntry *) self;
+    __atomic_store_n(&mutableSelf->refreshing, false, __ATOMIC_RELEASE);
+}
+
+TextView HttpCacheEntry_getConditionalHeaders(const struct HttpCacheEntry *self) {
+    assert(self);
+    return self->conditionalHeaders;
+}
+
+const struct HttpResponse *HttpCacheEntry_respond(const struct HttpCacheEntry *self, const struct HttpRequest **ref) {
+    assert(self);
+    assert(ref);
+    assert(*ref);
+    __atomic_add_fetch(&shardOf(self->hash)->hits, 1, __ATOMIC_RELAXED);
+    return respond(self, self->headers, ref, (struct HttpTimings) {0});
+}
+
+const struct HttpResponse *HttpCacheEntry_respondStale(const struct HttpCacheEntry *self,
+                                                       const struct HttpRequest **ref) {
+    assert(self);
+    assert(ref);
+    assert(*ref);
+    __atomic_add_fetch(&shardOf(self->hash)->staleHits, 1, __ATOMIC_RELAXED);
+    return respond(self, self->headers, ref, (struct HttpTimings) {0});
+}
+
+void HttpCacheEntry_release(const struct HttpCacheEntry *self) {
+    if (self) {
+        struct HttpCacheEntry *mutableSelf = (struct HttpCacheEntry *) self;
+        if (1 == __atomic_fetch_sub(&mutableSelf->references, 1, __ATOMIC_ACQ_REL)) {
+            deleteEntry(mutableSelf);
+        }
+    }
+}
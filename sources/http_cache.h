@@ -0,0 +1,314 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <http.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct HttpRequest;
+struct HttpResponse;
+struct HttpCacheEntry;
+
+/**
+ * Number of independently locked shards the cache is split into, the capacity is evenly divided among them.
+ */
+#ifndef HTTP_CACHE_SHARDS
+#define HTTP_CACHE_SHARDS  16
+#endif
+
+/**
+ * Number of background threads refreshing stale entries served with stale-while-revalidate and entries refreshed
+ * ahead of their expiration.
+ */
+#ifndef HTTP_CACHE_REFRESH_THREADS
+#define HTTP_CACHE_REFRESH_THREADS  2
+#endif
+
+/**
+ * Counters of the response cache since the process started:
+ *  - hits: requests answered from the cache without contacting the server;
+ *  - misses: cacheable requests that found no entry;
+ *  - revalidations: stale entries confirmed by the server with 304 Not Modified;
+ *  - staleHits: requests answered with a stale entry, while it was refreshed or because the server failed;
+ *  - refreshes: entries refreshed in the background;
+ *  - sharedLoads: entries loaded from the shared cache segment, see Http_openSharedCache;
+ *  - diskLoads: entries loaded from the disk cache, see Http_openDiskCache;
+ *  - stores: responses stored into the cache;
+ *  - evictions: entries evicted to make room for others;
+ *  - entries: entries currently cached;
+ *  - bytes: memory currently used by the cached entries.
+ */
+struct HttpCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t revalidations;
+    size_t staleHits;
+    size_t refreshes;
+    size_t sharedLoads;
+    size_t diskLoads;
+    size_t stores;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+/**
+ * Freshness of a cached response, kept apart from the response by the disk and shared caches so that revalidations
+ * do not rewrite it:
+ *  - responseTime: when the response has been received, in seconds since the epoch;
+ *  - initialAge: the age of the response when received, in seconds;
+ *  - lifetime: for how long the response stays fresh since it has been generated, in seconds;
+ *  - noCache: whether the response must be revalidated even if fresh.
+ */
+struct HttpCacheFreshness {
+    int64_t responseTime;
+    int64_t initialAge;
+    int64_t lifetime;
+    bool noCache;
+};
+
+/**
+ * Sets the capacity of the in-memory response cache consulted by HttpRequest_fire, disabled by default.
+ * The cache is also enabled by opening a shared cache segment or a disk cache, with Http_openSharedCache or
+ * Http_openDiskCache.
+ * Only GET requests without a body are cached, keyed by url and by the request headers named in the Vary header of
+ * the response. Responses are stored according to their Cache-Control and Expires headers, stale responses carrying an
+ * ETag or a Last-Modified header are revalidated with If-None-Match and If-Modified-Since.
+ * Following RFC 5861, stale responses are served right away while refreshed in the background for as long as their
+ * stale-while-revalidate directive allows, and instead of errors, or of 500, 502, 503 and 504 responses, for as long as
+ * their stale-if-error directive allows; must-revalidate disables both.
+ * Each shard evicts its least recently used entries once it exceeds its share of the capacity, responses larger than
+ * a shard are not cached.
+ *
+ * @param bytes The capacity, 0 disables the cache and drops every entry.
+ * @return The previous capacity.
+ */
+extern size_t
+Http_setCacheCapacity(size_t bytes);
+
+/**
+ * Returns the capacity of the response cache, 0 if disabled.
+ */
+extern size_t
+Http_getCacheCapacity(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Sets how many seconds before their expiration fresh entries get refreshed in the background when hit, so that
+ * frequently requested responses never go stale, disabled by default.
+ *
+ * @param seconds The refresh window, 0 disables refreshing ahead.
+ * @return The previous window.
+ */
+extern size_t
+Http_setCacheRefreshAhead(size_t seconds);
+
+/**
+ * Returns how many seconds before their expiration fresh entries get refreshed when hit, 0 if disabled.
+ */
+extern size_t
+Http_getCacheRefreshAhead(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns the counters of the response cache.
+ */
+extern struct HttpCacheStats
+Http_getCacheStats(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Drops every entry of the response cache, responses previously returned from the cache are not affected.
+ */
+extern void
+Http_clearCache(void);
+
+/**
+ * Returns true if the cache, in memory, in shared memory or on disk, is enabled and may answer this request else false.
+ * Requests asking for no-store, carrying conditional or range headers, or having a body are never cached.
+ *
+ * @attention request must not be NULL.
+ */
+extern bool
+HttpCache_accepts(const struct HttpRequest *request)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Looks up the entry matching this request, fresh or stale, counting a miss if there is none.
+ * HttpRequest_fire does this on its own, this is meant for callers performing requests by other means.
+ *
+ * @attention request must not be NULL.
+ *
+ * @return A reference to the entry that must be released with HttpCacheEntry_release, NULL if there is none.
+ */
+extern const struct HttpCacheEntry *
+HttpCache_lookup(const struct HttpRequest *request)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Stores this response if its request and its headers allow it, replacing the entry previously stored for the same
+ * request if any.
+ *
+ * @attention response must not be NULL.
+ */
+extern void
+HttpCache_store(const struct HttpResponse *response)
+__attribute__((__nonnull__));
+
+/**
+ * Refreshes the entry confirmed by a 304 Not Modified response, updating its headers with those of the 304 response.
+ *
+ * @attention self must not be NULL.
+ * @attention ref must not be NULL, *ref must not be NULL, the 304 response is deleted and *ref set to NULL.
+ *
+ * @return A new response built from the refreshed entry, owning the request of the 304 response.
+ */
+extern const struct HttpResponse *
+HttpCacheEntry_revalidate(const struct HttpCacheEntry *self, const struct HttpResponse **ref)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns true if this entry may answer the request without being revalidated, according to its own freshness and
+ * to the Cache-Control directives of the request, else false.
+ *
+ * @attention self must not be NULL.
+ * @attention request must not be NULL.
+ */
+extern bool
+HttpCacheEntry_isFresh(const struct HttpCacheEntry *self, const struct HttpRequest *request)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns true if this fresh entry expires within the window set by Http_setCacheRefreshAhead else false.
+ *
+ * @attention self must not be NULL.
+ */
+extern bool
+HttpCacheEntry_isExpiring(const struct HttpCacheEntry *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns true if this stale entry may answer the request while being refreshed, according to its
+ * stale-while-revalidate directive and to the Cache-Control directives of the request, else false.
+ *
+ * @attention self must not be NULL.
+ * @attention request must not be NULL.
+ */
+extern bool
+HttpCacheEntry_allowsStaleWhileRevalidate(const struct HttpCacheEntry *self, const struct HttpRequest *request)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns true if this stale entry may answer the request in place of a failure of the server, according to its
+ * stale-if-error directive and to the Cache-Control directives of the request, else false.
+ *
+ * @attention self must not be NULL.
+ * @attention request must not be NULL.
+ */
+extern bool
+HttpCacheEntry_allowsStaleIfError(const struct HttpCacheEntry *self, const struct HttpRequest *request)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Marks this entry as being refreshed, counting a refresh, so that it is refreshed once at a time.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return true if the caller must refresh the entry then call HttpCacheEntry_endRefresh, false if it is already
+ * being refreshed.
+ */
+extern bool
+HttpCacheEntry_beginRefresh(const struct HttpCacheEntry *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Marks the refresh of this entry as completed, successfully or not.
+ *
+ * @attention self must not be NULL.
+ */
+extern void
+HttpCacheEntry_endRefresh(const struct HttpCacheEntry *self)
+__attribute__((__nonnull__));
+
+/**
+ * Returns the If-None-Match and If-Modified-Since headers revalidating this entry, empty if it has no validators.
+ *
+ * @attention self must not be NULL.
+ */
+extern TextView
+HttpCacheEntry_getConditionalHeaders(const struct HttpCacheEntry *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Builds a response from this entry, sharing its body, counting a hit.
+ *
+ * @attention self must not be NULL.
+ * @attention ref must not be NULL, *ref must not be NULL, the request is moved into the response and *ref set to NULL.
+ */
+extern const struct HttpResponse *
+HttpCacheEntry_respond(const struct HttpCacheEntry *self, const struct HttpRequest **ref)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Builds a response from this stale entry, sharing its body, counting a stale hit.
+ *
+ * @attention self must not be NULL.
+ * @attention ref must not be NULL, *ref must not be NULL, the request is moved into the response and *ref set to NULL.
+ */
+extern const struct HttpResponse *
+HttpCacheEntry_respondStale(const struct HttpCacheEntry *self, const struct HttpRequest **ref)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Retains a reference to this entry.
+ *
+ * @attention self must not be NULL.
+ */
+extern const struct HttpCacheEntry *
+HttpCacheEntry_retain(const struct HttpCacheEntry *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Releases a reference to this entry, the entry is deleted once evicted and no longer referenced.
+ * If self is NULL no action will be performed.
+ */
+extern void
+HttpCacheEntry_release(const struct HttpCacheEntry *self);
+
+#ifdef __cplusplus
+}
+#endif
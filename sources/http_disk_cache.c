@@ -0,0 +1,507 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <panic/panic.h>
+#include <alligator/alligator.h>
+
+#define INDEX_MAGIC         UINT64_C(0x6874747063616368)
+#define INDEX_VERSION       1U
+#define SLOT_VALID          1U
+#define SLOT_NO_CACHE       2U
+#define ENTRY_SUFFIX        ".entry"
+#define TEMPORARY_SUFFIX    ".tmp"
+
+/*
+ * Slots are published by clearing their flags, writing their fields and checksum, then setting their flags back:
+ * a crash in between leaves a slot whose checksum does not match, discarded on the next open.
+ * Files are synced, along with the directory renaming them, before their slot is published, and the slot is synced
+ * right after: slots never refer to files whose content did not reach the disk, even after a power loss.
+ */
+struct Slot {
+    uint64_t key;
+    uint64_t variant;
+    uint64_t file;
+    uint64_t size;
+    int64_t responseTime;
+    int64_t initialAge;
+    int64_t lifetime;
+    int64_t lastAccess;     // not covered by the checksum, touched by every lookup
+    uint32_t flags;
+    uint32_t checksum;
+};
+
+struct Index {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotsLength;
+    uint64_t nextFile;
+    struct Slot slots[HTTP_DISK_CACHE_SLOTS];
+};
+
+struct DiskCache {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    pthread_t evictor;
+    Text directory;
+    struct Index *index;
+    int indexFd;
+    int directoryFd;
+    size_t capacity;
+    struct HttpDiskCacheStats stats;
+    bool open;
+    bool stopping;
+};
+
+static struct DiskCache cache = {
+        .lock=PTHREAD_MUTEX_INITIALIZER, .wakeup=PTHREAD_COND_INITIALIZER, .directory=NULL, .index=NULL, .indexFd=-1, .directoryFd=-1,
+        .capacity=0, .stats={0}, .open=false, .stopping=false
+};
+
+static uint32_t checksumOf(const struct Slot *slot) {
+    const uint64_t fields[] = {
+            slot->key, slot->variant, slot->file, slot->size, (uint64_t) slot->responseTime,
+            (uint64_t) slot->initialAge, (uint64_t) slot->lifetime, slot->flags
+    };
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    const unsigned char *bytes = (const unsigned char *) fields;
+    for (size_t i = 0; i < sizeof(fields); i++) {
+        hash = (hash ^ bytes[i]) * UINT64_C(0x100000001b3);
+    }
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+static bool isValid(const struct Slot *slot) {
+    return 0 != (slot->flags & SLOT_VALID);
+}
+
+static void publish(struct Slot *slot, struct Slot value) {
+    value.flags |= SLOT_VALID;
+    value.checksum = checksumOf(&value);
+    __atomic_store_n(&slot->flags, 0, __ATOMIC_RELEASE);
+    slot->key = value.key;
+    slot->variant = value.variant;
+    slot->file = value.file;
+    slot->size = value.size;
+    slot->responseTime = value.responseTime;
+    slot->initialAge = value.initialAge;
+    slot->lifetime = value.lifetime;
+    slot->lastAccess = value.lastAccess;
+    slot->checksum = value.checksum;
+    __atomic_store_n(&slot->flags, value.flags, __ATOMIC_RELEASE);
+}
+
+// Writes the page holding slot to the index file, expects the cache to be locked.
+static void persist(const struct Slot *slot) {
+    const uintptr_t pageSize = (uintptr_t) sysconf(_SC_PAGESIZE);
+    const uintptr_t start = (uintptr_t) slot & ~(pageSize - 1);
+    (void) msync((void *) start, (uintptr_t) (slot + 1) - start, MS_SYNC);
+}
+
+static Text pathOf(const uint64_t file, const char *suffix) {
+    return Text_format("%s/%016" PRIx64 "%s", cache.directory, file, suffix);
+}
+
+// Unpublishes a slot, expects the cache to be locked, returns the path of the file to be unlinked by the caller.
+static Text clearSlot(struct Slot *slot) {
+    Text path = pathOf(slot->file, ENTRY_SUFFIX);
+    __atomic_store_n(&slot->flags, 0, __ATOMIC_RELEASE);
+    cache.stats.entries--;
+    cache.stats.bytes -= slot->size;
+    return path;
+}
+
+static void unlinkPath(Text path) {
+    (void) unlink(path);
+    Text_delete(path);
+}
+
+static struct HttpCacheFreshness freshnessOf(const struct Slot *slot) {
+    return (struct HttpCacheFreshness) {
+            .responseTime=slot->responseTime, .initialAge=slot->initialAge, .lifetime=slot->lifetime,
+            .noCache=0 != (slot->flags & SLOT_NO_CACHE)
+    };
+}
+
+/*
+ * Recovery
+ */
+
+static int compareFiles(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+// Drops torn slots and slots whose file is missing, then removes the files no slot refers to.
+static void recover(void) {
+    struct Index *index = cache.index;
+    uint64_t *files = Option_unwrap(Alligator_malloc(HTTP_DISK_CACHE_SLOTS * sizeof(files[0])));
+    size_t filesLength = 0;
+    for (size_t i = 0; i < HTTP_DISK_CACHE_SLOTS; i++) {
+        struct Slot *slot = &index->slots[i];
+        if (!isValid(slot)) {
+            continue;
+        }
+        struct stat status;
+        Text path = pathOf(slot->file, ENTRY_SUFFIX);
+        const bool intact = checksumOf(slot) == slot->checksum && 0 == stat(path, &status) &&
+                            (uint64_t) status.st_size == slot->size;
+        Text_delete(path);
+        if (!intact) {
+            slot->flags = 0;
+            continue;
+        }
+        cache.stats.entries++;
+        cache.stats.bytes += slot->size;
+        index->nextFile = slot->file >= index->nextFile ? slot->file + 1 : index->nextFile;
+        files[filesLength++] = slot->file;
+    }
+    qsort(files, filesLength, sizeof(files[0]), compareFiles);
+
+    DIR *directory = opendir(cache.directory);
+    if (NULL != directory) {
+        struct dirent *item;
+        while (NULL != (item = readdir(directory))) {
+            char *end = NULL;
+            const uint64_t file = strtoull(item->d_name, &end, 16);
+            const bool isTemporary = end != item->d_name && 0 == strcmp(end, TEMPORARY_SUFFIX);
+            const bool isEntry = end != item->d_name && 0 == strcmp(end, ENTRY_SUFFIX);
+            if (isTemporary || (isEntry && NULL == bsearch(&file, files, filesLength, sizeof(files[0]), compareFiles))) {
+                unlinkPath(Text_format("%s/%s", cache.directory, item->d_name));
+            }
+        }
+        closedir(directory);
+    }
+    Alligator_free(files);
+}
+
+/*
+ * Eviction
+ */
+
+// Evicts the least recently used responses until the files fit in limit, expects the cache to be locked.
+static void evictDownTo(const size_t limit) {
+    while (cache.stats.bytes > limit) {
+        struct Slot *oldest = NULL;
+        for (size_t i = 0; i < HTTP_DISK_CACHE_SLOTS; i++) {
+            struct Slot *slot = &cache.index->slots[i];
+            if (isValid(slot) && (NULL == oldest || slot->lastAccess < oldest->lastAccess)) {
+                oldest = slot;
+            }
+        }
+        if (NULL == oldest) {
+            break;
+        }
+        unlinkPath(clearSlot(oldest));
+        cache.stats.evictions++;
+    }
+}
+
+static void *evict(void *argument) {
+    (void) argument;
+    pthread_mutex_lock(&cache.lock);
+    while (!cache.stopping) {
+        if (cache.stats.bytes > cache.capacity) {
+            // leave some room so that the next stores do not wake the evictor up again straight away
+            evictDownTo(cache.capacity - cache.capacity / 10);
+        }
+        pthread_cond_wait(&cache.wakeup, &cache.lock);
+    }
+    pthread_mutex_unlock(&cache.lock);
+    return NULL;
+}
+
+/*
+ * Public API
+ */
+
+static struct Index *mapIndex(const int fd) {
+    struct stat status;
+    if (0 != fstat(fd, &status)) {
+        return NULL;
+    }
+    if ((size_t) status.st_size != sizeof(struct Index) &&
+        (0 != ftruncate(fd, 0) || 0 != ftruncate(fd, sizeof(struct Index)))) {
+        return NULL;
+    }
+    struct Index *index = mmap(NULL, sizeof(*index), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == index) {
+        return NULL;
+    }
+    if (INDEX_MAGIC != index->magic || INDEX_VERSION != index->version ||
+        HTTP_DISK_CACHE_SLOTS != index->slotsLength) {
+        memset(index, 0, sizeof(*index));
+        index->magic = INDEX_MAGIC;
+        index->version = INDEX_VERSION;
+        index->slotsLength = HTTP_DISK_CACHE_SLOTS;
+    }
+    return index;
+}
+
+bool Http_openDiskCache(const char *directory, const size_t capacity) {
+    assert(directory);
+    Http_closeDiskCache();
+    if (0 != mkdir(directory, 0700) && EEXIST != errno) {
+        return false;
+    }
+    Text path = Text_format("%s/index", directory);
+    const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    Text_delete(path);
+    if (fd < 0) {
+        return false;
+    }
+    struct Index *index = 0 == flock(fd, LOCK_EX | LOCK_NB) ? mapIndex(fd) : NULL;
+    const int directoryFd = NULL == index ? -1 : open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd < 0) {
+        if (NULL != index) {
+            munmap(index, sizeof(*index));
+        }
+        close(fd);
+        return false;
+    }
+
+    pthread_mutex_lock(&cache.lock);
+    cache.directory = Text_fromLiteral(directory);
+    cache.index = index;
+    cache.indexFd = fd;
+    cache.directoryFd = directoryFd;
+    cache.capacity = capacity;
+    cache.stats = (struct HttpDiskCacheStats) {0};
+    cache.stopping = false;
+    recover();
+    if (0 != pthread_create(&cache.evictor, NULL, evict, NULL)) {
+        Panic_terminate("Unable to start the disk cache evictor\n");
+    }
+    __atomic_store_n(&cache.open, true, __ATOMIC_RELEASE);
+    pthread_cond_signal(&cache.wakeup);
+    pthread_mutex_unlock(&cache.lock);
+    return true;
+}
+
+void Http_closeDiskCache(void) {
+    pthread_mutex_lock(&cache.lock);
+    if (!cache.open) {
+        pthread_mutex_unlock(&cache.lock);
+        return;
+    }
+    __atomic_store_n(&cache.open, false, __ATOMIC_RELEASE);
+    cache.stopping = true;
+    pthread_cond_signal(&cache.wakeup);
+    pthread_mutex_unlock(&cache.lock);
+    pthread_join(cache.evictor, NULL);
+
+    pthread_mutex_lock(&cache.lock);
+    munmap(cache.index, sizeof(*cache.index));
+    close(cache.indexFd);
+    close(cache.directoryFd);
+    Text_delete(cache.directory);
+    cache.index = NULL;
+    cache.indexFd = -1;
+    cache.directoryFd = -1;
+    cache.directory = NULL;
+    cache.stats = (struct HttpDiskCacheStats) {0};
+    pthread_mutex_unlock(&cache.lock);
+}
+
+bool Http_isDiskCacheOpen(void) {
+    return __atomic_load_n(&cache.open, __ATOMIC_ACQUIRE);
+}
+
+struct HttpDiskCacheStats Http_getDiskCacheStats(void) {
+    pthread_mutex_lock(&cache.lock);
+    const struct HttpDiskCacheStats stats = cache.stats;
+    pthread_mutex_unlock(&cache.lock);
+    return stats;
+}
+
+static bool writeParts(const int fd, const struct iovec *parts, const size_t partsLength) {
+    for (size_t i = 0; i < partsLength; i++) {
+        const char *bytes = parts[i].iov_base;
+        size_t pending = parts[i].iov_len;
+        while (pending > 0) {
+            const ssize_t written = write(fd, bytes, pending);
+            if (written < 0 && EINTR == errno) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            bytes += written;
+            pending -= (size_t) written;
+        }
+    }
+    return true;
+}
+
+bool HttpDiskCache_store(const uint64_t key, const uint64_t variant, const struct HttpCacheFreshness freshness,
+                         const struct iovec *parts, const size_t partsLength) {
+    assert(parts);
+    size_t size = 0;
+    for (size_t i = 0; i < partsLength; i++) {
+        size += parts[i].iov_len;
+    }
+
+    pthread_mutex_lock(&cache.lock);
+    if (!cache.open || size > cache.capacity) {
+        pthread_mutex_unlock(&cache.lock);
+        return false;
+    }
+    const uint64_t file = cache.index->nextFile++;
+    Text temporaryPath = pathOf(file, TEMPORARY_SUFFIX);
+    Text path = pathOf(file, ENTRY_SUFFIX);
+    const int directoryFd = dup(cache.directoryFd);
+    pthread_mutex_unlock(&cache.lock);
+
+    // the response is written without holding the lock and published only once complete and durable
+    const int fd = directoryFd < 0 ? -1 : open(temporaryPath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    bool written = fd >= 0 && writeParts(fd, parts, partsLength) && 0 == fsync(fd);
+    written = fd >= 0 && 0 == close(fd) && written && 0 == rename(temporaryPath, path) && 0 == fsync(directoryFd);
+    if (directoryFd >= 0) {
+        close(directoryFd);
+    }
+    if (!written) {
+        unlinkPath(temporaryPath);
+        unlinkPath(path);
+        return false;
+    }
+    Text_delete(temporaryPath);
+
+    pthread_mutex_lock(&cache.lock);
+    if (!cache.open) {
+        pthread_mutex_unlock(&cache.lock);
+        unlinkPath(path);
+        return false;
+    }
+    struct Slot *target = NULL;
+    for (size_t i = 0; i < HTTP_DISK_CACHE_PROBES; i++) {
+        struct Slot *slot = &cache.index->slots[(key + i) % HTTP_DISK_CACHE_SLOTS];
+        if (!isValid(slot)) {
+            target = NULL == target || isValid(target) ? slot : target;
+        } else if (slot->key == key && slot->variant == variant) {
+            target = slot;
+            break;
+        } else if (NULL == target || (isValid(target) && slot->lastAccess < target->lastAccess)) {
+            target = slot;
+        }
+    }
+    Text replacedPath = NULL;
+    if (isValid(target)) {
+        if (target->key != key || target->variant != variant) {
+            cache.stats.evictions++;
+        }
+        replacedPath = clearSlot(target);
+    }
+    publish(target, (struct Slot) {
+            .key=key, .variant=variant, .file=file, .size=size, .responseTime=freshness.responseTime,
+            .initialAge=freshness.initialAge, .lifetime=freshness.lifetime, .lastAccess=time(NULL),
+            .flags=freshness.noCache ? SLOT_NO_CACHE : 0
+    });
+    persist(target);
+    cache.stats.stores++;
+    cache.stats.entries++;
+    cache.stats.bytes += size;
+    if (cache.stats.bytes > cache.capacity) {
+        pthread_cond_signal(&cache.wakeup);
+    }
+    pthread_mutex_unlock(&cache.lock);
+
+    if (NULL != replacedPath) {
+        unlinkPath(replacedPath);
+    }
+    Text_delete(path);
+    return true;
+}
+
+bool HttpDiskCache_find(const uint64_t key, size_t *cursor, Text *path, uint64_t *variant,
+                        struct HttpCacheFreshness *freshness) {
+    assert(cursor);
+    assert(path);
+    assert(variant);
+    assert(freshness);
+    pthread_mutex_lock(&cache.lock);
+    for (; cache.open && *cursor < HTTP_DISK_CACHE_PROBES; (*cursor)++) {
+        struct Slot *slot = &cache.index->slots[(key + *cursor) % HTTP_DISK_CACHE_SLOTS];
+        if (isValid(slot) && slot->key == key) {
+            *path = Text_overwriteWithFormat(path, "%s/%016" PRIx64 "%s", cache.directory, slot->file, ENTRY_SUFFIX);
+            *variant = slot->variant;
+            *freshness = freshnessOf(slot);
+            slot->lastAccess = time(NULL);
+            (*cursor)++;
+            pthread_mutex_unlock(&cache.lock);
+            return true;
+        }
+    }
+    pthread_mutex_unlock(&cache.lock);
+    return false;
+}
+
+void HttpDiskCache_refresh(const uint64_t key, const uint64_t variant, const struct HttpCacheFreshness freshness) {
+    pthread_mutex_lock(&cache.lock);
+    for (size_t i = 0; cache.open && i < HTTP_DISK_CACHE_PROBES; i++) {
+        struct Slot *slot = &cache.index->slots[(key + i) % HTTP_DISK_CACHE_SLOTS];
+        if (isValid(slot) && slot->key == key && slot->variant == variant) {
+            struct Slot value = *slot;
+            value.responseTime = freshness.responseTime;
+            value.initialAge = freshness.initialAge;
+            value.lifetime = freshness.lifetime;
+            value.flags = freshness.noCache ? SLOT_NO_CACHE : 0;
+            publish(slot, value);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache.lock);
+}
+
+void HttpDiskCache_remove(const uint64_t key, const uint64_t variant) {
+    Text path = NULL;
+    pthread_mutex_lock(&cache.lock);
+    for (size_t i = 0; cache.open && i < HTTP_DISK_CACHE_PROBES; i++) {
+        struct Slot *slot = &cache.index->slots[(key + i) % HTTP_DISK_CACHE_SLOTS];
+        if (isValid(slot) && slot->key == key && slot->variant == variant) {
+            path = clearSlot(slot);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache.lock);
+    if (NULL != path) {
+        unlinkPath(path);
+    }
+}
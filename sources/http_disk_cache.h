@@ -0,0 +1,154 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <http.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of slots of the index, the maximum number of responses the disk cache can hold.
+ */
+#ifndef HTTP_DISK_CACHE_SLOTS
+#define HTTP_DISK_CACHE_SLOTS  4096
+#endif
+
+/**
+ * Number of consecutive slots a key may be placed into, when they are all taken the least recently used one is
+ * replaced.
+ */
+#ifndef HTTP_DISK_CACHE_PROBES
+#define HTTP_DISK_CACHE_PROBES  16
+#endif
+
+/**
+ * Counters of the disk cache since it has been opened:
+ *  - stores: responses written to the disk cache;
+ *  - evictions: responses evicted to keep the disk cache within its capacity, or to make room in the index;
+ *  - entries: responses currently stored;
+ *  - bytes: size of the files currently stored.
+ */
+struct HttpDiskCacheStats {
+    size_t stores;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+/**
+ * Opens the disk cache backing the response cache of HttpRequest_fire, creating the directory if missing.
+ * The directory holds an index, memory mapped and updated in place, and one file per response. Files are synced to
+ * disk before their slot is published, and index slots carry a checksum: slots torn by a crash, of the process or of
+ * the system, are discarded when the cache is opened again, along with the files no slot refers to. Once opened, responses are written to disk as they are stored into the cache, and looked up on disk when not
+ * found in memory, so that they survive restarts; Http_setCacheCapacity still bounds the in-memory part alone.
+ * A background thread evicts the least recently used responses whenever the files exceed the capacity.
+ * A directory can be used by one process at a time.
+ *
+ * @attention directory must not be NULL.
+ *
+ * @param capacity The maximum size of the files stored, responses larger than that are not stored.
+ * @return true if the cache has been opened else false, if the directory can not be used or is locked by another
+ * process. A previously opened disk cache is closed in any case.
+ */
+extern bool
+Http_openDiskCache(const char *directory, size_t capacity)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Closes the disk cache if open, stopping its background eviction. Stored responses are kept on disk.
+ */
+extern void
+Http_closeDiskCache(void);
+
+/**
+ * Returns true if the disk cache is open else false.
+ */
+extern bool
+Http_isDiskCacheOpen(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns the counters of the disk cache, all 0 if it is not open.
+ */
+extern struct HttpDiskCacheStats
+Http_getDiskCacheStats(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Writes a response made of parts into a new file and publishes it in the index, replacing the response stored with
+ * the same key and variant if any. The response cache does this on its own, this is meant for other caching layers.
+ *
+ * @attention parts must not be NULL.
+ *
+ * @param key The hash identifying the url of the response, distinct urls may share a key.
+ * @param variant The hash identifying the response among the ones of the same url.
+ * @return true if the response has been stored else false.
+ */
+extern bool
+HttpDiskCache_store(uint64_t key, uint64_t variant, struct HttpCacheFreshness freshness,
+                    const struct iovec *parts, size_t partsLength)
+__attribute__((__nonnull__));
+
+/**
+ * Finds the next response stored with key, starting from *cursor which must be 0 for the first call, marking it as
+ * recently used.
+ *
+ * @attention cursor, path, *path, variant and freshness must not be NULL.
+ *
+ * @param path Overwritten with the path of the file holding the response.
+ * @return true if a response has been found else false.
+ */
+extern bool
+HttpDiskCache_find(uint64_t key, size_t *cursor, Text *path, uint64_t *variant,
+                   struct HttpCacheFreshness *freshness)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Updates the freshness of the response stored with key and variant, if still stored.
+ */
+extern void
+HttpDiskCache_refresh(uint64_t key, uint64_t variant, struct HttpCacheFreshness freshness);
+
+/**
+ * Removes the response stored with key and variant, if still stored, and its file.
+ */
+extern void
+HttpDiskCache_remove(uint64_t key, uint64_t variant);
+
+#ifdef __cplusplus
+}
+#endif
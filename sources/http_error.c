@@ -31,6 +31,9 @@
 const Error HttpError_NetworkingError = Error_new("Networking error");
 const Error HttpError_ConnectionFailed = Error_new("Connection failed");
 const Error HttpError_ConnectionTimedOut = Error_new("Connection timed out");
+const Error HttpError_FirstByteTimedOut = Error_new("First byte timed out");
+const Error HttpError_TransferTimedOut = Error_new("Transfer timed out");
+const Error HttpError_TransferStalled = Error_new("Transfer stalled");
 const Error HttpError_ConnectionSSLFailed = Error_new("Connection SSL failed");
 const Error HttpError_AuthenticationFailed = Error_new("Authentication failed");
 const Error HttpError_UnableToResolveHost = Error_new("Unable to resolve host");
@@ -41,6 +41,9 @@ extern "C" {
 extern const Error HttpError_NetworkingError;
 extern const Error HttpError_ConnectionFailed;
 extern const Error HttpError_ConnectionTimedOut;
+extern const Error HttpError_FirstByteTimedOut;
+extern const Error HttpError_TransferTimedOut;
+extern const Error HttpError_TransferStalled;
 extern const Error HttpError_ConnectionSSLFailed;
 extern const Error HttpError_AuthenticationFailed;
 extern const Error HttpError_UnableToResolveHost;
@@ -0,0 +1,106 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <http.h>
+#include <http_status.h>
+#include <http_timings.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct HttpRequest;
+struct HttpResponse;
+
+/**
+ * Called right before a request is sent.
+ */
+typedef void (*HttpHooks_BeforeSend)(const struct HttpRequest *request, void *context);
+
+/**
+ * Called each time a block of response headers has been received, therefore once for every followed redirect.
+ * Timings are partial: only the phases completed so far are set.
+ */
+typedef void (*HttpHooks_HeadersReceived)(const struct HttpRequest *request, enum HttpStatus status,
+                                          const struct HttpTimings *timings, void *context);
+
+/**
+ * Called when the first byte of the response body has been received.
+ * Timings are partial: only the phases completed so far are set.
+ */
+typedef void (*HttpHooks_FirstBodyByte)(const struct HttpRequest *request, const struct HttpTimings *timings,
+                                        void *context);
+
+/**
+ * Called once the response has been received, right before it is returned.
+ */
+typedef void (*HttpHooks_Completed)(const struct HttpRequest *request, const struct HttpResponse *response,
+                                    const struct HttpTimings *timings, void *context);
+
+/**
+ * Called once a request has failed, right before the error is returned.
+ */
+typedef void (*HttpHooks_Failed)(const struct HttpRequest *request, Error error, const struct HttpTimings *timings,
+                                 void *context);
+
+/**
+ * Callbacks invoked along the lifecycle of every fired request, each of them may be NULL.
+ * Hooks run on the thread firing the request and must not fire requests on their own.
+ *
+ * Unset hooks cost nothing: the fire path only checks for NULL and skips the work needed to feed them.
+ */
+struct HttpHooks {
+    HttpHooks_BeforeSend beforeSend;
+    HttpHooks_HeadersReceived headersReceived;
+    HttpHooks_FirstBodyByte firstBodyByte;
+    HttpHooks_Completed completed;
+    HttpHooks_Failed failed;
+    void *context;
+};
+
+/**
+ * Registers the hooks invoked for every request fired from now on, replacing the previous ones.
+ * Requests already in flight keep calling the hooks registered when they were fired.
+ * Hooks are meant to be registered once, before firing requests, registering them while requests are being fired on
+ * other threads is not supported.
+ *
+ * @param hooks The hooks to be registered, an all-NULL instance disables hooks.
+ * @return The previous registered hooks, so that they can be chained.
+ */
+extern struct HttpHooks
+Http_registerHooks(struct HttpHooks hooks);
+
+#ifdef __cplusplus
+}
+#endif
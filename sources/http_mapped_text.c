@@ -0,0 +1,139 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <assert.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <panic/panic.h>
+
+/*
+ * The bookkeeping of a mapping immediately precedes the text header and content: at the start of anonymous mappings,
+ * in the headroom reserved before the text for file mappings.
+ */
+struct Mapping {
+    void *base;
+    size_t size;
+    struct HttpSharedText sharedText;
+};
+
+static size_t threshold = HTTP_MAPPED_BODY_DEFAULT_THRESHOLD;
+
+static void unmap(void *memory) {
+    assert(memory);
+    struct Mapping *self = memory;
+    if (0 != munmap(self->base, self->size)) {
+        Panic_terminate("Unable to unmap memory\n");
+    }
+}
+
+size_t Http_setMappedBodyThreshold(const size_t bytes) {
+    return __atomic_exchange_n(&threshold, bytes, __ATOMIC_RELAXED);
+}
+
+size_t Http_getMappedBodyThreshold(void) {
+    return __atomic_load_n(&threshold, __ATOMIC_RELAXED);
+}
+
+const struct HttpSharedText *HttpMappedText_fromFile(FILE *file, const size_t length) {
+    assert(file);
+    const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t overhead = sizeof(struct Mapping) + Text_overhead() + 1;
+    if (length > SIZE_MAX - overhead - pageSize) {
+        Panic_terminate("Unable to map memory\n");
+    }
+    const size_t size = (overhead + length + pageSize - 1) / pageSize * pageSize;
+
+    struct Mapping *self = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == self) {
+        Panic_terminate("Unable to map memory\n");
+    }
+#ifdef MADV_HUGEPAGE
+    // best effort: the mapping still works with regular pages if transparent huge pages are unavailable
+    (void) madvise(self, size, MADV_HUGEPAGE);
+#endif
+
+    self->base = self;
+    self->size = size;
+    Text text = Text_inPlace(self + 1, size - sizeof(*self));
+    if (length != fread(text, sizeof(text[0]), length, file)) {
+        Panic_terminate("Unable to read file\n");
+    }
+    Text_setLength(text, length);
+    text[length] = 0;
+    HttpSharedText_initialize(&self->sharedText, text, self, unmap);
+    return &self->sharedText;
+}
+
+size_t HttpMappedText_headroom(void) {
+    return sizeof(struct Mapping) + Text_overhead();
+}
+
+const struct HttpSharedText *HttpMappedText_fromPath(const char *path, const size_t offset, const size_t length) {
+    assert(path);
+    assert(offset >= HttpMappedText_headroom());
+    assert(0 == offset % sizeof(void *));
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat status;
+    const size_t size = offset + length + 1;
+    char *base = MAP_FAILED;
+    if (0 == fstat(fd, &status) && status.st_size >= 0 && (size_t) status.st_size >= size) {
+        // private: the bookkeeping written into the headroom never reaches the file
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    return MAP_FAILED == base ? NULL : HttpMappedText_fromMapping(base, size, offset, length);
+}
+
+const struct HttpSharedText *HttpMappedText_fromMapping(void *base, const size_t size, const size_t offset,
+                                                        const size_t length) {
+    assert(base);
+    assert(offset >= HttpMappedText_headroom());
+    assert(0 == offset % sizeof(void *));
+    char *bytes = base;
+    if (offset >= size || length >= size - offset || 0 != bytes[offset + length]) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    struct Mapping *self = (struct Mapping *) (bytes + offset - HttpMappedText_headroom());
+    self->base = base;
+    self->size = size;
+    const char first = bytes[offset];
+    Text text = Text_inPlace(self + 1, Text_overhead() + length + 1);
+    text[0] = first;
+    Text_setLength(text, length);
+    HttpSharedText_initialize(&self->sharedText, text, self, unmap);
+    return &self->sharedText;
+}
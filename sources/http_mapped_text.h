@@ -0,0 +1,120 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <http.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Default size above which response bodies are placed in memory mappings instead of the heap.
+ */
+#ifndef HTTP_MAPPED_BODY_DEFAULT_THRESHOLD
+#define HTTP_MAPPED_BODY_DEFAULT_THRESHOLD  (4 * 1024 * 1024)
+#endif
+
+/**
+ * Sets the size above which HttpRequest_fire places response bodies in anonymous memory mappings, advised for
+ * transparent huge pages where supported, instead of a single giant heap allocation.
+ * Mapped bodies are returned to the operating system as soon as the response and every shared reference to the body
+ * are released.
+ *
+ * @param bytes The threshold, 0 disables mapped bodies.
+ * @return The previous threshold.
+ */
+extern size_t
+Http_setMappedBodyThreshold(size_t bytes);
+
+/**
+ * Returns the size above which response bodies are placed in memory mappings, 0 if disabled.
+ */
+extern size_t
+Http_getMappedBodyThreshold(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Creates a shared text holding the next length bytes of file, placed in an anonymous memory mapping that is
+ * unmapped when the last reference is released.
+ *
+ * @attention file must not be NULL.
+ * @attention terminates execution if the mapping can not be created or file has less than length bytes left.
+ */
+extern const struct HttpSharedText *
+HttpMappedText_fromFile(FILE *file, size_t length)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the number of bytes that must precede a text mapped with HttpMappedText_fromPath or
+ * HttpMappedText_fromMapping.
+ */
+extern size_t
+HttpMappedText_headroom(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Maps a file privately, from its beginning up to the text of length bytes found at offset, which must be followed by
+ * a NUL byte. The HttpMappedText_headroom bytes preceding offset are overwritten in memory by the bookkeeping of the
+ * mapping, the file is left untouched; the bytes before them stay readable through the text for as long as it lives.
+ * The file must not be truncated while the text is alive, it may be unlinked or replaced.
+ *
+ * @attention path must not be NULL.
+ * @attention offset must be at least HttpMappedText_headroom() and a multiple of the pointer size.
+ *
+ * @return The mapped text, NULL if the file can not be opened, is too short or lacks the NUL byte after the text.
+ */
+extern const struct HttpSharedText *
+HttpMappedText_fromPath(const char *path, size_t offset, size_t length)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Takes the ownership of the private memory mapping of size bytes at base, building a text in place over the length
+ * bytes found at offset, which must be followed by a NUL byte. As with HttpMappedText_fromPath, the
+ * HttpMappedText_headroom bytes preceding offset are overwritten and the bytes before them stay readable through the
+ * text; the mapping is unmapped when the last reference is released.
+ *
+ * @attention base must not be NULL.
+ * @attention offset must be at least HttpMappedText_headroom() and a multiple of the pointer size.
+ *
+ * @return The mapped text, NULL if the mapping is too short or lacks the NUL byte after the text, in which case it is
+ * unmapped.
+ */
+extern const struct HttpSharedText *
+HttpMappedText_fromMapping(void *base, size_t size, size_t offset, size_t length)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,442 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <panic/panic.h>
+#include <alligator/alligator.h>
+
+/*
+ * Latencies are recorded in microseconds into HDR-style log-linear buckets: every power of two is split into
+ * SUB_BUCKET_COUNT linear sub-buckets, so the relative error of a bucket never exceeds 1 / SUB_BUCKET_COUNT.
+ * Values above 2^MAX_LATENCY_BITS microseconds (about 19 hours) are clamped into the last bucket.
+ */
+#define SUB_BUCKET_BITS     3
+#define SUB_BUCKET_COUNT    (1U << SUB_BUCKET_BITS)
+#define MAX_LATENCY_BITS    36
+#define BUCKET_COUNT        ((MAX_LATENCY_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT)
+
+/*
+ * The exported histogram is coarser than the recorded one: one bucket per power of two from 256us to about 33s.
+ */
+#define EXPORTED_MIN_BITS   8
+#define EXPORTED_MAX_BITS   25
+
+enum StatusClass {
+    STATUS_CLASS_1XX = 0,
+    STATUS_CLASS_2XX,
+    STATUS_CLASS_3XX,
+    STATUS_CLASS_4XX,
+    STATUS_CLASS_5XX,
+    STATUS_CLASS_ERROR,
+    STATUS_CLASS_COUNT
+};
+
+static const char *const statusClassNames[STATUS_CLASS_COUNT] = {"1xx", "2xx", "3xx", "4xx", "5xx", "error"};
+
+/*
+ * Counters of a single host.
+ * Each host belongs to a shard and is written only by the thread owning that shard, readers may run concurrently.
+ * The hash is published last, a host whose hash is 0 is unused.
+ */
+struct Host {
+    uint64_t hash;
+    char name[HTTP_METRICS_MAX_HOST_LENGTH];
+    uint64_t requests[STATUS_CLASS_COUNT];
+    uint64_t sentBytes;
+    uint64_t receivedBytes;
+    uint64_t latencySum;
+    uint64_t latency[BUCKET_COUNT];
+};
+
+struct Shard {
+    struct Shard *next;
+    bool owned;
+    struct Host other;
+    struct Host hosts[HTTP_METRICS_MAX_HOSTS];
+};
+
+static struct Shard *shards = NULL;
+static __thread struct Shard *localShard = NULL;
+static pthread_key_t shardKey;
+static pthread_once_t shardKeyOnce = PTHREAD_ONCE_INIT;
+
+static const char otherHost[] = "other";
+
+static uint64_t hashOf(const char *bytes, const size_t size) {
+    assert(bytes);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char) bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return 0 == hash ? 1 : hash;
+}
+
+static void add(uint64_t *counter, const uint64_t value) {
+    // single writer: a relaxed load and store are enough and avoid a locked instruction
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static uint64_t load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static size_t bucketOf(uint64_t value) {
+    const uint64_t max = (1ULL << MAX_LATENCY_BITS) - 1;
+    if (value > max) {
+        value = max;
+    }
+    if (value < SUB_BUCKET_COUNT) {
+        return (size_t) value;
+    }
+    const unsigned shift = (unsigned) (64 - __builtin_clzll(value)) - SUB_BUCKET_BITS - 1;
+    return ((size_t) shift << SUB_BUCKET_BITS) + (size_t) (value >> shift);
+}
+
+static uint64_t bucketLowerBound(const size_t index) {
+    const unsigned shift = index < 2 * SUB_BUCKET_COUNT ? 0 : (unsigned) (index >> SUB_BUCKET_BITS) - 1;
+    return (uint64_t) (index - ((size_t) shift << SUB_BUCKET_BITS)) << shift;
+}
+
+static uint64_t bucketUpperBound(const size_t index) {
+    const unsigned shift = index < 2 * SUB_BUCKET_COUNT ? 0 : (unsigned) (index >> SUB_BUCKET_BITS) - 1;
+    return bucketLowerBound(index) + (1ULL << shift) - 1;
+}
+
+static enum StatusClass statusClassOf(const enum HttpStatus status, const Error error) {
+    if (Ok != error || status < 100 || status > 599) {
+        return STATUS_CLASS_ERROR;
+    }
+    return (enum StatusClass) (status / 100 - 1);
+}
+
+static size_t hostOf(Atom url, const char **host) {
+    assert(url);
+    assert(host);
+    const char *start = strstr(url, "://");
+    start = NULL == start ? url : start + 3;
+    const size_t length = strcspn(start, "/?#");
+    for (size_t i = length; i > 0; i--) {
+        if ('@' == start[i - 1]) {
+            *host = start + i;
+            return length - i;
+        }
+    }
+    *host = start;
+    return length;
+}
+
+static void initializeHost(struct Host *host, const char *name, size_t length, const uint64_t hash) {
+    assert(host);
+    assert(name);
+    if (length >= HTTP_METRICS_MAX_HOST_LENGTH) {
+        length = HTTP_METRICS_MAX_HOST_LENGTH - 1;
+    }
+    memcpy(host->name, name, length);
+    host->name[length] = '\0';
+    __atomic_store_n(&host->hash, hash, __ATOMIC_RELEASE);
+}
+
+static bool hostEquals(const struct Host *host, const char *name, size_t length) {
+    assert(host);
+    assert(name);
+    if (length >= HTTP_METRICS_MAX_HOST_LENGTH) {
+        length = HTTP_METRICS_MAX_HOST_LENGTH - 1;
+    }
+    return 0 == memcmp(host->name, name, length) && '\0' == host->name[length];
+}
+
+static struct Host *findHost(struct Shard *shard, const char *name, const size_t length) {
+    assert(shard);
+    assert(name);
+    const uint64_t hash = hashOf(name, length);
+    for (size_t probe = 0, i = (size_t) (hash % HTTP_METRICS_MAX_HOSTS); probe < HTTP_METRICS_MAX_HOSTS; probe++) {
+        struct Host *host = &shard->hosts[i];
+        if (0 == host->hash) {
+            initializeHost(host, name, length, hash);
+            return host;
+        }
+        if (hash == host->hash && hostEquals(host, name, length)) {
+            return host;
+        }
+        i = (i + 1) % HTTP_METRICS_MAX_HOSTS;
+    }
+    return &shard->other;
+}
+
+static void releaseShard(void *shard) {
+    assert(shard);
+    __atomic_store_n(&((struct Shard *) shard)->owned, false, __ATOMIC_RELEASE);
+}
+
+static void createShardKey(void) {
+    if (0 != pthread_key_create(&shardKey, releaseShard)) {
+        Panic_terminate("Unable to create metrics thread key\n");
+    }
+}
+
+/*
+ * Shards are never freed: the shard of a terminated thread keeps its counters and is handed over to the next
+ * thread in need of one.
+ */
+static struct Shard *acquireShard(void) {
+    pthread_once(&shardKeyOnce, createShardKey);
+    struct Shard *shard = __atomic_load_n(&shards, __ATOMIC_ACQUIRE);
+    for (; NULL != shard; shard = shard->next) {
+        bool expected = false;
+        if (__atomic_compare_exchange_n(&shard->owned, &expected, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (NULL == shard) {
+        shard = Option_unwrap(Alligator_calloc(1, sizeof(*shard)));
+        shard->owned = true;
+        initializeHost(&shard->other, otherHost, sizeof(otherHost) - 1, hashOf(otherHost, sizeof(otherHost) - 1));
+        shard->next = __atomic_load_n(&shards, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&shards, &shard->next, shard, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    if (0 != pthread_setspecific(shardKey, shard)) {
+        Panic_terminate("Unable to set metrics thread key\n");
+    }
+    return shard;
+}
+
+void HttpMetrics_record(Atom url, const enum HttpStatus status, const Error error,
+                        const struct HttpTimings *const timings) {
+    assert(url);
+    assert(timings);
+    if (NULL == localShard) {
+        localShard = acquireShard();
+    }
+    const char *name = NULL;
+    const size_t length = hostOf(url, &name);
+    struct Host *host = findHost(localShard, name, length);
+    add(&host->requests[statusClassOf(status, error)], 1);
+    add(&host->sentBytes, timings->bytesUploaded);
+    add(&host->receivedBytes, timings->bytesDownloaded);
+    add(&host->latencySum, timings->total);
+    add(&host->latency[bucketOf(timings->total)], 1);
+}
+
+static void merge(struct Host *into, const struct Host *from) {
+    assert(into);
+    assert(from);
+    for (size_t i = 0; i < STATUS_CLASS_COUNT; i++) {
+        into->requests[i] += load(&from->requests[i]);
+    }
+    into->sentBytes += load(&from->sentBytes);
+    into->receivedBytes += load(&from->receivedBytes);
+    into->latencySum += load(&from->latencySum);
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        into->latency[i] += load(&from->latency[i]);
+    }
+}
+
+struct Totals {
+    struct Host *hosts;
+    size_t length;
+    size_t capacity;
+};
+
+static void accumulate(struct Totals *totals, const struct Host *host) {
+    assert(totals);
+    assert(host);
+    const uint64_t hash = __atomic_load_n(&host->hash, __ATOMIC_ACQUIRE);
+    if (0 == hash) {
+        return;
+    }
+    const size_t length = strlen(host->name);
+    for (size_t i = 0; i < totals->length; i++) {
+        if (hash == totals->hosts[i].hash && hostEquals(&totals->hosts[i], host->name, length)) {
+            merge(&totals->hosts[i], host);
+            return;
+        }
+    }
+    if (totals->length == totals->capacity) {
+        totals->capacity = 0 == totals->capacity ? HTTP_METRICS_MAX_HOSTS : totals->capacity * 2;
+        totals->hosts = Option_unwrap(Alligator_realloc(totals->hosts, totals->capacity * sizeof(totals->hosts[0])));
+    }
+    struct Host *total = &totals->hosts[totals->length++];
+    memset(total, 0, sizeof(*total));
+    initializeHost(total, host->name, length, hash);
+    merge(total, host);
+}
+
+static int compareHosts(const void *a, const void *b) {
+    return strcmp(((const struct Host *) a)->name, ((const struct Host *) b)->name);
+}
+
+static uint64_t countOf(const struct Host *host) {
+    assert(host);
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        count += host->latency[i];
+    }
+    return count;
+}
+
+static uint64_t quantileOf(const struct Host *host, const uint64_t count, const double quantile) {
+    assert(host);
+    assert(count > 0);
+    uint64_t rank = (uint64_t) (quantile * (double) count + 0.5), seen = 0;
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += host->latency[i];
+        if (seen >= rank) {
+            return (bucketLowerBound(i) + bucketUpperBound(i)) / 2;
+        }
+    }
+    return bucketUpperBound(BUCKET_COUNT - 1);
+}
+
+static Text escapeLabel(const char *value) {
+    assert(value);
+    Text label = Text_withCapacity(strlen(value));
+    for (; '\0' != *value; value++) {
+        switch (*value) {
+            case '\\':
+                label = Text_appendLiteral(&label, "\\\\");
+                break;
+            case '"':
+                label = Text_appendLiteral(&label, "\\\"");
+                break;
+            case '\n':
+                label = Text_appendLiteral(&label, "\\n");
+                break;
+            default:
+                label = Text_appendBytes(&label, value, 1);
+        }
+    }
+    return label;
+}
+
+static void exportRequests(Text *out, const struct Totals *totals, const Text *labels) {
+    *out = Text_appendLiteral(out, "# HELP http_client_requests_total Requests fired, by host and status class.\n"
+                                   "# TYPE http_client_requests_total counter\n");
+    for (size_t i = 0; i < totals->length; i++) {
+        for (size_t c = 0; c < STATUS_CLASS_COUNT; c++) {
+            *out = Text_appendFormat(out, "http_client_requests_total{host=\"%s\",class=\"%s\"} %llu\n",
+                                     labels[i], statusClassNames[c],
+                                     (unsigned long long) totals->hosts[i].requests[c]);
+        }
+    }
+}
+
+static void exportLatency(Text *out, const struct Totals *totals, const Text *labels) {
+    static const double quantiles[] = {0.5, 0.99, 0.999};
+    *out = Text_appendLiteral(out, "# HELP http_client_request_duration_seconds Request latency, by host.\n"
+                                   "# TYPE http_client_request_duration_seconds histogram\n");
+    for (size_t i = 0; i < totals->length; i++) {
+        const struct Host *host = &totals->hosts[i];
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (unsigned bits = EXPORTED_MIN_BITS; bits <= EXPORTED_MAX_BITS; bits++) {
+            const uint64_t bound = 1ULL << bits;
+            for (; bucket < BUCKET_COUNT && bucketUpperBound(bucket) < bound; bucket++) {
+                cumulative += host->latency[bucket];
+            }
+            *out = Text_appendFormat(out, "http_client_request_duration_seconds_bucket{host=\"%s\",le=\"%.6f\"} %llu\n",
+                                     labels[i], (double) bound / 1e6, (unsigned long long) cumulative);
+        }
+        const uint64_t count = countOf(host);
+        *out = Text_appendFormat(out, "http_client_request_duration_seconds_bucket{host=\"%s\",le=\"+Inf\"} %llu\n"
+                                      "http_client_request_duration_seconds_sum{host=\"%s\"} %.6f\n"
+                                      "http_client_request_duration_seconds_count{host=\"%s\"} %llu\n",
+                                 labels[i], (unsigned long long) count,
+                                 labels[i], (double) host->latencySum / 1e6,
+                                 labels[i], (unsigned long long) count);
+    }
+
+    *out = Text_appendLiteral(out, "# HELP http_client_request_duration_quantile_seconds Request latency quantiles, "
+                                   "by host.\n"
+                                   "# TYPE http_client_request_duration_quantile_seconds gauge\n");
+    for (size_t i = 0; i < totals->length; i++) {
+        const uint64_t count = countOf(&totals->hosts[i]);
+        if (0 == count) {
+            continue;
+        }
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            *out = Text_appendFormat(out, "http_client_request_duration_quantile_seconds{host=\"%s\",quantile=\"%g\"} "
+                                          "%.6f\n",
+                                     labels[i], quantiles[q],
+                                     (double) quantileOf(&totals->hosts[i], count, quantiles[q]) / 1e6);
+        }
+    }
+}
+
+static void exportBytes(Text *out, const struct Totals *totals, const Text *labels) {
+    *out = Text_appendLiteral(out, "# HELP http_client_sent_bytes_total Request body bytes sent, by host.\n"
+                                   "# TYPE http_client_sent_bytes_total counter\n");
+    for (size_t i = 0; i < totals->length; i++) {
+        *out = Text_appendFormat(out, "http_client_sent_bytes_total{host=\"%s\"} %llu\n",
+                                 labels[i], (unsigned long long) totals->hosts[i].sentBytes);
+    }
+    *out = Text_appendLiteral(out, "# HELP http_client_received_bytes_total Response body bytes received, by host.\n"
+                                   "# TYPE http_client_received_bytes_total counter\n");
+    for (size_t i = 0; i < totals->length; i++) {
+        *out = Text_appendFormat(out, "http_client_received_bytes_total{host=\"%s\"} %llu\n",
+                                 labels[i], (unsigned long long) totals->hosts[i].receivedBytes);
+    }
+}
+
+void Http_exportMetrics(Text *out) {
+    assert(out);
+    assert(*out);
+    struct Totals totals = {.hosts=NULL, .length=0, .capacity=0};
+    for (const struct Shard *shard = __atomic_load_n(&shards, __ATOMIC_ACQUIRE); NULL != shard; shard = shard->next) {
+        for (size_t i = 0; i < HTTP_METRICS_MAX_HOSTS; i++) {
+            accumulate(&totals, &shard->hosts[i]);
+        }
+        accumulate(&totals, &shard->other);
+    }
+    if (0 == totals.length) {
+        return;
+    }
+    qsort(totals.hosts, totals.length, sizeof(totals.hosts[0]), compareHosts);
+
+    Text *labels = Option_unwrap(Alligator_malloc(totals.length * sizeof(labels[0])));
+    for (size_t i = 0; i < totals.length; i++) {
+        labels[i] = escapeLabel(totals.hosts[i].name);
+    }
+
+    exportRequests(out, &totals, labels);
+    exportLatency(out, &totals, labels);
+    exportBytes(out, &totals, labels);
+
+    for (size_t i = 0; i < totals.length; i++) {
+        Text_delete(labels[i]);
+    }
+    Alligator_free(labels);
+    Alligator_free(totals.hosts);
+}
@@ -0,0 +1,95 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <http.h>
+#include <http_status.h>
+#include <http_timings.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum number of distinct hosts tracked by each thread, further hosts are accounted under the "other" host.
+ */
+#ifndef HTTP_METRICS_MAX_HOSTS
+#define HTTP_METRICS_MAX_HOSTS  32
+#endif
+
+/**
+ * Maximum length of a tracked host name, longer names are truncated.
+ */
+#ifndef HTTP_METRICS_MAX_HOST_LENGTH
+#define HTTP_METRICS_MAX_HOST_LENGTH  128
+#endif
+
+/**
+ * Records the outcome of a request into the metrics of the calling thread.
+ * HttpRequest_fire records every request on its own, this is meant for requests performed by other means.
+ *
+ * Recording never locks: every thread owns a shard of counters and histograms which is merged with the others only
+ * when metrics are exported.
+ *
+ * @attention url must not be NULL.
+ * @attention timings must not be NULL.
+ *
+ * @param url The url of the request, only the host part is used.
+ * @param status The status of the response, ignored if error is not Ok.
+ * @param error Ok if a response was received, the error returned by the request otherwise.
+ * @param timings The timings of the request.
+ */
+extern void
+HttpMetrics_record(Atom url, enum HttpStatus status, Error error, const struct HttpTimings *timings)
+__attribute__((__nonnull__));
+
+/**
+ * Appends the metrics recorded so far by every thread to out, rendered in the Prometheus text exposition format.
+ *
+ * Exported metrics:
+ *  - http_client_requests_total{host, class}: requests by status class (1xx to 5xx, or error);
+ *  - http_client_request_duration_seconds{host}: latency histogram;
+ *  - http_client_request_duration_quantile_seconds{host, quantile}: p50, p99 and p999 latency;
+ *  - http_client_sent_bytes_total{host} and http_client_received_bytes_total{host}: body bytes.
+ *
+ * @attention out and *out must not be NULL.
+ *
+ * @attention the reference to the text may be invalidated after this call, *out is updated with the new text.
+ */
+extern void
+Http_exportMetrics(Text *out)
+__attribute__((__nonnull__));
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * USDT probes fired along the fire path, provider "http":
+ *  - request__start(method, url)
+ *  - connect__done(url, ip, port): a connection is ready and the request is about to be sent
+ *  - headers__received(url, status): a block of response headers has been received
+ *  - body__complete(url, status, bytesDownloaded, bytesUploaded)
+ *  - request__error(url, error)
+ * Strings are passed as pointers to NUL-terminated strings.
+ *
+ * Probes need <sys/sdt.h> from systemtap, when it is not available, or when HTTP_DISABLE_PROBES is defined, they
+ * compile away. When available every probe has a semaphore, counted up by tracers such as bpftrace while they are
+ * attached, e.g. bpftrace -e 'usdt:./libhttp.so:http:request__start { printf("%s %s\n", str(arg0), str(arg1)); }'
+ * HTTP_PROBE_*_ENABLED() reads it: probe arguments are only computed, and the work done only for a probe is only
+ * done, while someone is listening.
+ */
+
+#if !defined(HTTP_DISABLE_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define HTTP_PROBES_ENABLED 1
+#endif
+#endif
+
+#ifdef HTTP_PROBES_ENABLED
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/*
+ * Semaphores are defined in http.c, placed in the .probes section where tracers expect them.
+ */
+extern volatile unsigned short http_request__start_semaphore;
+extern volatile unsigned short http_connect__done_semaphore;
+extern volatile unsigned short http_headers__received_semaphore;
+extern volatile unsigned short http_body__complete_semaphore;
+extern volatile unsigned short http_request__error_semaphore;
+
+#define HTTP_PROBE_REQUEST_START_ENABLED()      __builtin_expect(0 != http_request__start_semaphore, 0)
+#define HTTP_PROBE_CONNECT_DONE_ENABLED()       __builtin_expect(0 != http_connect__done_semaphore, 0)
+#define HTTP_PROBE_HEADERS_RECEIVED_ENABLED()   __builtin_expect(0 != http_headers__received_semaphore, 0)
+#define HTTP_PROBE_BODY_COMPLETE_ENABLED()      __builtin_expect(0 != http_body__complete_semaphore, 0)
+#define HTTP_PROBE_REQUEST_ERROR_ENABLED()      __builtin_expect(0 != http_request__error_semaphore, 0)
+
+#define HTTP_PROBE_REQUEST_START(method, url) \
+    do { if (HTTP_PROBE_REQUEST_START_ENABLED()) DTRACE_PROBE2(http, request__start, method, url); } while (0)
+#define HTTP_PROBE_CONNECT_DONE(url, ip, port) \
+    do { if (HTTP_PROBE_CONNECT_DONE_ENABLED()) DTRACE_PROBE3(http, connect__done, url, ip, port); } while (0)
+#define HTTP_PROBE_HEADERS_RECEIVED(url, status) \
+    do { if (HTTP_PROBE_HEADERS_RECEIVED_ENABLED()) DTRACE_PROBE2(http, headers__received, url, status); } while (0)
+#define HTTP_PROBE_BODY_COMPLETE(url, status, bytesDownloaded, bytesUploaded)                                   \
+    do {                                                                                                        \
+        if (HTTP_PROBE_BODY_COMPLETE_ENABLED())                                                                 \
+            DTRACE_PROBE4(http, body__complete, url, status, bytesDownloaded, bytesUploaded);                   \
+    } while (0)
+#define HTTP_PROBE_REQUEST_ERROR(url, error) \
+    do { if (HTTP_PROBE_REQUEST_ERROR_ENABLED()) DTRACE_PROBE2(http, request__error, url, error); } while (0)
+
+#else
+
+#define HTTP_PROBE_REQUEST_START_ENABLED()                                      0
+#define HTTP_PROBE_CONNECT_DONE_ENABLED()                                       0
+#define HTTP_PROBE_HEADERS_RECEIVED_ENABLED()                                   0
+#define HTTP_PROBE_BODY_COMPLETE_ENABLED()                                      0
+#define HTTP_PROBE_REQUEST_ERROR_ENABLED()                                      0
+
+#define HTTP_PROBE_REQUEST_START(method, url)                                   ((void) 0)
+#define HTTP_PROBE_CONNECT_DONE(url, ip, port)                                  ((void) 0)
+#define HTTP_PROBE_HEADERS_RECEIVED(url, status)                                ((void) 0)
+#define HTTP_PROBE_BODY_COMPLETE(url, status, bytesDownloaded, bytesUploaded)   ((void) 0)
+#define HTTP_PROBE_REQUEST_ERROR(url, error)                                    ((void) 0)
+
+#endif
@@ -34,8 +34,15 @@ struct HttpRequest {
     Atom url;
     Text headers;
     Text body;
-    size_t timeout;
+    struct HttpRope *rope;
+    size_t connectTimeout;
+    size_t firstByteTimeout;
+    size_t totalTimeout;
+    size_t lowSpeedLimit;
+    size_t lowSpeedTime;
+    size_t bodyReleaseThreshold;
     bool followLocation;
+    bool keepAlive;
     bool peerVerification;
     bool hostVerification;
     enum HttpMethod method;
@@ -61,9 +68,49 @@ TextView HttpRequest_getBody(const struct HttpRequest *self) {
     return NULL == self->body ? Http_getEmptyString() : self->body;
 }
 
+const struct HttpRope *HttpRequest_getRope(const struct HttpRequest *self) {
+    assert(self);
+    return self->rope;
+}
+
 size_t HttpRequest_getTimeout(const struct HttpRequest *self) {
     assert(self);
-    return self->timeout;
+    return (self->totalTimeout + 999) / 1000;
+}
+
+size_t HttpRequest_getConnectTimeout(const struct HttpRequest *self) {
+    assert(self);
+    return self->connectTimeout;
+}
+
+size_t HttpRequest_getFirstByteTimeout(const struct HttpRequest *self) {
+    assert(self);
+    return self->firstByteTimeout;
+}
+
+size_t HttpRequest_getTotalTimeout(const struct HttpRequest *self) {
+    assert(self);
+    return self->totalTimeout;
+}
+
+size_t HttpRequest_getLowSpeedLimit(const struct HttpRequest *self) {
+    assert(self);
+    return self->lowSpeedLimit;
+}
+
+size_t HttpRequest_getLowSpeedTime(const struct HttpRequest *self) {
+    assert(self);
+    return self->lowSpeedTime;
+}
+
+size_t HttpRequest_getBodyReleaseThreshold(const struct HttpRequest *self) {
+    assert(self);
+    return self->bodyReleaseThreshold;
+}
+
+bool HttpRequest_getKeepAlive(const struct HttpRequest *self) {
+    assert(self);
+    return self->keepAlive;
 }
 
 bool HttpRequest_getFollowLocation(const struct HttpRequest *self) {
@@ -81,8 +128,40 @@ bool HttpRequest_getHostVerification(const struct HttpRequest *self) {
     return self->hostVerification;
 }
 
+static size_t textMemoryUsage(TextView text) {
+    return NULL == text ? 0 : Text_overhead() + Text_capacity(text) + 1;
+}
+
+size_t HttpRequest_getMemoryUsage(const struct HttpRequest *self) {
+    assert(self);
+    return sizeof(*self) + textMemoryUsage(self->headers) + textMemoryUsage(self->body) +
+           (NULL == self->rope ? 0 : HttpRope_length(self->rope));
+}
+
+void HttpRequest_releaseBody(const struct HttpRequest *self) {
+    assert(self);
+    struct HttpRequest *mutableSelf = (struct HttpRequest *) self;
+    HttpRope_delete(mutableSelf->rope);
+    Text_delete(mutableSelf->body);
+    mutableSelf->rope = NULL;
+    mutableSelf->body = NULL;
+}
+
+const struct HttpRequest *HttpRequest_duplicateWithoutBody(const struct HttpRequest *self) {
+    assert(self);
+    const char *tag = Alligator_enterTag("HttpRequest");
+    struct HttpRequest *copy = Option_unwrap(Alligator_malloc(sizeof(*copy)));
+    *copy = *self;
+    copy->headers = NULL == self->headers ? NULL : Text_duplicate(self->headers);
+    copy->body = NULL;
+    copy->rope = NULL;
+    Alligator_exitTag(tag);
+    return copy;
+}
+
 void HttpRequest_delete(const struct HttpRequest *self) {
     if (self) {
+        HttpRope_delete(self->rope);
         Text_delete(self->body);
         Text_delete(self->headers);
         Alligator_free((void *) self);
@@ -95,13 +174,22 @@ struct HttpRequestBuilder {
 
 struct HttpRequestBuilder *HttpRequestBuilder_new(enum HttpMethod method, Atom url) {
     assert(url);
+    const char *tag = Alligator_enterTag("HttpRequest");
     struct HttpRequest *request = Option_unwrap(Alligator_malloc(sizeof(*request)));
     struct HttpRequestBuilder *self = Option_unwrap(Alligator_malloc(sizeof(*self)));
+    Alligator_exitTag(tag);
     request->url = url;
     request->headers = NULL;
     request->body = NULL;
-    request->timeout = 0;
+    request->rope = NULL;
+    request->connectTimeout = 0;
+    request->firstByteTimeout = 0;
+    request->totalTimeout = 0;
+    request->lowSpeedLimit = 0;
+    request->lowSpeedTime = 0;
+    request->bodyReleaseThreshold = HTTP_REQUEST_BODY_RELEASE_THRESHOLD;
     request->followLocation = true;
+    request->keepAlive = true;
     request->peerVerification = true;
     request->hostVerification = true;
     request->method = method;
@@ -165,13 +253,73 @@ Http_MaybeText HttpRequestBuilder_emplaceBody(struct HttpRequestBuilder *self, c
     return HttpRequestBuilder_setBody(self, &body);
 }
 
+struct HttpRope *HttpRequestBuilder_setRope(struct HttpRequestBuilder *self, struct HttpRope **ref) {
+    assert(self);
+    struct HttpRope *previousRope = self->request->rope;
+    if (NULL != ref) {
+        assert(*ref);
+        self->request->rope = *ref;
+        *ref = NULL;
+    }
+    return previousRope;
+}
+
 size_t HttpRequestBuilder_setTimeout(struct HttpRequestBuilder *self, size_t timeout) {
     assert(self);
-    const size_t previousTimeout = self->request->timeout;
-    self->request->timeout = timeout;
+    const size_t previousTimeout = HttpRequest_getTimeout(self->request);
+    self->request->totalTimeout = timeout * 1000;
+    return previousTimeout;
+}
+
+size_t HttpRequestBuilder_setConnectTimeout(struct HttpRequestBuilder *self, size_t milliseconds) {
+    assert(self);
+    const size_t previousTimeout = self->request->connectTimeout;
+    self->request->connectTimeout = milliseconds;
+    return previousTimeout;
+}
+
+size_t HttpRequestBuilder_setFirstByteTimeout(struct HttpRequestBuilder *self, size_t milliseconds) {
+    assert(self);
+    const size_t previousTimeout = self->request->firstByteTimeout;
+    self->request->firstByteTimeout = milliseconds;
     return previousTimeout;
 }
 
+size_t HttpRequestBuilder_setTotalTimeout(struct HttpRequestBuilder *self, size_t milliseconds) {
+    assert(self);
+    const size_t previousTimeout = self->request->totalTimeout;
+    self->request->totalTimeout = milliseconds;
+    return previousTimeout;
+}
+
+size_t HttpRequestBuilder_setLowSpeedLimit(struct HttpRequestBuilder *self, size_t bytesPerSecond) {
+    assert(self);
+    const size_t previousLimit = self->request->lowSpeedLimit;
+    self->request->lowSpeedLimit = bytesPerSecond;
+    return previousLimit;
+}
+
+size_t HttpRequestBuilder_setLowSpeedTime(struct HttpRequestBuilder *self, size_t milliseconds) {
+    assert(self);
+    const size_t previousTime = self->request->lowSpeedTime;
+    self->request->lowSpeedTime = milliseconds;
+    return previousTime;
+}
+
+size_t HttpRequestBuilder_setBodyReleaseThreshold(struct HttpRequestBuilder *self, size_t bytes) {
+    assert(self);
+    const size_t previousThreshold = self->request->bodyReleaseThreshold;
+    self->request->bodyReleaseThreshold = bytes;
+    return previousThreshold;
+}
+
+bool HttpRequestBuilder_setKeepAlive(struct HttpRequestBuilder *self, bool enable) {
+    assert(self);
+    const bool previousKeepAlive = self->request->keepAlive;
+    self->request->keepAlive = enable;
+    return previousKeepAlive;
+}
+
 bool HttpRequestBuilder_setFollowLocation(struct HttpRequestBuilder *self, bool enable) {
     assert(self);
     const bool previousFollowLocation = self->request->followLocation;
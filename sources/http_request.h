@@ -38,8 +38,16 @@
 extern "C" {
 #endif
 
+struct HttpRope;
 struct HttpRequest;
 
+/**
+ * Default body size from which request bodies are released as soon as they have been sent.
+ */
+#ifndef HTTP_REQUEST_BODY_RELEASE_THRESHOLD
+#define HTTP_REQUEST_BODY_RELEASE_THRESHOLD  (1024 * 1024)
+#endif
+
 /**
  * Returns the http method associated to this request.
  *
@@ -79,7 +87,17 @@ HttpRequest_getBody(const struct HttpRequest *self)
 __attribute__((__warn_unused_result__, __nonnull__));
 
 /**
- * Returns the timeout for this request.
+ * Returns the rope body associated to this request if any else NULL.
+ * Note: The current request is the owner of the rope, therefore it must be considered read-only.
+ *
+ * @attention self must not be NULL.
+ */
+extern const struct HttpRope *
+HttpRequest_getRope(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the total timeout in seconds for this request, rounded up so that only 0 means no timeout.
  *
  * @attention self must not be NULL.
  */
@@ -87,6 +105,69 @@ extern size_t
 HttpRequest_getTimeout(const struct HttpRequest *self)
 __attribute__((__warn_unused_result__, __nonnull__));
 
+/**
+ * Returns the connect timeout in milliseconds for this request, 0 means the libcurl default.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRequest_getConnectTimeout(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the time to first byte timeout in milliseconds for this request, 0 means no timeout.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRequest_getFirstByteTimeout(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the total timeout in milliseconds for this request, 0 means no timeout.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRequest_getTotalTimeout(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the low speed limit in bytes per second for this request, 0 means no limit.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRequest_getLowSpeedLimit(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the window in milliseconds over which the low speed limit is evaluated for this request.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRequest_getLowSpeedTime(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the body size from which the body of this request is released once it has been sent.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRequest_getBodyReleaseThreshold(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns true if the connection used by this request may be reused by later requests else false.
+ *
+ * @attention self must not be NULL.
+ */
+extern bool
+HttpRequest_getKeepAlive(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
 /**
  * Returns true if follow location is enabled for this request else false.
  *
@@ -114,6 +195,35 @@ extern bool
 HttpRequest_getHostVerification(const struct HttpRequest *self)
 __attribute__((__warn_unused_result__, __nonnull__));
 
+/**
+ * Returns the bytes of memory retained by this request: the request itself, its headers and its body.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRequest_getMemoryUsage(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Frees the body (and the rope, if any) of this request, which reads as empty from now on.
+ * Method, url, headers and settings stay available, this is meant for requests kept alive by their responses.
+ *
+ * @attention self must not be NULL.
+ * @attention the request must not be in use by other threads.
+ */
+extern void
+HttpRequest_releaseBody(const struct HttpRequest *self)
+__attribute__((__nonnull__));
+
+/**
+ * Creates a copy of this request without its body nor its rope: method, url, headers and settings are copied.
+ *
+ * @attention self must not be NULL.
+ */
+extern const struct HttpRequest *
+HttpRequest_duplicateWithoutBody(const struct HttpRequest *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
 /**
  * Sends the http request to the server waiting for response.
  *
@@ -225,7 +335,22 @@ HttpRequestBuilder_emplaceBody(struct HttpRequestBuilder *self, const char *form
 __attribute__((__nonnull__(1, 2), __format__(printf, 2, 3)));
 
 /**
- * Sets the timeout for the request stored into this builder.
+ * Sets a rope as body for the request stored into this builder.
+ * Note: When a rope is set it is sent in place of the body, streaming its segments without flattening them.
+ *
+ * @attention self must not be NULL.
+ * @attention the user is responsible to free the replaced rope (if any).
+ * @attention this function moves the ownership of the rope to this builder invalidating every previous reference.
+ *
+ * @return The previous rope stored into this builder if any else NULL.
+ */
+extern struct HttpRope *
+HttpRequestBuilder_setRope(struct HttpRequestBuilder *self, struct HttpRope **ref)
+__attribute__((__nonnull__(1)));
+
+/**
+ * Sets the total timeout in seconds for the request stored into this builder.
+ * Note: This is a shorthand for HttpRequestBuilder_setTotalTimeout(self, timeout * 1000).
  *
  * @attention self must not be NULL.
  *
@@ -235,6 +360,95 @@ extern size_t
 HttpRequestBuilder_setTimeout(struct HttpRequestBuilder *self, size_t timeout)
 __attribute__((__nonnull__));
 
+/**
+ * Sets the maximum time in milliseconds allowed to establish the connection, 0 means the libcurl default.
+ * Exceeding it makes the request fail with HttpError_ConnectionTimedOut.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous timeout stored into this builder.
+ */
+extern size_t
+HttpRequestBuilder_setConnectTimeout(struct HttpRequestBuilder *self, size_t milliseconds)
+__attribute__((__nonnull__));
+
+/**
+ * Sets the maximum time in milliseconds allowed between the start of the request and the first byte of the
+ * response, 0 means no timeout.
+ * Exceeding it makes the request fail with HttpError_FirstByteTimedOut.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous timeout stored into this builder.
+ */
+extern size_t
+HttpRequestBuilder_setFirstByteTimeout(struct HttpRequestBuilder *self, size_t milliseconds)
+__attribute__((__nonnull__));
+
+/**
+ * Sets the maximum time in milliseconds allowed for the whole request, 0 means no timeout.
+ * Exceeding it after the connection has been established makes the request fail with HttpError_TransferTimedOut.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous timeout stored into this builder.
+ */
+extern size_t
+HttpRequestBuilder_setTotalTimeout(struct HttpRequestBuilder *self, size_t milliseconds)
+__attribute__((__nonnull__));
+
+/**
+ * Sets the minimum transfer speed in bytes per second, 0 means no limit.
+ * A transfer slower than this limit for a whole low speed time window is aborted with HttpError_TransferStalled.
+ * Windows run while the request body is being sent, from its first byte, and once the first byte of the response
+ * has been received; the wait for the response in between is bounded by the first byte timeout instead.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous limit stored into this builder.
+ */
+extern size_t
+HttpRequestBuilder_setLowSpeedLimit(struct HttpRequestBuilder *self, size_t bytesPerSecond)
+__attribute__((__nonnull__));
+
+/**
+ * Sets the window in milliseconds over which the low speed limit is evaluated.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous window stored into this builder.
+ */
+extern size_t
+HttpRequestBuilder_setLowSpeedTime(struct HttpRequestBuilder *self, size_t milliseconds)
+__attribute__((__nonnull__));
+
+/**
+ * Sets the body size from which HttpRequest_fire releases the body (or the rope) of the request stored into this
+ * builder as soon as the request has been performed successfully, so that it does not stay alive with the response.
+ * Method, url and headers stay available through HttpResponse_getRequest, the body reads as empty.
+ * Defaults to HTTP_REQUEST_BODY_RELEASE_THRESHOLD, 0 always releases the body, SIZE_MAX never does.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous value stored into this builder.
+ */
+extern size_t
+HttpRequestBuilder_setBodyReleaseThreshold(struct HttpRequestBuilder *self, size_t bytes)
+__attribute__((__nonnull__));
+
+/**
+ * Enables or disables keep-alive for the request stored into this builder, enabled by default.
+ * Connections are kept alive by the thread that fired the request: when disabled the request opens a new connection
+ * and closes it once done.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous value stored into this builder.
+ */
+extern bool
+HttpRequestBuilder_setKeepAlive(struct HttpRequestBuilder *self, bool enable)
+__attribute__((__nonnull__));
+
 /**
  * Enables or disables follow location for the request stored into this builder.
  *
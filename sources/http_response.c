@@ -28,6 +28,7 @@
 
 #include <http.h>
 #include <assert.h>
+#include <string.h>
 #include <alligator/alligator.h>
 
 struct HttpResponse {
@@ -35,9 +36,29 @@ struct HttpResponse {
     Atom url;
     Text headers;
     Text body;
+    const struct HttpSharedText *bodyOwner;
+    struct HttpSharedText sharedBody;
+    struct HttpTimings timings;
+    size_t storageSize;
     enum HttpStatus status;
+    bool compact;
 };
 
+static bool isBodyInline(const struct HttpResponse *self) {
+    return self->compact && NULL == self->bodyOwner;
+}
+
+static void deleteResponseStorage(void *memory) {
+    assert(memory);
+    struct HttpResponse *self = memory;
+    if (NULL != self->bodyOwner) {
+        HttpSharedText_release(self->bodyOwner);
+    } else if (!self->compact) {
+        Text_delete(self->body);
+    }
+    Alligator_free(self);
+}
+
 const struct HttpRequest *HttpResponse_getRequest(const struct HttpResponse *self) {
     assert(self);
     return self->request;
@@ -58,17 +79,106 @@ TextView HttpResponse_getBody(const struct HttpResponse *self) {
     return NULL == self->body ? Http_getEmptyString() : self->body;
 }
 
+const struct HttpSharedText *HttpResponse_shareBody(const struct HttpResponse *self) {
+    assert(self);
+    return HttpSharedText_retain(&self->sharedBody);
+}
+
 enum HttpStatus HttpResponse_getStatus(const struct HttpResponse *self) {
     assert(self);
     return self->status;
 }
 
+struct HttpTimings HttpResponse_getTimings(const struct HttpResponse *self) {
+    assert(self);
+    return self->timings;
+}
+
+static size_t textMemoryUsage(TextView text) {
+    return NULL == text ? 0 : Text_overhead() + Text_capacity(text) + 1;
+}
+
+size_t HttpResponse_getMemoryUsage(const struct HttpResponse *self) {
+    assert(self);
+    return self->storageSize +
+           (self->compact ? 0 : textMemoryUsage(self->headers)) +
+           (isBodyInline(self) ? 0 : textMemoryUsage(self->body)) +
+           HttpRequest_getMemoryUsage(self->request);
+}
+
+static size_t alignToPointer(const size_t size) {
+    return (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+}
+
+static Text placeText(char *memory, TextView text) {
+    assert(memory);
+    assert(text);
+    const size_t length = Text_length(text);
+    Text self = Text_inPlace(memory, Text_overhead() + length + 1);
+    memcpy(self, text, length);
+    Text_setLength(self, length);
+    self[length] = 0;
+    return self;
+}
+
+const struct HttpResponse *HttpResponse_compact(const struct HttpResponse **ref, const bool dropRequestBody) {
+    assert(ref);
+    assert(*ref);
+    struct HttpResponse *self = (struct HttpResponse *) *ref;
+    TextView headers = HttpResponse_getHeaders(self);
+    TextView body = HttpResponse_getBody(self);
+    const size_t headersSize = alignToPointer(Text_overhead() + Text_length(headers) + 1);
+    const size_t bodySize = NULL == self->bodyOwner ? Text_overhead() + Text_length(body) + 1 : 0;
+    const size_t storageSize = sizeof(struct HttpResponse) + headersSize + bodySize;
+
+    const char *tag = Alligator_enterTag("HttpResponse");
+    struct HttpResponse *compacted = Option_unwrap(Alligator_malloc(storageSize));
+    Alligator_exitTag(tag);
+    char *storage = (char *) (compacted + 1);
+    compacted->request = self->request;
+    compacted->url = self->url;
+    compacted->headers = placeText(storage, headers);
+    if (NULL == self->bodyOwner) {
+        compacted->body = placeText(storage + headersSize, body);
+        compacted->bodyOwner = NULL;
+    } else {
+        compacted->body = self->body;
+        compacted->bodyOwner = HttpSharedText_retain(self->bodyOwner);
+    }
+    compacted->timings = self->timings;
+    compacted->storageSize = storageSize;
+    compacted->status = self->status;
+    compacted->compact = true;
+    HttpSharedText_initialize(&compacted->sharedBody, compacted->body, compacted, deleteResponseStorage);
+
+    if (dropRequestBody) {
+        HttpRequest_releaseBody(compacted->request);
+    }
+    self->request = NULL;
+    HttpResponse_delete(self);
+    *ref = NULL;
+    return compacted;
+}
+
+const struct HttpRequest *HttpResponse_takeRequest(const struct HttpResponse **ref) {
+    assert(ref);
+    assert(*ref);
+    struct HttpResponse *self = (struct HttpResponse *) *ref;
+    const struct HttpRequest *request = self->request;
+    self->request = NULL;
+    HttpResponse_delete(self);
+    *ref = NULL;
+    return request;
+}
+
 void HttpResponse_delete(const struct HttpResponse *self) {
     if (self) {
+        // the body and this storage outlive the response as long as the body is shared
         HttpRequest_delete(self->request);
-        Text_delete(self->body);
-        Text_delete(self->headers);
-        Alligator_free((void *) self);
+        if (!self->compact) {
+            Text_delete(self->headers);
+        }
+        HttpSharedText_release(&self->sharedBody);
     }
 }
 
@@ -79,13 +189,20 @@ struct HttpResponseBuilder {
 struct HttpResponseBuilder *HttpResponseBuilder_new(const struct HttpRequest **ref) {
     assert(ref);
     assert(*ref);
+    const char *tag = Alligator_enterTag("HttpResponse");
     struct HttpResponse *response = Option_unwrap(Alligator_malloc(sizeof(*response)));
     struct HttpResponseBuilder *self = Option_unwrap(Alligator_malloc(sizeof(*self)));
+    Alligator_exitTag(tag);
     response->request = *ref;
     response->url = HttpRequest_getUrl(*ref);
     response->headers = NULL;
     response->body = NULL;
+    response->bodyOwner = NULL;
+    response->timings = (struct HttpTimings) {0};
+    response->storageSize = sizeof(*response);
+    response->compact = false;
     response->status = HTTP_STATUS_OK;
+    HttpSharedText_initialize(&response->sharedBody, Http_getEmptyString(), response, deleteResponseStorage);
     self->response = response;
     *ref = NULL;
     return self;
@@ -126,14 +243,39 @@ Http_MaybeText HttpResponseBuilder_emplaceHeaders(struct HttpResponseBuilder *se
     return HttpResponseBuilder_setHeaders(self, &headers);
 }
 
+static Text releaseBody(struct HttpResponse *response) {
+    assert(response);
+    Text previousBody = response->body;
+    if (NULL != response->bodyOwner) {
+        HttpSharedText_release(response->bodyOwner);
+        response->bodyOwner = NULL;
+        previousBody = NULL;
+    }
+    response->body = NULL;
+    return previousBody;
+}
+
 Http_MaybeText HttpResponseBuilder_setBody(struct HttpResponseBuilder *self, Text *ref) {
     assert(self);
-    Text previousBody = self->response->body;
-    if (NULL != ref) {
-        assert(*ref);
-        self->response->body = *ref;
-        *ref = NULL;
+    if (NULL == ref) {
+        return Http_MaybeText_new(NULL == self->response->bodyOwner ? self->response->body : NULL);
     }
+    assert(*ref);
+    Text previousBody = releaseBody(self->response);
+    self->response->body = *ref;
+    *ref = NULL;
+    return Http_MaybeText_new(previousBody);
+}
+
+Http_MaybeText HttpResponseBuilder_setSharedBody(struct HttpResponseBuilder *self,
+                                                 const struct HttpSharedText *body) {
+    assert(self);
+    assert(body);
+    // retain first: body may be the one being replaced
+    body = HttpSharedText_retain(body);
+    Text previousBody = releaseBody(self->response);
+    self->response->bodyOwner = body;
+    self->response->body = (Text) HttpSharedText_get(body);
     return Http_MaybeText_new(previousBody);
 }
 
@@ -147,10 +289,18 @@ Http_MaybeText HttpResponseBuilder_emplaceBody(struct HttpResponseBuilder *self,
     return HttpResponseBuilder_setBody(self, &body);
 }
 
+struct HttpTimings HttpResponseBuilder_setTimings(struct HttpResponseBuilder *self, struct HttpTimings timings) {
+    assert(self);
+    const struct HttpTimings previousTimings = self->response->timings;
+    self->response->timings = timings;
+    return previousTimings;
+}
+
 const struct HttpResponse *HttpResponseBuilder_build(struct HttpResponseBuilder **ref) {
     assert(ref);
     assert(*ref);
-    const struct HttpResponse *response = (*ref)->response;
+    struct HttpResponse *response = (*ref)->response;
+    HttpSharedText_initialize(&response->sharedBody, HttpResponse_getBody(response), response, deleteResponseStorage);
     Alligator_free(*ref);
     *ref = NULL;
     return response;
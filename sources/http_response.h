@@ -38,6 +38,7 @@
 extern "C" {
 #endif
 
+struct HttpSharedText;
 struct HttpResponse;
 
 /**
@@ -79,6 +80,18 @@ extern TextView
 HttpResponse_getBody(const struct HttpResponse *self)
 __attribute__((__warn_unused_result__, __nonnull__));
 
+/**
+ * Shares the body associated to this response without copying it.
+ * Note: The body is immutable and stays alive, even after this response has been deleted, until the returned
+ * reference is released; references can be retained and released from any thread.
+ *
+ * @attention self must not be NULL.
+ * @attention the user is responsible to release the returned reference.
+ */
+extern const struct HttpSharedText *
+HttpResponse_shareBody(const struct HttpResponse *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
 /**
  * Returns the http status code associated to this response.
  *
@@ -88,6 +101,55 @@ extern enum HttpStatus
 HttpResponse_getStatus(const struct HttpResponse *self)
 __attribute__((__warn_unused_result__, __nonnull__));
 
+/**
+ * Returns the per-phase timing breakdown of the transfer that produced this response.
+ *
+ * @attention self must not be NULL.
+ */
+extern struct HttpTimings
+HttpResponse_getTimings(const struct HttpResponse *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the bytes of memory retained by this response: the response itself, its headers, its body and the request
+ * that generated it. Bodies shared with other owners are accounted in full.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpResponse_getMemoryUsage(const struct HttpResponse *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Packs status, url, timings, headers and body of a response into a single allocation of the exact size,
+ * meant for responses retained for a long time. Bodies placed in memory mappings are shared, not copied.
+ *
+ * @attention ref must not be NULL.
+ * @attention *ref must not be NULL.
+ * @attention this function moves the ownership of the response to the compacted one invalidating every previous
+ * reference, references returned by HttpResponse_shareBody stay valid.
+ *
+ * @param dropRequestBody Whether the body of the request that generated the response is released too.
+ * @return The compacted response.
+ */
+extern const struct HttpResponse *
+HttpResponse_compact(const struct HttpResponse **ref, bool dropRequestBody)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Deletes a response handing back the request that generated it instead of deleting it too.
+ *
+ * @attention ref must not be NULL.
+ * @attention *ref must not be NULL.
+ * @attention this function deletes the response and sets *ref to NULL, references returned by HttpResponse_shareBody
+ * stay valid.
+ *
+ * @return The request that generated the response.
+ */
+extern const struct HttpRequest *
+HttpResponse_takeRequest(const struct HttpResponse **ref)
+__attribute__((__warn_unused_result__, __nonnull__));
+
 /**
  * Deletes this response freeing memory.
  * Note: If self is NULL no action will be performed.
@@ -169,7 +231,7 @@ __attribute__((__nonnull__(1, 2), __format__(printf, 2, 3)));
  * @attention the user is responsible to free the replaced body (if any).
  * @attention this function moves the ownership of the body to this builder invalidating every previous reference.
  *
- * @return The previous body stored into this builder.
+ * @return The previous body stored into this builder, nothing if it was a shared body (which is released).
  */
 extern Http_MaybeText
 HttpResponseBuilder_setBody(struct HttpResponseBuilder *self, Text *ref)
@@ -188,6 +250,31 @@ extern Http_MaybeText
 HttpResponseBuilder_emplaceBody(struct HttpResponseBuilder *self, const char *format, ...)
 __attribute__((__nonnull__(1, 2), __format__(printf, 2, 3)));
 
+/**
+ * Sets a shared text as the body for the response stored into this builder, acquiring a new reference to it
+ * that is released once the response and every reference returned by HttpResponse_shareBody are released.
+ *
+ * @attention self must not be NULL.
+ * @attention body must not be NULL.
+ * @attention the user is responsible to free the replaced body (if any).
+ *
+ * @return The previous body stored into this builder, nothing if it was a shared body (which is released).
+ */
+extern Http_MaybeText
+HttpResponseBuilder_setSharedBody(struct HttpResponseBuilder *self, const struct HttpSharedText *body)
+__attribute__((__nonnull__));
+
+/**
+ * Sets the timings for the response stored into this builder.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return The previous timings stored into this builder.
+ */
+extern struct HttpTimings
+HttpResponseBuilder_setTimings(struct HttpResponseBuilder *self, struct HttpTimings timings)
+__attribute__((__nonnull__));
+
 /**
  * Constructs the http response and deletes this builder freeing memory.
  *
@@ -0,0 +1,214 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <panic/panic.h>
+#include <alligator/alligator.h>
+
+struct HttpRope_Segment {
+    struct HttpRope_Segment *next;
+    size_t length;
+    char bytes[];
+};
+
+struct HttpRope {
+    struct HttpRope_Segment *head;
+    struct HttpRope_Segment *tail;
+    size_t segmentSize;
+    size_t length;
+};
+
+static struct HttpRope_Segment *HttpRope_grow(struct HttpRope *self) {
+    assert(self);
+    struct HttpRope_Segment *segment = Option_unwrap(Alligator_malloc(sizeof(*segment) + self->segmentSize));
+    segment->next = NULL;
+    segment->length = 0;
+    if (NULL == self->tail) {
+        self->head = segment;
+    } else {
+        self->tail->next = segment;
+    }
+    self->tail = segment;
+    return segment;
+}
+
+static size_t HttpRope_available(const struct HttpRope *self) {
+    assert(self);
+    return NULL == self->tail ? 0 : self->segmentSize - self->tail->length;
+}
+
+struct HttpRope *HttpRope_new(void) {
+    return HttpRope_withSegmentSize(HTTP_ROPE_DEFAULT_SEGMENT_SIZE);
+}
+
+struct HttpRope *HttpRope_withSegmentSize(const size_t segmentSize) {
+    assert(segmentSize > 0);
+    struct HttpRope *self = Option_unwrap(Alligator_malloc(sizeof(*self)));
+    self->head = NULL;
+    self->tail = NULL;
+    self->segmentSize = segmentSize;
+    self->length = 0;
+    return self;
+}
+
+void HttpRope_append(struct HttpRope *self, const TextView other) {
+    assert(self);
+    assert(other);
+    HttpRope_appendBytes(self, other, Text_length(other));
+}
+
+void HttpRope_appendFormat(struct HttpRope *self, const char *format, ...) {
+    assert(self);
+    assert(format);
+    va_list args;
+    va_start(args, format);
+    HttpRope_vAppendFormat(self, format, args);
+    va_end(args);
+}
+
+void HttpRope_vAppendFormat(struct HttpRope *self, const char *format, va_list args) {
+    assert(self);
+    assert(format);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    const int formattedSize = vsnprintf(NULL, 0, format, argsCopy);
+    va_end(argsCopy);
+
+    if (formattedSize < 0) {
+        Panic_terminate("Unable to format string\n");
+    }
+
+    const size_t size = (size_t) formattedSize;
+    if (0 == size) {
+        return;
+    }
+    if (size < self->segmentSize) {
+        // vsnprintf needs room for the terminator, the rope does not store it
+        struct HttpRope_Segment *segment = HttpRope_available(self) > size ? self->tail : HttpRope_grow(self);
+        vsnprintf(segment->bytes + segment->length, size + 1, format, args);
+        segment->length += size;
+        self->length += size;
+    } else {
+        Text text = Text_vFormat(format, args);
+        HttpRope_appendBytes(self, text, Text_length(text));
+        Text_delete(text);
+    }
+}
+
+void HttpRope_appendBytes(struct HttpRope *self, const void *bytes, size_t size) {
+    assert(self);
+    assert(bytes);
+    const char *cursor = bytes;
+    while (size > 0) {
+        size_t available = HttpRope_available(self);
+        if (0 == available) {
+            HttpRope_grow(self);
+            available = self->segmentSize;
+        }
+        const size_t chunk = size < available ? size : available;
+        struct HttpRope_Segment *segment = self->tail;
+        memcpy(segment->bytes + segment->length, cursor, chunk);
+        segment->length += chunk;
+        self->length += chunk;
+        cursor += chunk;
+        size -= chunk;
+    }
+}
+
+void HttpRope_appendLiteral(struct HttpRope *self, const char *literal) {
+    assert(self);
+    assert(literal);
+    HttpRope_appendBytes(self, literal, strlen(literal));
+}
+
+size_t HttpRope_length(const struct HttpRope *self) {
+    assert(self);
+    return self->length;
+}
+
+HttpRope_Cursor HttpRope_begin(const struct HttpRope *self) {
+    assert(self);
+    return (HttpRope_Cursor) {.__segment=self->head, .__offset=0, .__position=0};
+}
+
+bool HttpRope_seek(const struct HttpRope *self, HttpRope_Cursor *cursor, size_t position) {
+    assert(self);
+    assert(cursor);
+    if (position > self->length) {
+        return false;
+    }
+    const struct HttpRope_Segment *segment = self->head;
+    cursor->__position = position;
+    while (NULL != segment && position >= segment->length && NULL != segment->next) {
+        position -= segment->length;
+        segment = segment->next;
+    }
+    cursor->__segment = segment;
+    cursor->__offset = position;
+    return true;
+}
+
+size_t HttpRope_read(const struct HttpRope *self, HttpRope_Cursor *cursor, void *buffer, const size_t size) {
+    assert(self);
+    assert(cursor);
+    assert(buffer);
+    (void) self;
+    char *destination = buffer;
+    size_t copied = 0;
+    const struct HttpRope_Segment *segment = cursor->__segment;
+    while (NULL != segment && copied < size) {
+        const size_t available = segment->length - cursor->__offset;
+        if (0 == available) {
+            segment = segment->next;
+            cursor->__segment = segment;
+            cursor->__offset = 0;
+            continue;
+        }
+        const size_t chunk = size - copied < available ? size - copied : available;
+        memcpy(destination + copied, segment->bytes + cursor->__offset, chunk);
+        cursor->__offset += chunk;
+        cursor->__position += chunk;
+        copied += chunk;
+    }
+    return copied;
+}
+
+void HttpRope_delete(const struct HttpRope *self) {
+    if (self) {
+        struct HttpRope_Segment *segment = self->head;
+        while (NULL != segment) {
+            struct HttpRope_Segment *next = segment->next;
+            Alligator_free(segment);
+            segment = next;
+        }
+        Alligator_free((void *) self);
+    }
+}
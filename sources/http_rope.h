@@ -0,0 +1,184 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <http.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Default size of the segments of a rope.
+ */
+#define HTTP_ROPE_DEFAULT_SEGMENT_SIZE  (64UL * 1024UL)
+
+/**
+ * A segmented text builder meant for large request bodies.
+ *
+ * Content is appended into fixed-size segments: appending never moves bytes already written, and the rope is never
+ * flattened into a single buffer, it is streamed segment by segment when the request is sent.
+ */
+struct HttpRope;
+
+/**
+ * A read position inside a rope.
+ *
+ * @attention This type must be treated as opaque therefore its members should never be accessed directly.
+ */
+typedef struct __HttpRope_Cursor {
+    const void *__segment;
+    size_t __offset;
+    size_t __position;
+} HttpRope_Cursor;
+
+/**
+ * Creates a new rope using the default segment size.
+ */
+extern struct HttpRope *
+HttpRope_new(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Creates a new rope whose segments are segmentSize bytes long.
+ *
+ * @attention segmentSize must be greater than 0.
+ */
+extern struct HttpRope *
+HttpRope_withSegmentSize(size_t segmentSize)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Appends text to this rope.
+ *
+ * @attention self must not be NULL.
+ * @attention other must not be NULL.
+ */
+extern void
+HttpRope_append(struct HttpRope *self, TextView other)
+__attribute__((__nonnull__));
+
+/**
+ * Appends the formatted content to this rope.
+ *
+ * @attention self must not be NULL.
+ * @attention format must not be NULL.
+ */
+extern void
+HttpRope_appendFormat(struct HttpRope *self, const char *format, ...)
+__attribute__((__nonnull__(1, 2), __format__(printf, 2, 3)));
+
+/**
+ * Appends the formatted content to this rope.
+ * Behaves like HttpRope_appendFormat but takes a va_list.
+ *
+ * @attention self must not be NULL.
+ * @attention format must not be NULL.
+ */
+extern void
+HttpRope_vAppendFormat(struct HttpRope *self, const char *format, va_list args)
+__attribute__((__nonnull__, __format__(printf, 2, 0)));
+
+/**
+ * Appends the bytes array to this rope.
+ *
+ * @attention self must not be NULL.
+ * @attention bytes must not be NULL.
+ */
+extern void
+HttpRope_appendBytes(struct HttpRope *self, const void *bytes, size_t size)
+__attribute__((__nonnull__));
+
+/**
+ * Appends the literal to this rope.
+ *
+ * @attention self must not be NULL.
+ * @attention literal must not be NULL.
+ */
+extern void
+HttpRope_appendLiteral(struct HttpRope *self, const char *literal)
+__attribute__((__nonnull__));
+
+/**
+ * Returns the number of bytes stored into this rope.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+HttpRope_length(const struct HttpRope *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns a cursor pointing to the beginning of this rope.
+ *
+ * @attention self must not be NULL.
+ */
+extern HttpRope_Cursor
+HttpRope_begin(const struct HttpRope *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Moves the cursor to the given position.
+ *
+ * @attention self must not be NULL.
+ * @attention cursor must not be NULL.
+ *
+ * @return false if position is past the end of this rope (the cursor is left untouched), else true.
+ */
+extern bool
+HttpRope_seek(const struct HttpRope *self, HttpRope_Cursor *cursor, size_t position)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Copies up to size bytes starting at the cursor position into buffer, advancing the cursor.
+ *
+ * @attention self must not be NULL.
+ * @attention cursor must not be NULL.
+ * @attention buffer must not be NULL.
+ *
+ * @return The number of bytes copied, 0 when the end of this rope has been reached.
+ */
+extern size_t
+HttpRope_read(const struct HttpRope *self, HttpRope_Cursor *cursor, void *buffer, size_t size)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Deletes this rope freeing memory.
+ * Note: If self is NULL no action will be performed.
+ */
+extern void
+HttpRope_delete(const struct HttpRope *self);
+
+#ifdef __cplusplus
+}
+#endif
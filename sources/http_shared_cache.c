@@ -0,0 +1,442 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SEGMENT_MAGIC       UINT64_C(0x6874747073686d63)
+#define SEGMENT_VERSION     1U
+#define SLOT_VALID          1U
+#define SLOT_NO_CACHE       2U
+#define RECORD_ALIGNMENT    64U
+#define READ_ATTEMPTS       64
+#define ATTACH_ATTEMPTS     1000
+
+/*
+ * Slots are guarded by a sequence lock: a writer makes the sequence odd with a compare and swap, which also keeps
+ * other writers out, updates the fields and makes the sequence even again; readers copy the fields and start over if
+ * the sequence changed meanwhile. A process dying in between leaves its slot locked, it is skipped from then on.
+ */
+struct Slot {
+    uint32_t sequence;
+    uint32_t flags;
+    uint64_t key;
+    uint64_t variant;
+    uint64_t position;
+    uint64_t size;
+    int64_t responseTime;
+    int64_t initialAge;
+    int64_t lifetime;
+};
+
+/*
+ * Responses are appended to the ring by moving head forward and are never split across its end. Positions count the
+ * bytes appended since the segment has been created: the response at position is intact for as long as head does not
+ * exceed position + ringSize, writers move head before copying so that readers can check it after copying.
+ */
+struct Segment {
+    uint64_t magic;         // written last by the process creating the segment
+    uint32_t version;
+    uint32_t slotsLength;
+    uint64_t ringSize;
+    uint64_t head;
+    uint64_t stores;
+    uint64_t evictions;
+    struct Slot slots[HTTP_SHARED_CACHE_SLOTS];
+    unsigned char ring[] __attribute__((__aligned__(RECORD_ALIGNMENT)));
+};
+
+struct SharedCache {
+    pthread_rwlock_t lock;
+    struct Segment *segment;
+    size_t size;
+    bool open;
+};
+
+static struct SharedCache cache = {.lock=PTHREAD_RWLOCK_INITIALIZER, .segment=NULL, .size=0, .open=false};
+
+static bool readSlot(const struct Slot *slot, struct Slot *value) {
+    for (size_t i = 0; i < READ_ATTEMPTS; i++) {
+        const uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (0 != (sequence & 1U)) {
+            continue;
+        }
+        value->flags = __atomic_load_n(&slot->flags, __ATOMIC_RELAXED);
+        value->key = __atomic_load_n(&slot->key, __ATOMIC_RELAXED);
+        value->variant = __atomic_load_n(&slot->variant, __ATOMIC_RELAXED);
+        value->position = __atomic_load_n(&slot->position, __ATOMIC_RELAXED);
+        value->size = __atomic_load_n(&slot->size, __ATOMIC_RELAXED);
+        value->responseTime = __atomic_load_n(&slot->responseTime, __ATOMIC_RELAXED);
+        value->initialAge = __atomic_load_n(&slot->initialAge, __ATOMIC_RELAXED);
+        value->lifetime = __atomic_load_n(&slot->lifetime, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (sequence == __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED)) {
+            value->sequence = sequence;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Locks slot if its sequence is still the one it has been read with.
+static bool lockSlot(struct Slot *slot, uint32_t sequence) {
+    if (!__atomic_compare_exchange_n(&slot->sequence, &sequence, sequence + 1, false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        return false;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return true;
+}
+
+static void writeSlot(struct Slot *slot, const struct Slot *value) {
+    __atomic_store_n(&slot->flags, value->flags, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->key, value->key, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->variant, value->variant, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->position, value->position, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->size, value->size, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->responseTime, value->responseTime, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->initialAge, value->initialAge, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->lifetime, value->lifetime, __ATOMIC_RELAXED);
+}
+
+static void unlockSlot(struct Slot *slot, const uint32_t sequence) {
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+static bool isIntact(struct Segment *segment, const uint64_t position) {
+    return __atomic_load_n(&segment->head, __ATOMIC_ACQUIRE) <= position + segment->ringSize;
+}
+
+static bool isLive(struct Segment *segment, const struct Slot *value) {
+    return 0 != (value->flags & SLOT_VALID) && isIntact(segment, value->position);
+}
+
+static struct HttpCacheFreshness freshnessOf(const struct Slot *value) {
+    return (struct HttpCacheFreshness) {
+            .responseTime=value->responseTime, .initialAge=value->initialAge, .lifetime=value->lifetime,
+            .noCache=0 != (value->flags & SLOT_NO_CACHE)
+    };
+}
+
+// Reserves size bytes at the end of the ring, skipping its tail if they do not fit before wrapping around.
+static uint64_t reserve(struct Segment *segment, const uint64_t size) {
+    uint64_t head = __atomic_load_n(&segment->head, __ATOMIC_RELAXED);
+    uint64_t position;
+    do {
+        const uint64_t offset = head % segment->ringSize;
+        position = offset + size > segment->ringSize ? head + segment->ringSize - offset : head;
+    } while (!__atomic_compare_exchange_n(&segment->head, &head, position + size, false, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    // readers must see head moved before any byte of the response being overwritten
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return position;
+}
+
+// Publishes value in the slot of the same response if any, else in a free slot, else in the one holding the oldest.
+static bool publish(struct Segment *segment, const struct Slot *value) {
+    for (size_t attempt = 0; attempt < HTTP_SHARED_CACHE_PROBES; attempt++) {
+        struct Slot *target = NULL;
+        struct Slot current = {0};
+        for (size_t i = 0; i < HTTP_SHARED_CACHE_PROBES; i++) {
+            struct Slot *slot = &segment->slots[(value->key + i) % HTTP_SHARED_CACHE_SLOTS];
+            struct Slot candidate;
+            if (!readSlot(slot, &candidate)) {
+                continue;
+            }
+            const bool live = isLive(segment, &candidate);
+            if (live && candidate.key == value->key && candidate.variant == value->variant) {
+                target = slot;
+                current = candidate;
+                break;
+            }
+            if (NULL == target ||
+                (isLive(segment, &current) && (!live || candidate.position < current.position))) {
+                target = slot;
+                current = candidate;
+            }
+        }
+        if (NULL == target) {
+            return false;
+        }
+        if (lockSlot(target, current.sequence)) {
+            if (isLive(segment, &current) && (current.key != value->key || current.variant != value->variant)) {
+                __atomic_add_fetch(&segment->evictions, 1, __ATOMIC_RELAXED);
+            }
+            writeSlot(target, value);
+            unlockSlot(target, current.sequence);
+            __atomic_add_fetch(&segment->stores, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Copies a response out of the ring, NULL if it has been overwritten meanwhile.
+static void *copyOf(struct Segment *segment, const struct Slot *value) {
+    const uint64_t offset = value->position % segment->ringSize;
+    if (0 == value->size || value->size > segment->ringSize - offset) {
+        return NULL;
+    }
+    void *copy = mmap(NULL, value->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == copy) {
+        return NULL;
+    }
+    memcpy(copy, segment->ring + offset, value->size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (!isIntact(segment, value->position)) {
+        munmap(copy, value->size);
+        return NULL;
+    }
+    return copy;
+}
+
+static struct Segment *mapSegment(const int fd, const size_t size) {
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | (fd < 0 ? MAP_ANONYMOUS : 0), fd, 0);
+    return MAP_FAILED == base ? NULL : base;
+}
+
+static void initializeSegment(struct Segment *segment, const size_t size) {
+    segment->version = SEGMENT_VERSION;
+    segment->slotsLength = HTTP_SHARED_CACHE_SLOTS;
+    segment->ringSize = size - offsetof(struct Segment, ring);
+    __atomic_store_n(&segment->magic, SEGMENT_MAGIC, __ATOMIC_RELEASE);
+}
+
+static void backOff(void) {
+    const struct timespec delay = {.tv_sec=0, .tv_nsec=1000000};
+    nanosleep(&delay, NULL);
+}
+
+// Maps a segment created by another process, waiting for it to be initialized.
+static struct Segment *attachSegment(const int fd, const size_t size) {
+    struct stat status;
+    struct Segment *segment = NULL;
+    for (size_t i = 0; NULL == segment && i < ATTACH_ATTEMPTS; i++) {
+        if (0 != fstat(fd, &status) || (0 != status.st_size && size != (size_t) status.st_size)) {
+            return NULL;
+        }
+        if (0 == status.st_size) {
+            backOff();
+        } else if (NULL == (segment = mapSegment(fd, size))) {
+            return NULL;
+        }
+    }
+    for (size_t i = 0; NULL != segment && i < ATTACH_ATTEMPTS; i++) {
+        if (SEGMENT_MAGIC == __atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE)) {
+            if (SEGMENT_VERSION == segment->version && HTTP_SHARED_CACHE_SLOTS == segment->slotsLength &&
+                size - offsetof(struct Segment, ring) == segment->ringSize) {
+                return segment;
+            }
+            break;
+        }
+        backOff();
+    }
+    if (NULL != segment) {
+        munmap(segment, size);
+    }
+    return NULL;
+}
+
+static struct Segment *openSegment(const char *name, const size_t size) {
+    if (NULL == name) {
+        struct Segment *segment = mapSegment(-1, size);
+        if (NULL != segment) {
+            initializeSegment(segment, size);
+        }
+        return segment;
+    }
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        struct Segment *segment = 0 == ftruncate(fd, (off_t) size) ? mapSegment(fd, size) : NULL;
+        close(fd);
+        if (NULL == segment) {
+            shm_unlink(name);
+            return NULL;
+        }
+        initializeSegment(segment, size);
+        return segment;
+    }
+    if (EEXIST != errno || (fd = shm_open(name, O_RDWR, 0600)) < 0) {
+        return NULL;
+    }
+    struct Segment *segment = attachSegment(fd, size);
+    close(fd);
+    return segment;
+}
+
+bool Http_openSharedCache(const char *name, const size_t capacity) {
+    Http_closeSharedCache();
+    if (capacity < RECORD_ALIGNMENT || capacity > SIZE_MAX / 2) {
+        return false;
+    }
+    const size_t size = offsetof(struct Segment, ring) + capacity / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+    struct Segment *segment = openSegment(name, size);
+    if (NULL == segment) {
+        return false;
+    }
+    pthread_rwlock_wrlock(&cache.lock);
+    cache.segment = segment;
+    cache.size = size;
+    __atomic_store_n(&cache.open, true, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&cache.lock);
+    return true;
+}
+
+void Http_closeSharedCache(void) {
+    pthread_rwlock_wrlock(&cache.lock);
+    if (cache.open) {
+        __atomic_store_n(&cache.open, false, __ATOMIC_RELEASE);
+        munmap(cache.segment, cache.size);
+        cache.segment = NULL;
+        cache.size = 0;
+    }
+    pthread_rwlock_unlock(&cache.lock);
+}
+
+bool Http_unlinkSharedCache(const char *name) {
+    assert(name);
+    return 0 == shm_unlink(name);
+}
+
+bool Http_isSharedCacheOpen(void) {
+    return __atomic_load_n(&cache.open, __ATOMIC_ACQUIRE);
+}
+
+struct HttpSharedCacheStats Http_getSharedCacheStats(void) {
+    struct HttpSharedCacheStats stats = {0};
+    pthread_rwlock_rdlock(&cache.lock);
+    if (cache.open) {
+        struct Segment *segment = cache.segment;
+        stats.stores = (size_t) __atomic_load_n(&segment->stores, __ATOMIC_RELAXED);
+        stats.evictions = (size_t) __atomic_load_n(&segment->evictions, __ATOMIC_RELAXED);
+        for (size_t i = 0; i < HTTP_SHARED_CACHE_SLOTS; i++) {
+            struct Slot value;
+            if (readSlot(&segment->slots[i], &value) && isLive(segment, &value)) {
+                stats.entries++;
+                stats.bytes += (size_t) value.size;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&cache.lock);
+    return stats;
+}
+
+bool HttpSharedCache_store(const uint64_t key, const uint64_t variant, const struct HttpCacheFreshness freshness,
+                           const struct iovec *parts, const size_t partsLength) {
+    assert(parts);
+    size_t size = 0;
+    for (size_t i = 0; i < partsLength; i++) {
+        size += parts[i].iov_len;
+    }
+
+    pthread_rwlock_rdlock(&cache.lock);
+    struct Segment *segment = cache.segment;
+    if (!cache.open || 0 == size || size > segment->ringSize / 4) {
+        pthread_rwlock_unlock(&cache.lock);
+        return false;
+    }
+    const uint64_t position = reserve(segment, (size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT);
+    unsigned char *cursor = segment->ring + position % segment->ringSize;
+    for (size_t i = 0; i < partsLength; i++) {
+        memcpy(cursor, parts[i].iov_base, parts[i].iov_len);
+        cursor += parts[i].iov_len;
+    }
+    const bool stored = publish(segment, &(struct Slot) {
+            .flags=SLOT_VALID | (freshness.noCache ? SLOT_NO_CACHE : 0), .key=key, .variant=variant,
+            .position=position, .size=size, .responseTime=freshness.responseTime, .initialAge=freshness.initialAge,
+            .lifetime=freshness.lifetime
+    });
+    pthread_rwlock_unlock(&cache.lock);
+    return stored;
+}
+
+void *HttpSharedCache_find(const uint64_t key, size_t *cursor, size_t *size, uint64_t *variant,
+                           struct HttpCacheFreshness *freshness) {
+    assert(cursor);
+    assert(size);
+    assert(variant);
+    assert(freshness);
+    void *copy = NULL;
+    pthread_rwlock_rdlock(&cache.lock);
+    for (; NULL == copy && cache.open && *cursor < HTTP_SHARED_CACHE_PROBES; (*cursor)++) {
+        struct Segment *segment = cache.segment;
+        struct Slot value;
+        if (readSlot(&segment->slots[(key + *cursor) % HTTP_SHARED_CACHE_SLOTS], &value) && value.key == key &&
+            isLive(segment, &value) && NULL != (copy = copyOf(segment, &value))) {
+            *size = (size_t) value.size;
+            *variant = value.variant;
+            *freshness = freshnessOf(&value);
+        }
+    }
+    pthread_rwlock_unlock(&cache.lock);
+    return copy;
+}
+
+void HttpSharedCache_refresh(const uint64_t key, const uint64_t variant, const struct HttpCacheFreshness freshness) {
+    pthread_rwlock_rdlock(&cache.lock);
+    for (size_t i = 0; cache.open && i < HTTP_SHARED_CACHE_PROBES; i++) {
+        struct Segment *segment = cache.segment;
+        struct Slot *slot = &segment->slots[(key + i) % HTTP_SHARED_CACHE_SLOTS];
+        struct Slot value;
+        if (readSlot(slot, &value) && value.key == key && value.variant == variant && isLive(segment, &value) &&
+            lockSlot(slot, value.sequence)) {
+            value.flags = SLOT_VALID | (freshness.noCache ? SLOT_NO_CACHE : 0);
+            value.responseTime = freshness.responseTime;
+            value.initialAge = freshness.initialAge;
+            value.lifetime = freshness.lifetime;
+            writeSlot(slot, &value);
+            unlockSlot(slot, value.sequence);
+        }
+    }
+    pthread_rwlock_unlock(&cache.lock);
+}
+
+void HttpSharedCache_remove(const uint64_t key, const uint64_t variant) {
+    pthread_rwlock_rdlock(&cache.lock);
+    for (size_t i = 0; cache.open && i < HTTP_SHARED_CACHE_PROBES; i++) {
+        struct Segment *segment = cache.segment;
+        struct Slot *slot = &segment->slots[(key + i) % HTTP_SHARED_CACHE_SLOTS];
+        struct Slot value;
+        if (readSlot(slot, &value) && value.key == key && value.variant == variant && isLive(segment, &value) &&
+            lockSlot(slot, value.sequence)) {
+            value.flags = 0;
+            writeSlot(slot, &value);
+            unlockSlot(slot, value.sequence);
+        }
+    }
+    pthread_rwlock_unlock(&cache.lock);
+}
@@ -0,0 +1,166 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <http.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of slots of the index of a shared cache segment, the maximum number of responses it can hold.
+ */
+#ifndef HTTP_SHARED_CACHE_SLOTS
+#define HTTP_SHARED_CACHE_SLOTS  4096
+#endif
+
+/**
+ * Number of consecutive slots a key may be placed into, when they are all taken the one holding the oldest response
+ * is replaced.
+ */
+#ifndef HTTP_SHARED_CACHE_PROBES
+#define HTTP_SHARED_CACHE_PROBES  16
+#endif
+
+/**
+ * Counters of the shared cache segment, summed over all the processes using it:
+ *  - stores: responses written to the segment;
+ *  - evictions: responses dropped from the index to make room for others;
+ *  - entries: responses currently readable;
+ *  - bytes: size of the responses currently readable.
+ */
+struct HttpSharedCacheStats {
+    size_t stores;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+/**
+ * Opens a shared memory segment backing the response cache of HttpRequest_fire, so that the responses fetched by one
+ * process are served to all the processes using the same segment. Responses are appended to a ring buffer that
+ * overwrites the oldest ones once full, and published in a hash index whose slots are guarded by sequence locks:
+ * lookups never block nor take locks across processes, they copy the response out of the segment and retry on
+ * another slot if a writer got in the way.
+ * Once opened, responses are written to the segment as they are stored into the cache, and looked up in the segment
+ * when not found in memory, before the disk cache if any; Http_setCacheCapacity still bounds the in-memory part alone
+ * and may be set to 0 to keep a single copy of each response per host.
+ *
+ * @param name The name of a POSIX shared memory object, created if missing, to share the segment with unrelated
+ * processes; NULL to create an anonymous segment shared with the processes forked afterwards.
+ * @param capacity The size of the ring buffer, responses larger than a quarter of that are not stored.
+ * @return true if the segment has been opened else false, if it can not be created or an existing segment has a
+ * different capacity. A previously opened segment is closed in any case.
+ */
+extern bool
+Http_openSharedCache(const char *name, size_t capacity)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Closes the shared cache segment of this process if open. Named segments outlive their processes until unlinked.
+ */
+extern void
+Http_closeSharedCache(void);
+
+/**
+ * Removes the name of a shared cache segment, the segment is freed once closed by all the processes using it.
+ *
+ * @attention name must not be NULL.
+ *
+ * @return true if the name has been removed else false.
+ */
+extern bool
+Http_unlinkSharedCache(const char *name)
+__attribute__((__nonnull__));
+
+/**
+ * Returns true if a shared cache segment is open else false.
+ */
+extern bool
+Http_isSharedCacheOpen(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns the counters of the shared cache segment, all 0 if it is not open.
+ */
+extern struct HttpSharedCacheStats
+Http_getSharedCacheStats(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Copies a response made of parts into the segment and publishes it in the index, replacing the response stored with
+ * the same key and variant if any. The response cache does this on its own, this is meant for other caching layers.
+ *
+ * @attention parts must not be NULL.
+ *
+ * @param key The hash identifying the url of the response, distinct urls may share a key.
+ * @param variant The hash identifying the response among the ones of the same url.
+ * @return true if the response has been stored else false.
+ */
+extern bool
+HttpSharedCache_store(uint64_t key, uint64_t variant, struct HttpCacheFreshness freshness,
+                      const struct iovec *parts, size_t partsLength)
+__attribute__((__nonnull__));
+
+/**
+ * Finds the next response stored with key, starting from *cursor which must be 0 for the first call, and copies it
+ * into a private memory mapping owned by the caller, to be passed to HttpMappedText_fromMapping or unmapped.
+ *
+ * @attention cursor, size, variant and freshness must not be NULL.
+ *
+ * @param size Overwritten with the size of the copy, the size of the parts the response has been stored with.
+ * @return The copy of the response, NULL if no more responses are stored with key.
+ */
+extern void *
+HttpSharedCache_find(uint64_t key, size_t *cursor, size_t *size, uint64_t *variant,
+                     struct HttpCacheFreshness *freshness)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Updates the freshness of the response stored with key and variant, if still stored.
+ */
+extern void
+HttpSharedCache_refresh(uint64_t key, uint64_t variant, struct HttpCacheFreshness freshness);
+
+/**
+ * Removes the response stored with key and variant, if still stored.
+ */
+extern void
+HttpSharedCache_remove(uint64_t key, uint64_t variant);
+
+#ifdef __cplusplus
+}
+#endif
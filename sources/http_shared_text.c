@@ -0,0 +1,79 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <assert.h>
+#include <alligator/alligator.h>
+
+static void deleteSharedText(void *memory) {
+    assert(memory);
+    struct HttpSharedText *self = memory;
+    Text_delete((Text) self->__text);
+    Alligator_free(self);
+}
+
+const struct HttpSharedText *HttpSharedText_new(Text *ref) {
+    assert(ref);
+    assert(*ref);
+    struct HttpSharedText *self = Option_unwrap(Alligator_malloc(sizeof(*self)));
+    HttpSharedText_initialize(self, *ref, self, deleteSharedText);
+    *ref = NULL;
+    return self;
+}
+
+void HttpSharedText_initialize(struct HttpSharedText *self, TextView text, void *memory,
+                               HttpSharedText_Destructor destructor) {
+    assert(self);
+    assert(text);
+    assert(destructor);
+    self->__references = 1;
+    self->__text = text;
+    self->__memory = memory;
+    self->__destructor = destructor;
+}
+
+TextView HttpSharedText_get(const struct HttpSharedText *self) {
+    assert(self);
+    return self->__text;
+}
+
+const struct HttpSharedText *HttpSharedText_retain(const struct HttpSharedText *self) {
+    assert(self);
+    struct HttpSharedText *mutableSelf = (struct HttpSharedText *) self;
+    __atomic_fetch_add(&mutableSelf->__references, 1, __ATOMIC_RELAXED);
+    return self;
+}
+
+void HttpSharedText_release(const struct HttpSharedText *self) {
+    if (self) {
+        struct HttpSharedText *mutableSelf = (struct HttpSharedText *) self;
+        if (1 == __atomic_fetch_sub(&mutableSelf->__references, 1, __ATOMIC_ACQ_REL)) {
+            mutableSelf->__destructor(mutableSelf->__memory);
+        }
+    }
+}
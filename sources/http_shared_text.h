@@ -0,0 +1,113 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <http.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Type signature of the function releasing the memory behind a shared text.
+ */
+typedef void (*HttpSharedText_Destructor)(void *memory);
+
+/**
+ * A reference counted, immutable, text shared between several owners, possibly living on different threads.
+ * The underlying memory is released only when the last owner releases its reference.
+ *
+ * @attention This type must be treated as opaque therefore its members should never be accessed directly,
+ * it is defined here only in order to allow embedding it into other objects.
+ */
+struct HttpSharedText {
+    size_t __references;
+    TextView __text;
+    void *__memory;
+    HttpSharedText_Destructor __destructor;
+};
+
+/**
+ * Creates a new shared text holding the only reference to text.
+ *
+ * @attention ref must not be NULL.
+ * @attention *ref must not be NULL.
+ * @attention this function moves the ownership of the text to the shared text invalidating every previous reference.
+ */
+extern const struct HttpSharedText *
+HttpSharedText_new(Text *ref)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Initializes a shared text embedded into another object, holding one reference.
+ * When the last reference is released destructor is invoked on memory.
+ *
+ * @attention self must not be NULL.
+ * @attention text must not be NULL.
+ * @attention destructor must not be NULL.
+ */
+extern void
+HttpSharedText_initialize(struct HttpSharedText *self, TextView text, void *memory, HttpSharedText_Destructor destructor)
+__attribute__((__nonnull__(1, 2, 4)));
+
+/**
+ * Returns the text shared by self.
+ * Note: The text is immutable and stays valid as long as the caller holds a reference.
+ *
+ * @attention self must not be NULL.
+ */
+extern TextView
+HttpSharedText_get(const struct HttpSharedText *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Acquires a new reference to self.
+ *
+ * @attention self must not be NULL.
+ *
+ * @return self
+ */
+extern const struct HttpSharedText *
+HttpSharedText_retain(const struct HttpSharedText *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Releases a reference to self, freeing memory if it was the last one.
+ * Note: If self is NULL no action will be performed.
+ */
+extern void
+HttpSharedText_release(const struct HttpSharedText *self);
+
+#ifdef __cplusplus
+}
+#endif
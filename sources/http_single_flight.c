@@ -0,0 +1,243 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <panic/panic.h>
+#include <alligator/alligator.h>
+
+#define BUCKETS     64
+
+/*
+ * Flights are referenced by their leader and by each follower, the last one leaving deletes the flight.
+ * The table and the flights are guarded by a single lock: flights are few and their critical sections short.
+ * Once landed, flights are no longer reachable from the table and their result is never modified again.
+ */
+struct HttpFlight {
+    struct HttpFlight *next;
+    pthread_cond_t landing;
+    Atom url;
+    Text headers;
+    enum HttpMethod method;
+    bool followLocation;
+    bool peerVerification;
+    bool hostVerification;
+    bool landed;
+    size_t references;
+    Error error;
+    Atom effectiveUrl;
+    enum HttpStatus status;
+    struct HttpTimings timings;
+    Text responseHeaders;
+    const struct HttpSharedText *body;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct HttpFlight *buckets[BUCKETS] = {0};
+static struct HttpSingleFlightStats stats = {0};
+static bool enabled = false;
+
+static struct HttpFlight **bucketOf(Atom url) {
+    // urls are interned, their address identifies them
+    const uint64_t hash = (uint64_t) (uintptr_t) url * UINT64_C(0x9e3779b97f4a7c15);
+    return &buckets[(hash >> 32) % BUCKETS];
+}
+
+static bool isJoinable(const struct HttpFlight *self, const struct HttpRequest *request) {
+    return self->url == HttpRequest_getUrl(request) && self->method == HttpRequest_getMethod(request) &&
+           self->followLocation == HttpRequest_getFollowLocation(request) &&
+           self->peerVerification == HttpRequest_getPeerVerification(request) &&
+           self->hostVerification == HttpRequest_getHostVerification(request) &&
+           0 == strcmp(self->headers, HttpRequest_getHeaders(request));
+}
+
+static void deleteFlight(struct HttpFlight *self) {
+    pthread_cond_destroy(&self->landing);
+    Text_delete(self->headers);
+    if (NULL != self->responseHeaders) {
+        Text_delete(self->responseHeaders);
+    }
+    HttpSharedText_release(self->body);
+    Alligator_free(self);
+}
+
+// Drops a reference to the flight, deleting it if it was the last one.
+static void leave(struct HttpFlight *self) {
+    pthread_mutex_lock(&lock);
+    const bool last = 0 == --self->references;
+    pthread_mutex_unlock(&lock);
+    if (last) {
+        deleteFlight(self);
+    }
+}
+
+static const struct HttpResponse *respond(const struct HttpFlight *self, const struct HttpRequest **ref) {
+    struct HttpResponseBuilder *builder = HttpResponseBuilder_new(ref);
+    HttpResponseBuilder_setTimings(builder, self->timings);
+    HttpResponseBuilder_setUrl(builder, self->effectiveUrl);
+    HttpResponseBuilder_setStatus(builder, self->status);
+    const char *tag = Alligator_enterTag("HttpResponse");
+    Text headers = Text_duplicate(self->responseHeaders);
+    Alligator_exitTag(tag);
+    HttpResponseBuilder_setHeaders(builder, &headers);
+    HttpResponseBuilder_setSharedBody(builder, self->body);
+    return HttpResponseBuilder_build(&builder);
+}
+
+bool Http_setSingleFlight(const bool value) {
+    return __atomic_exchange_n(&enabled, value, __ATOMIC_RELAXED);
+}
+
+bool Http_isSingleFlightEnabled(void) {
+    return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+struct HttpSingleFlightStats Http_getSingleFlightStats(void) {
+    pthread_mutex_lock(&lock);
+    const struct HttpSingleFlightStats result = stats;
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+bool HttpSingleFlight_accepts(const struct HttpRequest *request) {
+    assert(request);
+    const enum HttpMethod method = HttpRequest_getMethod(request);
+    return Http_isSingleFlightEnabled() && (HTTP_METHOD_GET == method || HTTP_METHOD_HEAD == method) &&
+           Text_isEmpty(HttpRequest_getBody(request)) && NULL == HttpRequest_getRope(request);
+}
+
+struct HttpFlight *HttpSingleFlight_join(const struct HttpRequest *request, bool *leader) {
+    assert(request);
+    assert(leader);
+    struct HttpFlight **bucket = bucketOf(HttpRequest_getUrl(request));
+    pthread_mutex_lock(&lock);
+    for (struct HttpFlight *flight = *bucket; NULL != flight; flight = flight->next) {
+        if (isJoinable(flight, request)) {
+            flight->references++;
+            stats.followers++;
+            pthread_mutex_unlock(&lock);
+            *leader = false;
+            return flight;
+        }
+    }
+
+    const char *tag = Alligator_enterTag("HttpSingleFlight");
+    struct HttpFlight *self = Option_unwrap(Alligator_malloc(sizeof(*self)));
+    *self = (struct HttpFlight) {
+            .next=*bucket, .url=HttpRequest_getUrl(request), .headers=Text_duplicate(HttpRequest_getHeaders(request)),
+            .method=HttpRequest_getMethod(request), .followLocation=HttpRequest_getFollowLocation(request),
+            .peerVerification=HttpRequest_getPeerVerification(request),
+            .hostVerification=HttpRequest_getHostVerification(request), .landed=false, .references=1, .error=Ok,
+            .effectiveUrl=NULL, .status=HTTP_STATUS_OK, .timings={0}, .responseHeaders=NULL, .body=NULL
+    };
+    Alligator_exitTag(tag);
+    // followers wait no longer than their own total timeout, measured on a clock that does not jump
+    pthread_condattr_t attributes;
+    if (0 != pthread_condattr_init(&attributes) || 0 != pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC) ||
+        0 != pthread_cond_init(&self->landing, &attributes)) {
+        Panic_terminate("Unable to initialize condition variable\n");
+    }
+    pthread_condattr_destroy(&attributes);
+    *bucket = self;
+    stats.flights++;
+    pthread_mutex_unlock(&lock);
+    *leader = true;
+    return self;
+}
+
+void HttpFlight_land(struct HttpFlight *self, Http_FireResult result) {
+    assert(self);
+    Error error = Ok;
+    Text responseHeaders = NULL;
+    const struct HttpSharedText *body = NULL;
+    const struct HttpResponse *response = NULL;
+    if (Http_FireResult_isOk(result)) {
+        response = Http_FireResult_unwrap(result);
+        const char *tag = Alligator_enterTag("HttpSingleFlight");
+        responseHeaders = Text_duplicate(HttpResponse_getHeaders(response));
+        Alligator_exitTag(tag);
+        body = HttpResponse_shareBody(response);
+    } else {
+        error = Http_FireResult_unwrapError(result);
+    }
+
+    pthread_mutex_lock(&lock);
+    struct HttpFlight **link = bucketOf(self->url);
+    while (*link != self) {
+        link = &(*link)->next;
+    }
+    *link = self->next;
+    self->next = NULL;
+    self->error = error;
+    if (NULL != response) {
+        self->effectiveUrl = HttpResponse_getUrl(response);
+        self->status = HttpResponse_getStatus(response);
+        self->timings = HttpResponse_getTimings(response);
+        self->responseHeaders = responseHeaders;
+        self->body = body;
+    }
+    self->landed = true;
+    pthread_cond_broadcast(&self->landing);
+    pthread_mutex_unlock(&lock);
+    leave(self);
+}
+
+Http_FireResult HttpFlight_await(struct HttpFlight *self, const struct HttpRequest **ref) {
+    assert(self);
+    assert(ref);
+    assert(*ref);
+    const size_t timeout = HttpRequest_getTotalTimeout(*ref);
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (time_t) (timeout / 1000);
+    deadline.tv_nsec += (long) (timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    int waited = 0;
+    pthread_mutex_lock(&lock);
+    while (!self->landed && ETIMEDOUT != waited) {
+        waited = 0 == timeout ? pthread_cond_wait(&self->landing, &lock) :
+                 pthread_cond_timedwait(&self->landing, &lock, &deadline);
+    }
+    // the flight may land right as the deadline expires, its result is used then
+    const bool timedOut = !self->landed;
+    pthread_mutex_unlock(&lock);
+    Http_FireResult result = timedOut ? Http_FireResult_error(HttpError_TransferTimedOut) :
+                             Ok == self->error ? Http_FireResult_ok(respond(self, ref)) :
+                             Http_FireResult_error(self->error);
+    leave(self);
+    return result;
+}
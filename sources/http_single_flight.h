@@ -0,0 +1,129 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <http.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct HttpRequest;
+struct HttpFlight;
+
+/**
+ * Counters of request coalescing since the process started:
+ *  - flights: requests sent to the server on behalf of the identical requests that joined them;
+ *  - followers: requests answered with the result of an identical request already in flight.
+ */
+struct HttpSingleFlightStats {
+    size_t flights;
+    size_t followers;
+};
+
+/**
+ * Enables or disables the coalescing of identical requests fired concurrently by HttpRequest_fire, disabled by
+ * default. GET and HEAD requests without a body having the same url, headers, redirect and verification settings
+ * share one transfer: the first one is sent to the server while the others wait for it, then each one gets its own
+ * response sharing the headers and the read-only body of the first one, or the same error. Requests answered by the
+ * response cache never reach this point.
+ *
+ * @return The previous setting.
+ */
+extern bool
+Http_setSingleFlight(bool enabled);
+
+/**
+ * Returns true if identical requests are coalesced else false.
+ */
+extern bool
+Http_isSingleFlightEnabled(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns the counters of request coalescing.
+ */
+extern struct HttpSingleFlightStats
+Http_getSingleFlightStats(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns true if coalescing is enabled and this request may share its transfer else false.
+ *
+ * @attention request must not be NULL.
+ */
+extern bool
+HttpSingleFlight_accepts(const struct HttpRequest *request)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Joins the flight of the requests identical to this one, starting a new flight if none is in progress.
+ * HttpRequest_fire does this on its own, this is meant for callers performing requests by other means.
+ *
+ * @attention request must not be NULL.
+ * @attention leader must not be NULL.
+ *
+ * @param leader Set to true if the caller started the flight, then it must send the request and land the flight
+ * with HttpFlight_land, else it must wait for the flight with HttpFlight_await.
+ * @return The flight.
+ */
+extern struct HttpFlight *
+HttpSingleFlight_join(const struct HttpRequest *request, bool *leader)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Lands the flight with the result of its leader, waking up the followers. Later identical requests start a new
+ * flight. The result is left untouched and the flight must not be used by the leader afterwards.
+ *
+ * @attention self must not be NULL.
+ */
+extern void
+HttpFlight_land(struct HttpFlight *self, Http_FireResult result)
+__attribute__((__nonnull__));
+
+/**
+ * Waits for the flight to land and returns its result, the flight must not be used by the follower afterwards.
+ * The wait is bounded by the total timeout of the request of the follower, past which HttpError_TransferTimedOut is
+ * returned while the flight goes on for the others.
+ *
+ * @attention self must not be NULL.
+ * @attention ref must not be NULL, *ref must not be NULL, on success the request is moved into a response sharing the
+ * body of the response of the leader and *ref set to NULL, on error the request is left untouched.
+ */
+extern Http_FireResult
+HttpFlight_await(struct HttpFlight *self, const struct HttpRequest **ref)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <time.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <panic/panic.h>
+
+struct Entry {
+    time_t time;
+    const char *method;
+    char url[HTTP_SLOW_LOG_MAX_URL_LENGTH];
+    enum HttpStatus status;
+    Error error;
+    struct HttpTimings timings;
+    bool connectionReused;
+};
+
+/*
+ * The threshold and the sampling are checked without locking, slow requests are expected to be rare therefore the
+ * log itself is guarded by a plain mutex.
+ */
+static size_t threshold = 0;
+static uint64_t sampleLimit = UINT64_MAX;
+static double sampleRate = 1.0;
+static __thread uint64_t randomState = 0;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct Entry entries[HTTP_SLOW_LOG_SIZE];
+static size_t entriesCount = 0;
+static size_t nextEntry = 0;
+
+static void lock(void) {
+    if (0 != pthread_mutex_lock(&mutex)) {
+        Panic_terminate("Unable to lock slow request log\n");
+    }
+}
+
+static void unlock(void) {
+    if (0 != pthread_mutex_unlock(&mutex)) {
+        Panic_terminate("Unable to unlock slow request log\n");
+    }
+}
+
+static uint64_t nextRandom(void) {
+    if (0 == randomState) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        randomState = ((uint64_t) ts.tv_nsec << 1 | 1) ^ (uint64_t) (uintptr_t) &randomState;
+    }
+    // xorshift64*
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 2685821657736338717ULL;
+}
+
+size_t Http_setSlowRequestThreshold(const size_t milliseconds) {
+    return __atomic_exchange_n(&threshold, milliseconds, __ATOMIC_RELAXED);
+}
+
+double Http_setSlowRequestSampleRate(double rate) {
+    if (!(rate > 0.0)) {
+        rate = 0.0;
+    } else if (rate > 1.0) {
+        rate = 1.0;
+    }
+    lock();
+    const double previousRate = sampleRate;
+    sampleRate = rate;
+    __atomic_store_n(&sampleLimit, rate >= 1.0 ? UINT64_MAX : (uint64_t) (rate * 18446744073709551616.0),
+                     __ATOMIC_RELAXED);
+    unlock();
+    return previousRate;
+}
+
+void HttpSlowLog_record(const char *const method, Atom url, const enum HttpStatus status, const Error error,
+                        const struct HttpTimings *const timings, const bool connectionReused) {
+    assert(method);
+    assert(url);
+    assert(error);
+    assert(timings);
+    const size_t milliseconds = __atomic_load_n(&threshold, __ATOMIC_RELAXED);
+    if (0 == milliseconds || timings->total < (uint64_t) milliseconds * 1000) {
+        return;
+    }
+    const uint64_t limit = __atomic_load_n(&sampleLimit, __ATOMIC_RELAXED);
+    if (UINT64_MAX != limit && nextRandom() >= limit) {
+        return;
+    }
+
+    lock();
+    struct Entry *entry = &entries[nextEntry];
+    entry->time = time(NULL);
+    entry->method = method;
+    strncpy(entry->url, url, sizeof(entry->url) - 1);
+    entry->url[sizeof(entry->url) - 1] = '\0';
+    entry->status = status;
+    entry->error = error;
+    entry->timings = *timings;
+    entry->connectionReused = connectionReused;
+    nextEntry = (nextEntry + 1) % HTTP_SLOW_LOG_SIZE;
+    if (entriesCount < HTTP_SLOW_LOG_SIZE) {
+        entriesCount++;
+    }
+    unlock();
+}
+
+static void appendEntry(Text *out, const struct Entry *entry) {
+    assert(out);
+    assert(*out);
+    assert(entry);
+    char timestamp[32];
+    struct tm calendar;
+    gmtime_r(&entry->time, &calendar);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &calendar);
+
+    *out = Text_appendFormat(out, "%s %s %s ", timestamp, entry->method, entry->url);
+    if (Ok == entry->error) {
+        *out = Text_appendFormat(out, "%d", entry->status);
+    } else {
+        *out = Text_appendFormat(out, "\"%s\"", Error_explain(entry->error));
+    }
+    const struct HttpTimings *timings = &entry->timings;
+    *out = Text_appendFormat(out, " total=%lluus dns=%llu connect=%llu tls=%llu pretransfer=%llu firstByte=%llu "
+                                  "transfer=%llu redirect=%llu received=%llu sent=%llu reused=%s\n",
+                             (unsigned long long) timings->total, (unsigned long long) timings->dns,
+                             (unsigned long long) timings->connect, (unsigned long long) timings->tls,
+                             (unsigned long long) timings->pretransfer, (unsigned long long) timings->firstByte,
+                             (unsigned long long) timings->transfer, (unsigned long long) timings->redirect,
+                             (unsigned long long) timings->bytesDownloaded,
+                             (unsigned long long) timings->bytesUploaded,
+                             entry->connectionReused ? "yes" : "no");
+}
+
+void Http_getSlowRequests(Text *out) {
+    assert(out);
+    assert(*out);
+    lock();
+    const size_t first = (nextEntry + HTTP_SLOW_LOG_SIZE - entriesCount) % HTTP_SLOW_LOG_SIZE;
+    for (size_t i = 0; i < entriesCount; i++) {
+        appendEntry(out, &entries[(first + i) % HTTP_SLOW_LOG_SIZE]);
+    }
+    unlock();
+}
+
+void Http_clearSlowRequests(void) {
+    lock();
+    entriesCount = 0;
+    nextEntry = 0;
+    unlock();
+}
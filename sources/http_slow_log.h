@@ -0,0 +1,114 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <http.h>
+#include <http_status.h>
+#include <http_timings.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of entries kept by the slow request log, once full the oldest entries get overwritten.
+ */
+#ifndef HTTP_SLOW_LOG_SIZE
+#define HTTP_SLOW_LOG_SIZE  128
+#endif
+
+/**
+ * Maximum length of an url stored into the slow request log, longer urls are truncated.
+ */
+#ifndef HTTP_SLOW_LOG_MAX_URL_LENGTH
+#define HTTP_SLOW_LOG_MAX_URL_LENGTH  256
+#endif
+
+/**
+ * Sets the total time above which a request is logged as slow, failed requests are logged too if they took longer.
+ * The slow request log starts disabled.
+ *
+ * @param milliseconds The threshold, 0 disables the log.
+ * @return The previous threshold.
+ */
+extern size_t
+Http_setSlowRequestThreshold(size_t milliseconds);
+
+/**
+ * Sets the fraction of slow requests actually logged, defaults to 1.
+ *
+ * @param rate The sample rate, clamped between 0 and 1.
+ * @return The previous sample rate.
+ */
+extern double
+Http_setSlowRequestSampleRate(double rate);
+
+/**
+ * Appends the slow requests logged so far to out, oldest first, one per line: time, method, url, status or error,
+ * timings, body bytes and whether the connection was reused.
+ *
+ * @attention out and *out must not be NULL.
+ *
+ * @attention the reference to the text may be invalidated after this call, *out is updated with the new text.
+ */
+extern void
+Http_getSlowRequests(Text *out)
+__attribute__((__nonnull__));
+
+/**
+ * Empties the slow request log.
+ */
+extern void
+Http_clearSlowRequests(void);
+
+/**
+ * Logs a request if it was slower than the threshold and it is sampled.
+ * HttpRequest_fire logs every request on its own, this is meant for requests performed by other means.
+ *
+ * @attention method must not be NULL.
+ * @attention url must not be NULL.
+ * @attention error must not be NULL.
+ * @attention timings must not be NULL.
+ *
+ * @param status The status of the response, ignored if error is not Ok.
+ * @param error Ok if a response was received, the error returned by the request otherwise.
+ * @param connectionReused Whether the request was sent on an already established connection.
+ */
+extern void
+HttpSlowLog_record(const char *method, Atom url, enum HttpStatus status, Error error,
+                   const struct HttpTimings *timings, bool connectionReused)
+__attribute__((__nonnull__));
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Per-phase breakdown of a transfer.
+ *
+ * Every phase is expressed in microseconds and measures only its own duration, so that the phases add up to the
+ * total time:
+ *  - dns: name resolution;
+ *  - connect: TCP connection establishment;
+ *  - tls: TLS handshake (0 for plain connections);
+ *  - pretransfer: from the connection being ready to the request being about to be sent;
+ *  - firstByte: from the request being sent to the first byte of the response (server think time);
+ *  - transfer: from the first byte to the end of the response;
+ *  - redirect: time spent following redirects before the final request started, if any.
+ * Note: When redirects are followed libcurl sums up the phases of every request.
+ */
+struct HttpTimings {
+    uint64_t dns;
+    uint64_t connect;
+    uint64_t tls;
+    uint64_t pretransfer;
+    uint64_t firstByte;
+    uint64_t transfer;
+    uint64_t redirect;
+    uint64_t total;
+    uint64_t bytesUploaded;
+    uint64_t bytesDownloaded;
+    uint64_t headerBytes;
+};
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,340 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <time.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <panic/panic.h>
+#include <alligator/alligator.h>
+
+#if HTTP_TRACE_RING_SIZE & (HTTP_TRACE_RING_SIZE - 1)
+#error "HTTP_TRACE_RING_SIZE must be a power of two"
+#endif
+
+#define EVENT_DATA_SIZE     48
+#define LINE_SIZE           192
+
+struct Event {
+    uint64_t time;
+    uint32_t request;
+    uint16_t kind;
+    uint16_t length;
+    unsigned char data[EVENT_DATA_SIZE];
+};
+
+/*
+ * Layout of the data of completion events, phases are expressed in microseconds.
+ */
+struct Completion {
+    uint32_t status;
+    uint32_t dns;
+    uint32_t connect;
+    uint32_t tls;
+    uint32_t pretransfer;
+    uint32_t firstByte;
+    uint32_t transfer;
+    uint32_t total;
+    uint32_t received;
+    uint32_t sent;
+};
+
+/*
+ * Each ring is written only by the thread owning it: events are published advancing head, readers copy the events
+ * and then discard those that may have been overwritten meanwhile.
+ */
+struct Ring {
+    struct Ring *next;
+    size_t id;
+    bool owned;
+    uint32_t request;
+    uint64_t head;
+    struct Event events[HTTP_TRACE_RING_SIZE];
+};
+
+typedef void (*Sink)(const char *line, void *context);
+
+#ifdef HTTP_DEBUG
+static bool enabled = true;
+#else
+static bool enabled = false;
+#endif
+
+static struct Ring *rings = NULL;
+static size_t ringsCount = 0;
+static __thread struct Ring *localRing = NULL;
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+static Panic_Callback previousPanicCallback = NULL;
+
+static const char *const kindNames[] = {
+        [HTTP_TRACE_REQUEST_STARTED] = "started",
+        [HTTP_TRACE_REQUEST_COMPLETED] = "completed",
+        [HTTP_TRACE_REQUEST_FAILED] = "failed",
+        [HTTP_TRACE_TEXT] = "text",
+        [HTTP_TRACE_HEADER_IN] = "header-in",
+        [HTTP_TRACE_HEADER_OUT] = "header-out",
+        [HTTP_TRACE_DATA_IN] = "data-in",
+        [HTTP_TRACE_DATA_OUT] = "data-out",
+        [HTTP_TRACE_TLS_DATA_IN] = "tls-data-in",
+        [HTTP_TRACE_TLS_DATA_OUT] = "tls-data-out",
+};
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+static uint32_t clamp(const uint64_t value) {
+    return value > UINT32_MAX ? UINT32_MAX : (uint32_t) value;
+}
+
+static void releaseRing(void *ring) {
+    assert(ring);
+    __atomic_store_n(&((struct Ring *) ring)->owned, false, __ATOMIC_RELEASE);
+}
+
+static void createRingKey(void) {
+    if (0 != pthread_key_create(&ringKey, releaseRing)) {
+        Panic_terminate("Unable to create trace thread key\n");
+    }
+}
+
+/*
+ * Rings are never freed: the ring of a terminated thread keeps its events and is handed over to the next thread in
+ * need of one.
+ */
+static struct Ring *acquireRing(void) {
+    pthread_once(&ringKeyOnce, createRingKey);
+    struct Ring *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+    for (; NULL != ring; ring = ring->next) {
+        bool expected = false;
+        if (__atomic_compare_exchange_n(&ring->owned, &expected, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (NULL == ring) {
+        ring = Option_unwrap(Alligator_calloc(1, sizeof(*ring)));
+        ring->owned = true;
+        ring->id = __atomic_fetch_add(&ringsCount, 1, __ATOMIC_RELAXED);
+        ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    if (0 != pthread_setspecific(ringKey, ring)) {
+        Panic_terminate("Unable to set trace thread key\n");
+    }
+    return ring;
+}
+
+static struct Ring *getLocalRing(void) {
+    if (NULL == localRing) {
+        localRing = acquireRing();
+    }
+    return localRing;
+}
+
+static void push(struct Ring *ring, const enum HttpTrace_Kind kind, const void *bytes, size_t size) {
+    assert(ring);
+    assert(bytes);
+    const uint64_t head = ring->head;
+    struct Event *event = &ring->events[head & (HTTP_TRACE_RING_SIZE - 1)];
+    if (size > EVENT_DATA_SIZE) {
+        size = EVENT_DATA_SIZE;
+    }
+    event->time = now();
+    event->request = ring->request;
+    event->kind = (uint16_t) kind;
+    event->length = (uint16_t) size;
+    memcpy(event->data, bytes, size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+bool Http_setTracing(const bool newEnabled) {
+    return __atomic_exchange_n(&enabled, newEnabled, __ATOMIC_RELAXED);
+}
+
+bool Http_isTracing(void) {
+    return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+void HttpTrace_requestStarted(const char *const method, Atom url) {
+    assert(method);
+    assert(url);
+    char buffer[EVENT_DATA_SIZE];
+    const int length = snprintf(buffer, sizeof(buffer), "%s %s", method, url);
+    struct Ring *ring = getLocalRing();
+    ring->request++;
+    push(ring, HTTP_TRACE_REQUEST_STARTED, buffer, length < 0 ? 0 : (size_t) length);
+}
+
+void HttpTrace_record(const enum HttpTrace_Kind kind, const void *const bytes, const size_t size) {
+    assert(bytes);
+    switch (kind) {
+        case HTTP_TRACE_DATA_IN:
+        case HTTP_TRACE_DATA_OUT:
+        case HTTP_TRACE_TLS_DATA_IN:
+        case HTTP_TRACE_TLS_DATA_OUT: {
+            const uint64_t count = size;
+            push(getLocalRing(), kind, &count, sizeof(count));
+            break;
+        }
+        default:
+            push(getLocalRing(), kind, bytes, size);
+    }
+}
+
+void HttpTrace_requestCompleted(const enum HttpStatus status, const struct HttpTimings *const timings) {
+    assert(timings);
+    const struct Completion completion = {
+            .status=(uint32_t) status,
+            .dns=clamp(timings->dns),
+            .connect=clamp(timings->connect),
+            .tls=clamp(timings->tls),
+            .pretransfer=clamp(timings->pretransfer),
+            .firstByte=clamp(timings->firstByte),
+            .transfer=clamp(timings->transfer),
+            .total=clamp(timings->total),
+            .received=clamp(timings->bytesDownloaded),
+            .sent=clamp(timings->bytesUploaded)
+    };
+    push(getLocalRing(), HTTP_TRACE_REQUEST_COMPLETED, &completion, sizeof(completion));
+}
+
+void HttpTrace_requestFailed(const Error error, const struct HttpTimings *const timings) {
+    assert(error);
+    assert(timings);
+    char buffer[EVENT_DATA_SIZE];
+    const int length = snprintf(buffer, sizeof(buffer), "%s (%lluus)", Error_explain(error),
+                                (unsigned long long) timings->total);
+    push(getLocalRing(), HTTP_TRACE_REQUEST_FAILED, buffer, length < 0 ? 0 : (size_t) length);
+}
+
+static void formatEvent(char *line, const struct Event *event) {
+    assert(line);
+    assert(event);
+    const char *kind = event->kind < sizeof(kindNames) / sizeof(kindNames[0]) ? kindNames[event->kind] : "unknown";
+    int offset = snprintf(line, LINE_SIZE, "  %lluus #%u %s ",
+                          (unsigned long long) event->time, (unsigned) event->request, kind);
+    if (offset < 0) {
+        offset = 0;
+    }
+    char *content = line + offset;
+    const size_t available = LINE_SIZE - (size_t) offset;
+
+    switch (event->kind) {
+        case HTTP_TRACE_REQUEST_COMPLETED: {
+            struct Completion completion;
+            memcpy(&completion, event->data, sizeof(completion));
+            snprintf(content, available, "%u dns=%u connect=%u tls=%u pretransfer=%u firstByte=%u transfer=%u "
+                                         "total=%uus received=%u sent=%u\n",
+                     completion.status, completion.dns, completion.connect, completion.tls, completion.pretransfer,
+                     completion.firstByte, completion.transfer, completion.total, completion.received,
+                     completion.sent);
+            break;
+        }
+        case HTTP_TRACE_DATA_IN:
+        case HTTP_TRACE_DATA_OUT:
+        case HTTP_TRACE_TLS_DATA_IN:
+        case HTTP_TRACE_TLS_DATA_OUT: {
+            uint64_t count;
+            memcpy(&count, event->data, sizeof(count));
+            snprintf(content, available, "%llu bytes\n", (unsigned long long) count);
+            break;
+        }
+        default: {
+            size_t length = event->length;
+            while (length > 0 && ('\r' == event->data[length - 1] || '\n' == event->data[length - 1])) {
+                length--;
+            }
+            size_t i = 0;
+            for (; i < length && i + 2 < available; i++) {
+                const unsigned char c = event->data[i];
+                content[i] = (char) (c >= 0x20 && c < 0x7F ? c : '.');
+            }
+            content[i] = '\n';
+            content[i + 1] = '\0';
+        }
+    }
+}
+
+static void dump(const Sink sink, void *context) {
+    assert(sink);
+    char line[LINE_SIZE];
+    for (const struct Ring *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); NULL != ring; ring = ring->next) {
+        snprintf(line, sizeof(line), "thread %zu:\n", ring->id);
+        sink(line, context);
+
+        const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t start = head > HTTP_TRACE_RING_SIZE ? head - HTTP_TRACE_RING_SIZE : 0;
+        for (uint64_t i = start; i < head; i++) {
+            struct Event event;
+            memcpy(&event, &ring->events[i & (HTTP_TRACE_RING_SIZE - 1)], sizeof(event));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            // the owner may have overwritten the event while it was being copied
+            const uint64_t currentHead = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+            if (currentHead >= HTTP_TRACE_RING_SIZE && i <= currentHead - HTTP_TRACE_RING_SIZE) {
+                continue;
+            }
+            formatEvent(line, &event);
+            sink(line, context);
+        }
+    }
+}
+
+static void appendLine(const char *line, void *context) {
+    Text *out = context;
+    *out = Text_appendLiteral(out, line);
+}
+
+static void writeLine(const char *line, void *context) {
+    fputs(line, context);
+}
+
+void Http_dumpTrace(Text *out) {
+    assert(out);
+    assert(*out);
+    dump(appendLine, out);
+}
+
+static void dumpOnPanic(void) {
+    fputs("http trace:\n", stderr);
+    dump(writeLine, stderr);
+    if (NULL != previousPanicCallback) {
+        previousPanicCallback();
+    }
+}
+
+void Http_dumpTraceOnPanic(void) {
+    const Panic_Callback callback = Panic_registerCallback(dumpOnPanic);
+    if (dumpOnPanic != callback) {
+        previousPanicCallback = callback;
+    }
+}
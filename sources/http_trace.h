@@ -0,0 +1,147 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <http.h>
+#include <http_status.h>
+#include <http_timings.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of events kept by the trace ring of each thread, must be a power of two.
+ * Every event takes 64 bytes.
+ */
+#ifndef HTTP_TRACE_RING_SIZE
+#define HTTP_TRACE_RING_SIZE  1024
+#endif
+
+/**
+ * Kinds of trace events.
+ * Header and text events keep the first bytes of their content, data events only keep the number of bytes.
+ */
+enum HttpTrace_Kind {
+    HTTP_TRACE_REQUEST_STARTED = 0,
+    HTTP_TRACE_REQUEST_COMPLETED,
+    HTTP_TRACE_REQUEST_FAILED,
+    HTTP_TRACE_TEXT,
+    HTTP_TRACE_HEADER_IN,
+    HTTP_TRACE_HEADER_OUT,
+    HTTP_TRACE_DATA_IN,
+    HTTP_TRACE_DATA_OUT,
+    HTTP_TRACE_TLS_DATA_IN,
+    HTTP_TRACE_TLS_DATA_OUT,
+};
+
+/**
+ * Enables or disables tracing at runtime, tracing starts disabled unless HTTP_DEBUG is defined.
+ *
+ * While tracing is enabled every request records compact binary events into a lock-free ring owned by the firing
+ * thread: the libcurl debug output, request start, completion or failure and timings.
+ * Rings have a fixed size, older events get overwritten.
+ *
+ * @param enabled Whether requests fired from now on have to be traced.
+ * @return The previous setting.
+ */
+extern bool
+Http_setTracing(bool enabled);
+
+/**
+ * Tells whether tracing is enabled.
+ */
+extern bool
+Http_isTracing(void)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Appends the events currently held by the trace rings of every thread to out, one event per line.
+ *
+ * @attention out and *out must not be NULL.
+ *
+ * @attention the reference to the text may be invalidated after this call, *out is updated with the new text.
+ */
+extern void
+Http_dumpTrace(Text *out)
+__attribute__((__nonnull__));
+
+/**
+ * Registers a panic callback dumping the trace rings to stderr before terminating.
+ * The previously registered panic callback, if any, is still executed afterwards.
+ */
+extern void
+Http_dumpTraceOnPanic(void);
+
+/**
+ * Records the start of a request into the trace ring of the calling thread.
+ * Subsequent events are attributed to this request.
+ *
+ * @attention method must not be NULL.
+ * @attention url must not be NULL.
+ */
+extern void
+HttpTrace_requestStarted(const char *method, Atom url)
+__attribute__((__nonnull__));
+
+/**
+ * Records an event of the current request into the trace ring of the calling thread.
+ *
+ * @attention bytes must not be NULL.
+ */
+extern void
+HttpTrace_record(enum HttpTrace_Kind kind, const void *bytes, size_t size)
+__attribute__((__nonnull__));
+
+/**
+ * Records the completion of the current request into the trace ring of the calling thread.
+ *
+ * @attention timings must not be NULL.
+ */
+extern void
+HttpTrace_requestCompleted(enum HttpStatus status, const struct HttpTimings *timings)
+__attribute__((__nonnull__));
+
+/**
+ * Records the failure of the current request into the trace ring of the calling thread.
+ *
+ * @attention error must not be NULL.
+ * @attention timings must not be NULL.
+ */
+extern void
+HttpTrace_requestFailed(Error error, const struct HttpTimings *timings)
+__attribute__((__nonnull__));
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,3 @@
+find_package(Threads REQUIRED)
+add_library(loopback-server ${CMAKE_CURRENT_LIST_DIR}/loopback_server.h ${CMAKE_CURRENT_LIST_DIR}/loopback_server.c)
+target_link_libraries(loopback-server PRIVATE Threads::Threads)
@@ -0,0 +1,393 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <loopback/loopback_server.h>
+
+#define BUFFER_SIZE     (64U * 1024U)
+#define CACHE_ETAG      "\"loopback\""
+#define CACHE_MODIFIED  "Mon, 01 Jan 2018 00:00:00 GMT"
+#define REVALIDATED     "X-Revalidated: true\r\n"
+#define CACHE_BODY_SIZE 16U
+#define FILLER_SIZE     (64U * 1024U)
+#define POLL_MILLISECONDS   50
+
+struct LoopbackServer {
+    int socket;
+    unsigned short port;
+    bool keepAlive;
+    bool stopping;
+    size_t active;
+    size_t requests;
+    size_t connections;
+    pthread_t acceptor;
+};
+
+struct Connection {
+    struct LoopbackServer *server;
+    int socket;
+};
+
+static char filler[FILLER_SIZE];
+
+static bool sendAll(const int socket, const char *bytes, size_t size) {
+    assert(bytes);
+    while (size > 0) {
+        const ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        bytes += sent;
+        size -= (size_t) sent;
+    }
+    return true;
+}
+
+static bool sendBody(const int socket, size_t size) {
+    while (size > 0) {
+        const size_t chunk = size < FILLER_SIZE ? size : FILLER_SIZE;
+        if (!sendAll(socket, filler, chunk)) {
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+/*
+ * Receives at most size bytes, giving up once the server is stopping.
+ */
+static ssize_t receive(const struct LoopbackServer *server, const int socket, char *buffer, const size_t size) {
+    assert(server);
+    assert(buffer);
+    struct pollfd descriptor = {.fd=socket, .events=POLLIN, .revents=0};
+    while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE)) {
+        const int ready = poll(&descriptor, 1, POLL_MILLISECONDS);
+        if (ready > 0) {
+            return recv(socket, buffer, size, 0);
+        }
+        if (ready < 0 && EINTR != errno) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Returns the value of the header named name, headers are NUL-terminated and end with an empty line.
+ */
+static const char *findHeader(const char *headers, const char *name) {
+    assert(headers);
+    assert(name);
+    const size_t length = strlen(name);
+    for (const char *line = strstr(headers, "\r\n"); NULL != line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (0 == strncasecmp(line, name, length) && ':' == line[length]) {
+            line += length + 1;
+            while (' ' == *line) {
+                line++;
+            }
+            return line;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Formats the time that many seconds from now as an HTTP date.
+ */
+static void formatDate(char *buffer, const size_t size, const time_t seconds) {
+    assert(buffer);
+    const time_t date = time(NULL) + seconds;
+    struct tm fields;
+    gmtime_r(&date, &fields);
+    strftime(buffer, size, "%a, %d %b %Y %H:%M:%S GMT", &fields);
+}
+
+static const char *redirectStatusOf(const unsigned long code) {
+    switch (code) {
+        case 301:
+            return "301 Moved Permanently";
+        case 307:
+            return "307 Temporary Redirect";
+        case 308:
+            return "308 Permanent Redirect";
+        default:
+            return "302 Found";
+    }
+}
+
+/*
+ * Serves the requests of a connection until the client closes it, or after the first one if keep-alive is disabled.
+ */
+static void *serve(void *argument) {
+    struct Connection *connection = argument;
+    struct LoopbackServer *server = connection->server;
+    const int socket = connection->socket;
+    char *buffer = malloc(BUFFER_SIZE + 1);
+    size_t buffered = 0;
+    bool open = NULL != buffer;
+    free(connection);
+    if (open) {
+        buffer[0] = '\0';
+    }
+
+    while (open) {
+        // read the request line and the headers
+        char *end = NULL;
+        while (NULL == (end = strstr(buffer, "\r\n\r\n"))) {
+            // a full buffer without the end of the headers is a request we cannot serve
+            if (buffered >= BUFFER_SIZE) {
+                open = false;
+                break;
+            }
+            const ssize_t received = receive(server, socket, buffer + buffered, BUFFER_SIZE - buffered);
+            if (received <= 0) {
+                open = false;
+                break;
+            }
+            buffered += (size_t) received;
+            buffer[buffered] = '\0';
+        }
+        if (!open) {
+            break;
+        }
+        end[2] = '\0';
+
+        size_t bodySize = 0;
+        unsigned long stall = 0;
+        char cacheHeaders[512] = "";
+        const char *status = "200 OK";
+        const char *path = strchr(buffer, ' ');
+        if (NULL != path && 0 == strncmp(path + 1, "/bytes/", 7)) {
+            bodySize = strtoul(path + 8, NULL, 10);
+        } else if (NULL != path && 0 == strncmp(path + 1, "/cache/", 7)) {
+            const char *ifNoneMatch = findHeader(buffer, "If-None-Match");
+            const bool notModified = NULL != ifNoneMatch && 0 == strncmp(ifNoneMatch, CACHE_ETAG, strlen(CACHE_ETAG));
+            char *directives = NULL;
+            const unsigned long maxAge = strtoul(path + 8, &directives, 10);
+            // directives following a semicolon are sent along with 304 responses only
+            const int allLength = (int) strcspn(directives, " ");
+            const int commonLength = (int) strcspn(directives, "; ");
+            const int revalidationLength = notModified && allLength > commonLength ? allLength - commonLength - 1 : 0;
+            snprintf(cacheHeaders, sizeof(cacheHeaders),
+                     "Cache-Control: max-age=%lu%.*s%s%.*s\r\nETag: %s\r\nVary: Accept\r\n%s", maxAge, commonLength,
+                     directives, revalidationLength > 0 ? "," : "", revalidationLength, directives + commonLength + 1,
+                     CACHE_ETAG, notModified ? REVALIDATED : "");
+            status = notModified ? "304 Not Modified" : status;
+            bodySize = notModified ? 0 : CACHE_BODY_SIZE;
+        } else if (NULL != path && 0 == strncmp(path + 1, "/expires/", 9)) {
+            const char *ifModifiedSince = findHeader(buffer, "If-Modified-Since");
+            const bool notModified = NULL != ifModifiedSince &&
+                                     0 == strncmp(ifModifiedSince, CACHE_MODIFIED, strlen(CACHE_MODIFIED));
+            char date[64], expires[64];
+            formatDate(date, sizeof(date), 0);
+            formatDate(expires, sizeof(expires), (time_t) strtoul(path + 10, NULL, 10));
+            snprintf(cacheHeaders, sizeof(cacheHeaders), "Date: %s\r\nExpires: %s\r\nLast-Modified: %s\r\n%s", date,
+                     expires, CACHE_MODIFIED, notModified ? REVALIDATED : "");
+            status = notModified ? "304 Not Modified" : status;
+            bodySize = notModified ? 0 : CACHE_BODY_SIZE;
+        } else if (NULL != path && 0 == strncmp(path + 1, "/age/", 5)) {
+            const char *ifNoneMatch = findHeader(buffer, "If-None-Match");
+            const bool notModified = NULL != ifNoneMatch && 0 == strncmp(ifNoneMatch, CACHE_ETAG, strlen(CACHE_ETAG));
+            snprintf(cacheHeaders, sizeof(cacheHeaders), "Cache-Control: max-age=60\r\nAge: %lu\r\nETag: %s\r\n%s",
+                     strtoul(path + 6, NULL, 10), CACHE_ETAG, notModified ? REVALIDATED : "");
+            status = notModified ? "304 Not Modified" : status;
+            bodySize = notModified ? 0 : CACHE_BODY_SIZE;
+        } else if (NULL != path && 0 == strncmp(path + 1, "/redirect/", 10)) {
+            char *target = NULL;
+            status = redirectStatusOf(strtoul(path + 11, &target, 10));
+            snprintf(cacheHeaders, sizeof(cacheHeaders), "Location: %.*s\r\nCache-Control: max-age=60\r\n",
+                     (int) strcspn(target, " "), target);
+        } else if (NULL != path && 0 == strncmp(path + 1, "/delay/", 7)) {
+            usleep((useconds_t) (strtoul(path + 8, NULL, 10) * 1000));
+            bodySize = CACHE_BODY_SIZE;
+        } else if (NULL != path && 0 == strncmp(path + 1, "/stall/", 7)) {
+            stall = strtoul(path + 8, NULL, 10);
+            bodySize = CACHE_BODY_SIZE;
+        }
+        const char *contentLength = findHeader(buffer, "Content-Length");
+        size_t pending = NULL == contentLength ? 0 : strtoul(contentLength, NULL, 10);
+        const char *connectionHeader = findHeader(buffer, "Connection");
+        const bool keepAlive = server->keepAlive &&
+                               (NULL == connectionHeader || 0 != strncasecmp(connectionHeader, "close", 5));
+
+        // discard the request body
+        if (stall > 0 && pending > 0) {
+            usleep((useconds_t) (stall * 1000));
+        }
+        const size_t consumed = (size_t) (end + 4 - buffer);
+        size_t leftover = buffered - consumed;
+        if (leftover > pending) {
+            memmove(buffer, end + 4 + pending, leftover - pending);
+            leftover -= pending;
+            pending = 0;
+        } else {
+            pending -= leftover;
+            leftover = 0;
+        }
+        while (pending > 0) {
+            const ssize_t received = receive(server, socket, buffer, pending < BUFFER_SIZE ? pending : BUFFER_SIZE);
+            if (received <= 0) {
+                open = false;
+                break;
+            }
+            pending -= (size_t) received;
+        }
+        buffered = leftover;
+        buffer[buffered] = '\0';
+        if (!open) {
+            break;
+        }
+
+        char headers[672];
+        const int headersLength = snprintf(headers, sizeof(headers),
+                                           "HTTP/1.1 %s\r\n%sContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                                           status, cacheHeaders, bodySize, keepAlive ? "keep-alive" : "close");
+        open = sendAll(socket, headers, (size_t) headersLength);
+        if (open && stall > 0) {
+            usleep((useconds_t) (stall * 1000));
+        }
+        open = open && sendBody(socket, bodySize) && keepAlive;
+        __atomic_add_fetch(&server->requests, 1, __ATOMIC_RELAXED);
+    }
+
+    free(buffer);
+    close(socket);
+    __atomic_sub_fetch(&server->active, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *acceptConnections(void *argument) {
+    struct LoopbackServer *self = argument;
+    for (;;) {
+        const int socket = accept(self->socket, NULL, NULL);
+        if (socket < 0) {
+            if (EINTR == errno || ECONNABORTED == errno) {
+                continue;
+            }
+            break;
+        }
+        const int noDelay = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        __atomic_add_fetch(&self->connections, 1, __ATOMIC_RELAXED);
+
+        struct Connection *connection = malloc(sizeof(*connection));
+        pthread_t thread;
+        if (NULL == connection) {
+            close(socket);
+            continue;
+        }
+        connection->server = self;
+        connection->socket = socket;
+        __atomic_add_fetch(&self->active, 1, __ATOMIC_RELAXED);
+        if (0 != pthread_create(&thread, NULL, serve, connection)) {
+            __atomic_sub_fetch(&self->active, 1, __ATOMIC_RELAXED);
+            free(connection);
+            close(socket);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+struct LoopbackServer *LoopbackServer_start(const bool keepAlive) {
+    struct LoopbackServer *self = calloc(1, sizeof(*self));
+    if (NULL == self) {
+        return NULL;
+    }
+    memset(filler, 'x', sizeof(filler));
+    self->keepAlive = keepAlive;
+    self->socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (self->socket < 0) {
+        free(self);
+        return NULL;
+    }
+
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    if (0 != bind(self->socket, (struct sockaddr *) &address, sizeof(address)) ||
+        0 != listen(self->socket, 128) ||
+        0 != getsockname(self->socket, (struct sockaddr *) &address, &addressLength) ||
+        0 != pthread_create(&self->acceptor, NULL, acceptConnections, self)) {
+        close(self->socket);
+        free(self);
+        return NULL;
+    }
+    self->port = ntohs(address.sin_port);
+    return self;
+}
+
+unsigned short LoopbackServer_getPort(const struct LoopbackServer *self) {
+    assert(self);
+    return self->port;
+}
+
+size_t LoopbackServer_getRequests(const struct LoopbackServer *self) {
+    assert(self);
+    return __atomic_load_n(&self->requests, __ATOMIC_RELAXED);
+}
+
+size_t LoopbackServer_getConnections(const struct LoopbackServer *self) {
+    assert(self);
+    return __atomic_load_n(&self->connections, __ATOMIC_RELAXED);
+}
+
+void LoopbackServer_stop(struct LoopbackServer *self) {
+    assert(self);
+    __atomic_store_n(&self->stopping, true, __ATOMIC_RELEASE);
+    shutdown(self->socket, SHUT_RDWR);
+    pthread_join(self->acceptor, NULL);
+    close(self->socket);
+    // connections notice the server is stopping within a poll interval
+    while (__atomic_load_n(&self->active, __ATOMIC_ACQUIRE) > 0) {
+        usleep(1000);
+    }
+    free(self);
+}
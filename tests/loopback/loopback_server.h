@@ -0,0 +1,109 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#if !(defined(__GNUC__) || defined(__clang__))
+#define __attribute__(...)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A minimal HTTP/1.1 server listening on 127.0.0.1, meant to stand in for real servers in benchmarks and tests.
+ *
+ * Every connection is served by its own thread. Request bodies are read and discarded, GET /bytes/<n> (or any other
+ * method on the same path) is answered with n bytes of body, any other path with an empty body.
+ * GET /cache/<n> is answered with a 16 bytes body cacheable for n seconds, along with an ETag that makes requests
+ * carrying a matching If-None-Match be answered with 304 Not Modified, and varying on the Accept header; directives
+ * following n, as in /cache/0,stale-if-error=60, are appended to its Cache-Control header, those following a
+ * semicolon, as in /cache/0;no-store, only to the one of 304 responses. 304 responses carry X-Revalidated: true.
+ * GET /expires/<n> is answered like /cache/<n>, but with Date and Expires headers n seconds apart and a Last-Modified
+ * header validated through If-Modified-Since instead.
+ * GET /age/<n> is answered like /cache/60, along with an Age header of n seconds.
+ * GET /redirect/<code>/<path> redirects to /<path> with status code, one of 301, 302, 307 and 308 falling back to 302,
+ * cacheable for 60 seconds.
+ * GET /delay/<n> is answered with a 16 bytes body after n milliseconds.
+ * GET /stall/<n> is answered with its headers right away and a 16 bytes body after n milliseconds; requests carrying a
+ * body on the same path wait n milliseconds more before the body starts being read.
+ */
+struct LoopbackServer;
+
+/**
+ * Starts a server on an ephemeral port.
+ *
+ * @param keepAlive Whether connections are kept open across requests, if false each response closes its connection.
+ */
+extern struct LoopbackServer *
+LoopbackServer_start(bool keepAlive)
+__attribute__((__warn_unused_result__));
+
+/**
+ * Returns the port the server is listening on.
+ *
+ * @attention self must not be NULL.
+ */
+extern unsigned short
+LoopbackServer_getPort(const struct LoopbackServer *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the number of requests served so far.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+LoopbackServer_getRequests(const struct LoopbackServer *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Returns the number of connections accepted so far.
+ *
+ * @attention self must not be NULL.
+ */
+extern size_t
+LoopbackServer_getConnections(const struct LoopbackServer *self)
+__attribute__((__warn_unused_result__, __nonnull__));
+
+/**
+ * Stops the server closing every connection and frees memory.
+ *
+ * @attention self must not be NULL.
+ */
+extern void
+LoopbackServer_stop(struct LoopbackServer *self)
+__attribute__((__nonnull__));
+
+#ifdef __cplusplus
+}
+#endif
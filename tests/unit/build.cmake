@@ -1,14 +1,68 @@
+add_library(feature-alligator ${CMAKE_CURRENT_LIST_DIR}/features/alligator.h ${CMAKE_CURRENT_LIST_DIR}/features/alligator.c)
+target_link_libraries(feature-alligator PRIVATE http alligator Threads::Threads traits-unit)
+
+add_library(feature-atom ${CMAKE_CURRENT_LIST_DIR}/features/atom.h ${CMAKE_CURRENT_LIST_DIR}/features/atom.c)
+target_link_libraries(feature-atom PRIVATE http Threads::Threads traits-unit)
+
+add_library(feature-http ${CMAKE_CURRENT_LIST_DIR}/features/http.h ${CMAKE_CURRENT_LIST_DIR}/features/http.c)
+target_link_libraries(feature-http PRIVATE http loopback-server Threads::Threads traits-unit)
+
+add_library(feature-http-allocations ${CMAKE_CURRENT_LIST_DIR}/features/http_allocations.h ${CMAKE_CURRENT_LIST_DIR}/features/http_allocations.c)
+target_link_libraries(feature-http-allocations PRIVATE http alligator loopback-server traits-unit)
+
+add_library(feature-http-cache ${CMAKE_CURRENT_LIST_DIR}/features/http_cache.h ${CMAKE_CURRENT_LIST_DIR}/features/http_cache.c)
+target_link_libraries(feature-http-cache PRIVATE http loopback-server traits-unit)
+
+add_library(feature-http-disk-cache ${CMAKE_CURRENT_LIST_DIR}/features/http_disk_cache.h ${CMAKE_CURRENT_LIST_DIR}/features/http_disk_cache.c)
+target_link_libraries(feature-http-disk-cache PRIVATE http loopback-server traits-unit)
+
 add_library(feature-http-fire-result ${CMAKE_CURRENT_LIST_DIR}/features/http_fire_result.h ${CMAKE_CURRENT_LIST_DIR}/features/http_fire_result.c)
 target_link_libraries(feature-http-fire-result PRIVATE http traits-unit)
 
+add_library(feature-http-hooks ${CMAKE_CURRENT_LIST_DIR}/features/http_hooks.h ${CMAKE_CURRENT_LIST_DIR}/features/http_hooks.c)
+target_link_libraries(feature-http-hooks PRIVATE http loopback-server traits-unit)
+
+add_library(feature-http-mapped-text ${CMAKE_CURRENT_LIST_DIR}/features/http_mapped_text.h ${CMAKE_CURRENT_LIST_DIR}/features/http_mapped_text.c)
+target_link_libraries(feature-http-mapped-text PRIVATE http alligator loopback-server traits-unit)
+
 add_library(feature-http-maybe-text ${CMAKE_CURRENT_LIST_DIR}/features/http_maybe_text.h ${CMAKE_CURRENT_LIST_DIR}/features/http_maybe_text.c)
 target_link_libraries(feature-http-maybe-text PRIVATE http traits-unit)
 
+add_library(feature-http-metrics ${CMAKE_CURRENT_LIST_DIR}/features/http_metrics.h ${CMAKE_CURRENT_LIST_DIR}/features/http_metrics.c)
+target_link_libraries(feature-http-metrics PRIVATE http traits-unit)
+
+add_library(feature-http-request ${CMAKE_CURRENT_LIST_DIR}/features/http_request.h ${CMAKE_CURRENT_LIST_DIR}/features/http_request.c)
+target_link_libraries(feature-http-request PRIVATE http loopback-server traits-unit)
+
+add_library(feature-http-response ${CMAKE_CURRENT_LIST_DIR}/features/http_response.h ${CMAKE_CURRENT_LIST_DIR}/features/http_response.c)
+target_link_libraries(feature-http-response PRIVATE http alligator loopback-server traits-unit)
+
+add_library(feature-http-rope ${CMAKE_CURRENT_LIST_DIR}/features/http_rope.h ${CMAKE_CURRENT_LIST_DIR}/features/http_rope.c)
+target_link_libraries(feature-http-rope PRIVATE http traits-unit)
+
+add_library(feature-http-shared-cache ${CMAKE_CURRENT_LIST_DIR}/features/http_shared_cache.h ${CMAKE_CURRENT_LIST_DIR}/features/http_shared_cache.c)
+target_link_libraries(feature-http-shared-cache PRIVATE http loopback-server traits-unit)
+
+add_library(feature-http-shared-text ${CMAKE_CURRENT_LIST_DIR}/features/http_shared_text.h ${CMAKE_CURRENT_LIST_DIR}/features/http_shared_text.c)
+target_link_libraries(feature-http-shared-text PRIVATE http traits-unit)
+
+add_library(feature-http-single-flight ${CMAKE_CURRENT_LIST_DIR}/features/http_single_flight.h ${CMAKE_CURRENT_LIST_DIR}/features/http_single_flight.c)
+target_link_libraries(feature-http-single-flight PRIVATE http loopback-server traits-unit)
+
+add_library(feature-http-slow-log ${CMAKE_CURRENT_LIST_DIR}/features/http_slow_log.h ${CMAKE_CURRENT_LIST_DIR}/features/http_slow_log.c)
+target_link_libraries(feature-http-slow-log PRIVATE http traits-unit)
+
+add_library(feature-http-trace ${CMAKE_CURRENT_LIST_DIR}/features/http_trace.h ${CMAKE_CURRENT_LIST_DIR}/features/http_trace.c)
+target_link_libraries(feature-http-trace PRIVATE http traits-unit)
+
+add_library(feature-text ${CMAKE_CURRENT_LIST_DIR}/features/text.h ${CMAKE_CURRENT_LIST_DIR}/features/text.c)
+target_link_libraries(feature-text PRIVATE http traits-unit)
+
 add_library(fixtures ${CMAKE_CURRENT_LIST_DIR}/fixtures.h ${CMAKE_CURRENT_LIST_DIR}/fixtures.c)
 target_link_libraries(fixtures PRIVATE http traits-unit)
 
 add_executable(describe ${CMAKE_CURRENT_LIST_DIR}/describe.c)
-target_link_libraries(describe PRIVATE traits-unit fixtures feature-http-fire-result feature-http-maybe-text)
+target_link_libraries(describe PRIVATE traits-unit fixtures feature-alligator feature-atom feature-http feature-http-allocations feature-http-cache feature-http-disk-cache feature-http-fire-result feature-http-hooks feature-http-mapped-text feature-http-maybe-text feature-http-metrics feature-http-request feature-http-response feature-http-rope feature-http-shared-cache feature-http-shared-text feature-http-single-flight feature-http-slow-log feature-http-trace feature-text)
 
 add_test(describe describe)
 enable_testing()
@@ -28,13 +28,107 @@
 
 #include <traits-unit/traits-unit.h>
 #include <unit/fixtures.h>
+#include <unit/features/alligator.h>
+#include <unit/features/atom.h>
+#include <unit/features/http.h>
+#include <unit/features/http_allocations.h>
+#include <unit/features/http_cache.h>
+#include <unit/features/http_disk_cache.h>
 #include <unit/features/http_fire_result.h>
+#include <unit/features/http_hooks.h>
+#include <unit/features/http_mapped_text.h>
 #include <unit/features/http_maybe_text.h>
+#include <unit/features/http_metrics.h>
+#include <unit/features/http_request.h>
+#include <unit/features/http_response.h>
+#include <unit/features/http_rope.h>
+#include <unit/features/http_shared_cache.h>
+#include <unit/features/http_shared_text.h>
+#include <unit/features/http_single_flight.h>
+#include <unit/features/http_slow_log.h>
+#include <unit/features/http_trace.h>
+#include <unit/features/text.h>
 
 Describe("Http",
+         Trait("Alligator",
+               Run(Alligator_setAllocator),
+               Run(Alligator_threadCacheAllocator),
+               Run(Alligator_getStats),
+               Run(Alligator_getCounters)),
+         Trait("Atom",
+               Run(Atom_fromBytes),
+               Run(Atom_find)),
+         Trait("Http",
+               Run(Http_terminate),
+               Run(Http_getEmptyString)),
+         Trait("HttpAllocations",
+               Run(HttpRequest_fireAllocations),
+               Run(HttpResponse_bodyAllocations)),
+         Trait("HttpCache",
+               Run(Http_setCacheCapacity),
+               Run(HttpCache_fire),
+               Run(HttpCache_store),
+               Run(HttpCache_staleWhileRevalidate),
+               Run(HttpCache_staleIfError),
+               Run(Http_setCacheRefreshAhead),
+               Run(HttpCache_validators),
+               Run(HttpCacheEntry_revalidate),
+               Run(HttpCache_redirect)),
+         Trait("HttpDiskCache",
+               Run(Http_openDiskCache),
+               Run(HttpDiskCache_recover),
+               Run(HttpDiskCache_evict)),
          Trait("Http_FireResult",
                Run(Http_FireResult_ok, RequestFixture),
                Run(Http_FireResult_error)),
+         Trait("HttpHooks",
+               Run(Http_registerHooks),
+               Run(Http_registerHooks_lifecycle)),
+         Trait("HttpMappedText",
+               Run(HttpMappedText_fromFile),
+               Run(Http_setMappedBodyThreshold)),
          Trait("Http_MaybeText",
                Run(Http_MaybeText_new)),
+         Trait("HttpMetrics",
+               Run(HttpMetrics_record),
+               Run(Http_exportMetrics),
+               Benchmark(HttpMetrics_recordCost)),
+         Trait("HttpRequest",
+               Run(HttpRequest_releaseBodyAfterFire),
+               Run(HttpRequest_releaseRopeAfterFire),
+               Run(HttpRequestBuilder_setTimeouts),
+               Run(HttpRequest_timeouts),
+               Run(HttpRequest_stall),
+               Run(HttpRequestBuilder_setKeepAlive)),
+         Trait("HttpResponse",
+               Run(HttpResponse_compact),
+               Run(HttpResponse_getMemoryUsage),
+               Run(HttpResponse_getTimings)),
+         Trait("HttpRope",
+               Run(HttpRope_append),
+               Run(HttpRope_read)),
+         Trait("HttpSharedCache",
+               Run(Http_openSharedCache),
+               Run(HttpSharedCache_named),
+               Run(HttpSharedCache_overwrite),
+               Run(HttpSharedCache_concurrent)),
+         Trait("HttpSharedText",
+               Run(HttpSharedText_new),
+               Run(HttpResponse_shareBody)),
+         Trait("HttpSingleFlight",
+               Run(Http_setSingleFlight),
+               Run(HttpSingleFlight_fire),
+               Run(HttpFlight_land),
+               Run(HttpFlight_await)),
+         Trait("HttpSlowLog",
+               Run(HttpSlowLog_record),
+               Run(Http_setSlowRequestSampleRate)),
+         Trait("HttpTrace",
+               Run(Http_setTracing),
+               Run(Http_dumpTrace)),
+         Trait("Text",
+               Run(Text_quoted),
+               Run(Text_trim),
+               Run(Text_lower),
+               Run(Text_equalsIgnoreCase)),
 )
@@ -0,0 +1,272 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <traits/traits.h>
+#include <alligator/alligator.h>
+#include <unit/features/alligator.h>
+
+struct Recorder {
+    size_t mallocs;
+    size_t frees;
+};
+
+static void *recorderMalloc(void *context, size_t size) {
+    ((struct Recorder *) context)->mallocs++;
+    return Alligator_systemAllocator().malloc(NULL, size);
+}
+
+static void *recorderCalloc(void *context, size_t numberOfMembers, size_t memberSize) {
+    ((struct Recorder *) context)->mallocs++;
+    return Alligator_systemAllocator().calloc(NULL, numberOfMembers, memberSize);
+}
+
+static void *recorderRealloc(void *context, void *ptr, size_t newSize) {
+    ((struct Recorder *) context)->mallocs++;
+    return Alligator_systemAllocator().realloc(NULL, ptr, newSize);
+}
+
+static void recorderFree(void *context, void *ptr) {
+    ((struct Recorder *) context)->frees += NULL != ptr;
+    Alligator_systemAllocator().free(NULL, ptr);
+}
+
+static void *freeOnOtherThread(void *ptr) {
+    Alligator_free(ptr);
+    return NULL;
+}
+
+Feature(Alligator_setAllocator) {
+    struct Recorder recorder = {0};
+    const struct Alligator_Allocator allocator = {
+            .malloc=recorderMalloc,
+            .calloc=recorderCalloc,
+            .realloc=recorderRealloc,
+            .free=recorderFree,
+            .context=&recorder,
+    };
+
+    const struct Alligator_Allocator previous = Alligator_setAllocator(allocator);
+    assert_equal(previous.malloc, Alligator_systemAllocator().malloc);
+    assert_equal(Alligator_getAllocator().context, &recorder);
+
+    Text sut = Text_fromLiteral("routed");
+    Text_delete(sut);
+    assert_true(recorder.mallocs > 0);
+    assert_equal(recorder.mallocs, recorder.frees);
+
+    // the allocator can not be changed once memory has been allocated
+    const size_t counter = traits_unit_get_wrapped_signals_counter();
+    traits_unit_wraps(SIGABRT) {
+        (void) Alligator_setAllocator(previous);
+    }
+    assert_equal(counter + 1, traits_unit_get_wrapped_signals_counter());
+    assert_equal(Alligator_getAllocator().context, &recorder);
+}
+
+Feature(Alligator_threadCacheAllocator) {
+    Alligator_setAllocator(Alligator_threadCacheAllocator());
+
+    {
+        // freed blocks are served again to requests of the same size class
+        void *first = Option_unwrap(Alligator_malloc(20));
+        Alligator_free(first);
+        void *second = Option_unwrap(Alligator_malloc(32));
+        assert_equal(first, second);
+        Alligator_free(second);
+    }
+
+    {
+        // realloc keeps the contents across classes and past the cacheable sizes
+        char *sut = Option_unwrap(Alligator_malloc(8));
+        memcpy(sut, "content", 8);
+        sut = Option_unwrap(Alligator_realloc(sut, 16));
+        assert_string_equal(sut, "content");
+        sut = Option_unwrap(Alligator_realloc(sut, 1000));
+        assert_string_equal(sut, "content");
+        sut = Option_unwrap(Alligator_realloc(sut, ALLIGATOR_THREAD_CACHE_MAX_SIZE * 4));
+        memset(sut + 8, 'x', ALLIGATOR_THREAD_CACHE_MAX_SIZE * 4 - 8);
+        sut = Option_unwrap(Alligator_realloc(sut, ALLIGATOR_THREAD_CACHE_MAX_SIZE * 8));
+        assert_string_equal(sut, "content");
+        sut = Option_unwrap(Alligator_realloc(sut, 4));
+        assert_equal(0, memcmp(sut, "cont", 4));
+        Alligator_free(sut);
+    }
+
+    {
+        unsigned char *sut = Option_unwrap(Alligator_calloc(64, 3));
+        for (size_t i = 0; i < 64 * 3; i++) {
+            assert_equal(0, sut[i]);
+        }
+        Alligator_free(sut);
+    }
+
+    {
+        // more frees than the cache depth go back to the system allocator
+        void *blocks[ALLIGATOR_THREAD_CACHE_DEPTH * 2];
+        for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+            blocks[i] = Option_unwrap(Alligator_malloc(100));
+        }
+        for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+            Alligator_free(blocks[i]);
+        }
+    }
+
+    {
+        // blocks can be freed on any thread
+        pthread_t thread;
+        void *sut = Option_unwrap(Alligator_malloc(64));
+        assert_equal(0, pthread_create(&thread, NULL, freeOnOtherThread, sut));
+        assert_equal(0, pthread_join(thread, NULL));
+    }
+
+    {
+        const struct Alligator_Allocator allocator = Alligator_getAllocator();
+        void *sut = allocator.aligned_alloc(allocator.context, 256, 100);
+        assert_not_null(sut);
+        assert_equal(0, (uintptr_t) sut % 256);
+        allocator.free(allocator.context, sut);
+    }
+
+    Text sut = Text_fromLiteral("cached");
+    sut = Text_appendFormat(&sut, " %d", 42);
+    assert_string_equal(sut, "cached 42");
+    Text_delete(sut);
+}
+
+static const struct Alligator_TagStats *findTag(const struct Alligator_Stats *stats, const char *tag) {
+    for (size_t i = 0; i < stats->tagsLength; i++) {
+        if (stats->tags[i].tag && 0 == strcmp(stats->tags[i].tag, tag)) {
+            return &stats->tags[i];
+        }
+    }
+    return NULL;
+}
+
+Feature(Alligator_getStats) {
+    static struct Alligator_Allocator system;
+    system = Alligator_systemAllocator();
+    Alligator_setAllocator(Alligator_trackingAllocator(&system));
+
+    const char *previous = Alligator_enterTag("Test");
+    void *small = Option_unwrap(Alligator_malloc(10));
+    void *large = Option_unwrap(Alligator_malloc(1000));
+    {
+        // the outermost tag wins
+        const char *nested = Alligator_enterTag("Nested");
+        assert_string_equal(nested, "Test");
+        Text text = Text_withCapacity(100);
+        Alligator_exitTag(nested);
+        Text_delete(text);
+    }
+    Alligator_exitTag(previous);
+    large = Option_unwrap(Alligator_realloc(large, 2000));
+
+    struct Alligator_Stats stats = Alligator_getStats();
+    const struct Alligator_TagStats *test = findTag(&stats, "Test");
+    assert_not_null(test);
+    assert_null(findTag(&stats, "Nested"));
+    assert_equal(2, test->liveAllocations);
+    assert_equal(2010, test->liveBytes);
+    assert_equal(2010, test->peakBytes);
+    assert_true(stats.liveBytes >= 2010);
+    assert_true(stats.peakBytes >= stats.liveBytes);
+    assert_true(stats.sizeClasses[0].liveAllocations >= 1);
+    assert_true(stats.sizeClasses[7].liveAllocations >= 1);
+
+    Alligator_free(small);
+    Alligator_free(large);
+
+    // texts and requests are attributed to their own tags
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral("http://stats.test"));
+    Text body = Text_fromLiteral("body");
+    HttpRequestBuilder_setBody(builder, &body);
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+
+    stats = Alligator_getStats();
+    test = findTag(&stats, "Test");
+    assert_equal(0, test->liveAllocations);
+    assert_equal(0, test->liveBytes);
+    assert_equal(2010, test->peakBytes);
+    assert_not_null(findTag(&stats, "Text"));
+    assert_not_null(findTag(&stats, "Atom"));
+    assert_equal(1, findTag(&stats, "HttpRequest")->liveAllocations);
+
+    HttpRequest_delete(request);
+    stats = Alligator_getStats();
+    assert_equal(0, findTag(&stats, "HttpRequest")->liveBytes);
+
+    {
+        // memory freed on another thread lowers the live bytes of its tag
+        for (size_t i = 0; i < 3; i++) {
+            pthread_t thread;
+            previous = Alligator_enterTag("Handed over");
+            void *sut = Option_unwrap(Alligator_malloc(500));
+            Alligator_exitTag(previous);
+            assert_equal(0, pthread_create(&thread, NULL, freeOnOtherThread, sut));
+            assert_equal(0, pthread_join(thread, NULL));
+        }
+        stats = Alligator_getStats();
+        const struct Alligator_TagStats *handedOver = findTag(&stats, "Handed over");
+        assert_equal(0, handedOver->liveAllocations);
+        assert_equal(0, handedOver->liveBytes);
+        assert_equal(500, handedOver->peakBytes);
+        assert_equal(3, handedOver->allocations);
+    }
+
+    {
+        // snapshots do not interfere with each other
+        const struct Alligator_Stats first = Alligator_getStats();
+        previous = Alligator_enterTag("Test");
+        Alligator_free(Option_unwrap(Alligator_malloc(1)));
+        Alligator_exitTag(previous);
+        const struct Alligator_Stats other = Alligator_getStats();
+        const struct Alligator_Stats second = Alligator_getStats();
+        assert_true(other.timestamp >= first.timestamp);
+        assert_true(second.timestamp > first.timestamp);
+        assert_equal(1, findTag(&second, "Test")->allocations - findTag(&first, "Test")->allocations);
+    }
+}
+
+Feature(Alligator_getCounters) {
+    const struct Alligator_Counters before = Alligator_getCounters();
+    char *memory = Option_unwrap(Alligator_realloc(NULL, 16));
+    memory = Option_unwrap(Alligator_realloc(memory, 32));
+    memory = Option_unwrap(Alligator_realloc(memory, 64));
+    Alligator_free(memory);
+    const struct Alligator_Counters after = Alligator_getCounters();
+
+    // reallocations do not count as allocations, so that allocations and frees match when nothing leaks
+    assert_equal(1, after.allocations - before.allocations);
+    assert_equal(2, after.reallocations - before.reallocations);
+    assert_equal(1, after.frees - before.frees);
+    assert_equal(16 + 32 + 64, after.bytes - before.bytes);
+}
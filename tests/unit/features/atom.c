@@ -0,0 +1,76 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <atom/atom.h>
+#include <traits/traits.h>
+#include <unit/features/atom.h>
+
+#define THREADS 4
+#define ATOMS   1000
+
+static void *intern(void *argument) {
+    Atom *atoms = argument;
+    char buffer[32];
+    for (size_t i = 0; i < ATOMS; i++) {
+        const int length = snprintf(buffer, sizeof(buffer), "concurrent-atom-%zu", i);
+        atoms[i] = Atom_fromBytes(buffer, (size_t) length);
+    }
+    return NULL;
+}
+
+Feature(Atom_fromBytes) {
+    static Atom atoms[THREADS][ATOMS];
+    pthread_t threads[THREADS];
+    for (size_t i = 0; i < THREADS; i++) {
+        assert_equal(0, pthread_create(&threads[i], NULL, intern, atoms[i]));
+    }
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // threads interning the same bytes concurrently get the same atom
+    for (size_t i = 0; i < ATOMS; i++) {
+        for (size_t j = 1; j < THREADS; j++) {
+            assert_equal(atoms[0][i], atoms[j][i]);
+        }
+    }
+    assert_equal(atoms[0][42], Atom_fromLiteral("concurrent-atom-42"));
+    assert_string_equal("concurrent-atom-42", atoms[0][42]);
+    assert_equal(strlen("concurrent-atom-42"), Atom_length(atoms[0][42]));
+}
+
+Feature(Atom_find) {
+    assert_null(Atom_find("never-interned", strlen("never-interned")));
+    assert_null(Atom_find("never-interned", strlen("never-interned")));
+    const Atom atom = Atom_fromLiteral("interned");
+    assert_equal(atom, Atom_find("interned", strlen("interned")));
+    assert_null(Atom_find("intern", strlen("intern")));
+}
@@ -0,0 +1,116 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <traits/traits.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http.h>
+
+#define THREADS 4
+
+struct Worker {
+    Atom url;
+    sem_t fired;
+    sem_t resume;
+};
+
+static void fire(Atom url) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, url);
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(result));
+    HttpResponse_delete(Http_FireResult_unwrap(result));
+}
+
+static void *work(void *argument) {
+    struct Worker *worker = argument;
+    fire(worker->url);
+    fire(worker->url);
+    sem_post(&worker->fired);
+    sem_wait(&worker->resume);
+    fire(worker->url);
+    sem_post(&worker->fired);
+    return NULL;
+}
+
+Feature(Http_terminate) {
+    char buffer[64];
+    pthread_t thread;
+    struct Worker worker;
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(buffer, sizeof(buffer), "http://127.0.0.1:%hu/bytes/16", LoopbackServer_getPort(server));
+    worker.url = Atom_fromLiteral(buffer);
+    sem_init(&worker.fired, 0, 0);
+    sem_init(&worker.resume, 0, 0);
+
+    // every thread keeps its own connection alive
+    fire(worker.url);
+    fire(worker.url);
+    assert_equal(0, pthread_create(&thread, NULL, work, &worker));
+    sem_wait(&worker.fired);
+    assert_equal(2, LoopbackServer_getConnections(server));
+    assert_equal(4, LoopbackServer_getRequests(server));
+
+    // terminating closes the connections of every thread, the module can be initialized again
+    Http_terminate();
+    Http_initialize();
+    sem_post(&worker.resume);
+    sem_wait(&worker.fired);
+    fire(worker.url);
+    assert_equal(4, LoopbackServer_getConnections(server));
+    assert_equal(6, LoopbackServer_getRequests(server));
+
+    // handles of exited threads are freed by the threads themselves
+    pthread_join(thread, NULL);
+    sem_destroy(&worker.fired);
+    sem_destroy(&worker.resume);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+static void *getEmptyString(void *argument) {
+    (void) argument;
+    return (void *) Http_getEmptyString();
+}
+
+Feature(Http_getEmptyString) {
+    pthread_t threads[THREADS];
+    for (size_t i = 0; i < THREADS; i++) {
+        assert_equal(0, pthread_create(&threads[i], NULL, getEmptyString, NULL));
+    }
+    for (size_t i = 0; i < THREADS; i++) {
+        void *emptyString = NULL;
+        pthread_join(threads[i], &emptyString);
+        assert_equal(Http_getEmptyString(), emptyString);
+    }
+    assert_true(Text_isEmpty(Http_getEmptyString()));
+}
@@ -0,0 +1,115 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <string.h>
+#include <traits/traits.h>
+#include <alligator/alligator.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_allocations.h>
+
+/*
+ * Upper bounds on the allocations performed through alligator by the calling thread.
+ * Raise them only when the extra allocations are deliberate: they are here to catch accidental copies.
+ */
+#define REQUEST_MAX_ALLOCATIONS     2
+#define REQUEST_MAX_BYTES           128
+#define RESPONSE_MAX_ALLOCATIONS    4
+#define RESPONSE_MAX_OVERHEAD       512
+
+#define REQUESTS                    16
+
+struct Usage {
+    struct Alligator_Counters request;
+    struct Alligator_Counters response;
+    struct Alligator_Counters cycle;
+};
+
+static struct Alligator_Counters difference(struct Alligator_Counters before, struct Alligator_Counters after) {
+    return (struct Alligator_Counters) {
+            .allocations=after.allocations - before.allocations,
+            .reallocations=after.reallocations - before.reallocations,
+            .frees=after.frees - before.frees,
+            .bytes=after.bytes - before.bytes,
+    };
+}
+
+static struct Usage get(Atom url, size_t bodySize) {
+    const struct Alligator_Counters start = Alligator_getCounters();
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, url);
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    const struct Alligator_Counters built = Alligator_getCounters();
+
+    Http_FireResult result = HttpRequest_fire(&request);
+    const struct Alligator_Counters fired = Alligator_getCounters();
+    assert_true(Http_FireResult_isOk(result));
+
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    assert_equal(HTTP_STATUS_OK, HttpResponse_getStatus(response));
+    assert_equal(bodySize, Text_length(HttpResponse_getBody(response)));
+    HttpResponse_delete(response);
+    const struct Alligator_Counters end = Alligator_getCounters();
+
+    return (struct Usage) {
+            .request=difference(start, built),
+            .response=difference(built, fired),
+            .cycle=difference(start, end),
+    };
+}
+
+static void assertBounded(size_t bodySize) {
+    char buffer[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(buffer, sizeof(buffer), "http://127.0.0.1:%hu/bytes/%zu", LoopbackServer_getPort(server), bodySize);
+    const Atom url = Atom_fromBytes(buffer, strlen(buffer));
+
+    // the first request pays for the per-thread state: handles, metrics shard, connection
+    (void) get(url, bodySize);
+
+    for (size_t i = 0; i < REQUESTS; i++) {
+        const struct Usage usage = get(url, bodySize);
+        assert_true(usage.request.allocations + usage.request.reallocations <= REQUEST_MAX_ALLOCATIONS);
+        assert_true(usage.request.bytes <= REQUEST_MAX_BYTES);
+        assert_true(usage.response.allocations + usage.response.reallocations <= RESPONSE_MAX_ALLOCATIONS);
+        assert_true(usage.response.bytes <= bodySize + RESPONSE_MAX_OVERHEAD);
+        assert_equal(usage.cycle.allocations, usage.cycle.frees);
+    }
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpRequest_fireAllocations) {
+    assertBounded(512);
+}
+
+Feature(HttpResponse_bodyAllocations) {
+    assertBounded(64 * 1024);
+}
@@ -0,0 +1,426 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <traits/traits.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_cache.h>
+
+static const struct HttpRequest *newRequest(enum HttpMethod method, const char *url, const char *headers) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(method, Atom_fromLiteral(url));
+    if (NULL != headers) {
+        HttpRequestBuilder_emplaceHeaders(builder, "%s", headers);
+    }
+    return HttpRequestBuilder_build(&builder);
+}
+
+static bool accepts(enum HttpMethod method, const char *headers) {
+    const struct HttpRequest *request = newRequest(method, "http://cache.test", headers);
+    const bool accepted = HttpCache_accepts(request);
+    HttpRequest_delete(request);
+    return accepted;
+}
+
+Feature(Http_setCacheCapacity) {
+    assert_equal(0, Http_getCacheCapacity());
+    assert_false(accepts(HTTP_METHOD_GET, NULL));
+
+    assert_equal(0, Http_setCacheCapacity(1024 * 1024));
+    assert_equal(1024 * 1024, Http_getCacheCapacity());
+    assert_true(accepts(HTTP_METHOD_GET, NULL));
+    assert_true(accepts(HTTP_METHOD_GET, "Accept: text/plain"));
+    assert_false(accepts(HTTP_METHOD_POST, NULL));
+    assert_false(accepts(HTTP_METHOD_GET, "Cache-Control: no-store"));
+    assert_false(accepts(HTTP_METHOD_GET, "If-None-Match: \"tag\""));
+    assert_false(accepts(HTTP_METHOD_GET, "Accept: text/plain\r\nRange: bytes=0-1"));
+
+    assert_equal(1024 * 1024, Http_setCacheCapacity(0));
+    assert_false(accepts(HTTP_METHOD_GET, NULL));
+}
+
+static const struct HttpResponse *get(const char *url, const char *headers) {
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, url, headers);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(result));
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    assert_equal(HTTP_STATUS_OK, HttpResponse_getStatus(response));
+    assert_string_equal("xxxxxxxxxxxxxxxx", HttpResponse_getBody(response));
+    assert_string_equal(url, HttpResponse_getUrl(response));
+    return response;
+}
+
+static void assertStats(size_t hits, size_t misses, size_t revalidations, size_t stores) {
+    const struct HttpCacheStats stats = Http_getCacheStats();
+    assert_equal(hits, stats.hits);
+    assert_equal(misses, stats.misses);
+    assert_equal(revalidations, stats.revalidations);
+    assert_equal(stores, stats.stores);
+}
+
+Feature(HttpCache_fire) {
+    char fresh[64], stale[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(fresh, sizeof(fresh), "http://127.0.0.1:%hu/cache/60", LoopbackServer_getPort(server));
+    snprintf(stale, sizeof(stale), "http://127.0.0.1:%hu/cache/0", LoopbackServer_getPort(server));
+    (void) Http_setCacheCapacity(1024 * 1024);
+
+    // fresh entries are served without contacting the server, as long as the Vary headers match
+    const struct HttpResponse *response = get(fresh, "Accept: text/plain");
+    HttpResponse_delete(response);
+    assertStats(0, 1, 0, 1);
+    response = get(fresh, "Accept: text/plain");
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    assert_true(Text_startsWith(HttpResponse_getHeaders(response), "HTTP/1.1 200 OK\r\n", 17));
+    HttpResponse_delete(response);
+    assertStats(1, 1, 0, 1);
+    response = get(fresh, "Accept: text/html");
+    HttpResponse_delete(response);
+    assertStats(1, 2, 0, 2);
+
+    // stale entries are revalidated with their ETag
+    response = get(stale, NULL);
+    HttpResponse_delete(response);
+    assertStats(1, 3, 0, 3);
+    response = get(stale, NULL);
+    assert_true(HttpResponse_getTimings(response).total > 0);
+    assert_true(Text_startsWith(HttpResponse_getHeaders(response), "HTTP/1.1 200 OK\r\n", 17));
+    HttpResponse_delete(response);
+    assertStats(1, 3, 1, 4);
+
+    // requests asking for no-cache revalidate fresh entries too
+    response = get(fresh, "Accept: text/plain\r\nCache-Control: no-cache");
+    HttpResponse_delete(response);
+    assertStats(1, 3, 2, 5);
+    assert_equal(3, Http_getCacheStats().entries);
+
+    (void) Http_setCacheCapacity(0);
+    assert_equal(0, Http_getCacheStats().entries);
+    assert_equal(0, Http_getCacheStats().bytes);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+static void store(size_t index, const char *cacheControl, size_t bodySize) {
+    char url[64];
+    snprintf(url, sizeof(url), "http://cache.test/%zu", index);
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, url, NULL);
+    struct HttpResponseBuilder *builder = HttpResponseBuilder_new(&request);
+    HttpResponseBuilder_emplaceHeaders(builder, "HTTP/1.1 200 OK\r\nCache-Control: %s\r\n\r\n", cacheControl);
+    Text body = Text_withCapacity(bodySize);
+    memset(body, 'x', bodySize);
+    Text_setLength(body, bodySize);
+    HttpResponseBuilder_setBody(builder, &body);
+    const struct HttpResponse *response = HttpResponseBuilder_build(&builder);
+    HttpCache_store(response);
+    HttpResponse_delete(response);
+}
+
+static const struct HttpCacheEntry *lookup(size_t index) {
+    char url[64];
+    snprintf(url, sizeof(url), "http://cache.test/%zu", index);
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, url, NULL);
+    const struct HttpCacheEntry *entry = HttpCache_lookup(request);
+    HttpRequest_delete(request);
+    return entry;
+}
+
+Feature(HttpCache_store) {
+    const size_t entries = 256;
+    const size_t capacity = HTTP_CACHE_SHARDS * 4096;
+    (void) Http_setCacheCapacity(capacity);
+
+    // responses forbidding storage, or lacking both lifetime and validators, are not stored
+    store(0, "no-store, max-age=60", 16);
+    store(1, "no-cache", 16);
+    assert_null(lookup(0));
+    assert_null(lookup(1));
+    assert_equal(0, Http_getCacheStats().stores);
+
+    // shards evict their least recently used entries once they exceed their share of the capacity
+    for (size_t i = 0; i < entries; i++) {
+        store(i, "max-age=60", 1024);
+    }
+    struct HttpCacheStats stats = Http_getCacheStats();
+    assert_equal(entries, stats.stores);
+    assert_true(stats.evictions > 0);
+    assert_equal(entries, stats.entries + stats.evictions);
+    assert_true(stats.bytes <= capacity);
+
+    const struct HttpCacheEntry *entry = lookup(entries - 1);
+    assert_not_null(entry);
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, "http://cache.test", NULL);
+    assert_true(HttpCacheEntry_isFresh(entry, request));
+    const struct HttpResponse *response = HttpCacheEntry_respond(entry, &request);
+    assert_null(request);
+
+    // entries and the bodies they hand out outlive the cache
+    Http_clearCache();
+    assert_equal(0, Http_getCacheStats().entries);
+    assert_equal(1024, Text_length(HttpResponse_getBody(response)));
+    HttpResponse_delete(response);
+    HttpCacheEntry_release(entry);
+
+    // responses larger than a shard are not cached
+    store(0, "max-age=60", 4096);
+    assert_null(lookup(0));
+    (void) Http_setCacheCapacity(0);
+}
+
+// Waits for the background refreshes to revalidate as many entries.
+static void awaitRevalidations(size_t revalidations) {
+    for (size_t i = 0; i < 200 && Http_getCacheStats().revalidations < revalidations; i++) {
+        usleep(10 * 1000);
+    }
+    assert_equal(revalidations, Http_getCacheStats().revalidations);
+}
+
+Feature(HttpCache_staleWhileRevalidate) {
+    char url[96];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%hu/cache/0,stale-while-revalidate=60",
+             LoopbackServer_getPort(server));
+    (void) Http_setCacheCapacity(1024 * 1024);
+    HttpResponse_delete(get(url, NULL));
+
+    // stale entries are served right away while refreshed in the background
+    const struct HttpResponse *response = get(url, NULL);
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    HttpResponse_delete(response);
+    awaitRevalidations(1);
+    struct HttpCacheStats stats = Http_getCacheStats();
+    assert_equal(1, stats.staleHits);
+    assert_equal(1, stats.refreshes);
+    assert_equal(2, LoopbackServer_getRequests(server));
+
+    // unless the request asks for a fresh response
+    response = get(url, "Cache-Control: no-cache");
+    assert_true(HttpResponse_getTimings(response).total > 0);
+    HttpResponse_delete(response);
+    awaitRevalidations(2);
+    assert_equal(1, Http_getCacheStats().staleHits);
+
+    (void) Http_setCacheCapacity(0);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpCache_staleIfError) {
+    char tolerant[96], strict[96], uncached[96];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(tolerant, sizeof(tolerant), "http://127.0.0.1:%hu/cache/0,stale-if-error=60",
+             LoopbackServer_getPort(server));
+    snprintf(strict, sizeof(strict), "http://127.0.0.1:%hu/cache/0,stale-if-error=60,must-revalidate",
+             LoopbackServer_getPort(server));
+    snprintf(uncached, sizeof(uncached), "http://127.0.0.1:%hu/cache/0,no-cache,stale-if-error=60",
+             LoopbackServer_getPort(server));
+    (void) Http_setCacheCapacity(1024 * 1024);
+    HttpResponse_delete(get(tolerant, NULL));
+    HttpResponse_delete(get(strict, NULL));
+    HttpResponse_delete(get(uncached, NULL));
+    LoopbackServer_stop(server);
+
+    // stale entries answer in place of errors, unless they must be revalidated
+    const struct HttpResponse *response = get(tolerant, NULL);
+    assert_true(Text_startsWith(HttpResponse_getHeaders(response), "HTTP/1.1 200 OK\r\n", 17));
+    HttpResponse_delete(response);
+    assert_equal(1, Http_getCacheStats().staleHits);
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, strict, NULL);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isError(result));
+    HttpRequest_delete(request);
+    request = newRequest(HTTP_METHOD_GET, uncached, NULL);
+    assert_true(Http_FireResult_isError(HttpRequest_fire(&request)));
+    HttpRequest_delete(request);
+
+    // nor when the request asks for a response validated by the server
+    request = newRequest(HTTP_METHOD_GET, tolerant, "Cache-Control: no-cache");
+    assert_true(Http_FireResult_isError(HttpRequest_fire(&request)));
+    HttpRequest_delete(request);
+    assert_equal(1, Http_getCacheStats().staleHits);
+    assert_equal(0, Http_getCacheStats().refreshes);
+
+    (void) Http_setCacheCapacity(0);
+    Http_terminate();
+}
+
+Feature(Http_setCacheRefreshAhead) {
+    char url[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%hu/cache/60", LoopbackServer_getPort(server));
+    (void) Http_setCacheCapacity(1024 * 1024);
+    HttpResponse_delete(get(url, NULL));
+    HttpResponse_delete(get(url, NULL));
+    assert_equal(0, Http_getCacheStats().refreshes);
+
+    // fresh entries about to expire are refreshed in the background when hit
+    assert_equal(0, Http_getCacheRefreshAhead());
+    assert_equal(0, Http_setCacheRefreshAhead(120));
+    assert_equal(120, Http_getCacheRefreshAhead());
+    const struct HttpResponse *response = get(url, NULL);
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    HttpResponse_delete(response);
+    awaitRevalidations(1);
+    struct HttpCacheStats stats = Http_getCacheStats();
+    assert_equal(2, stats.hits);
+    assert_equal(0, stats.staleHits);
+    assert_equal(1, stats.refreshes);
+    assert_equal(2, LoopbackServer_getRequests(server));
+
+    assert_equal(120, Http_setCacheRefreshAhead(0));
+    (void) Http_setCacheCapacity(0);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+static bool hasHeader(const struct HttpResponse *response, const char *header) {
+    return NULL != strstr(HttpResponse_getHeaders(response), header);
+}
+
+Feature(HttpCache_validators) {
+    char expires[64], expired[64], young[64], old[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(expires, sizeof(expires), "http://127.0.0.1:%hu/expires/60", LoopbackServer_getPort(server));
+    snprintf(expired, sizeof(expired), "http://127.0.0.1:%hu/expires/0", LoopbackServer_getPort(server));
+    snprintf(young, sizeof(young), "http://127.0.0.1:%hu/age/30", LoopbackServer_getPort(server));
+    snprintf(old, sizeof(old), "http://127.0.0.1:%hu/age/90", LoopbackServer_getPort(server));
+    (void) Http_setCacheCapacity(1024 * 1024);
+
+    // Expires sets the lifetime of responses without max-age
+    HttpResponse_delete(get(expires, NULL));
+    const struct HttpResponse *response = get(expires, NULL);
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    HttpResponse_delete(response);
+    assert_equal(1, LoopbackServer_getRequests(server));
+
+    // Age counts against max-age
+    HttpResponse_delete(get(young, NULL));
+    response = get(young, NULL);
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    HttpResponse_delete(response);
+    HttpResponse_delete(get(old, NULL));
+    response = get(old, NULL);
+    assert_true(HttpResponse_getTimings(response).total > 0);
+    assert_true(hasHeader(response, "X-Revalidated: true\r\n"));
+    HttpResponse_delete(response);
+    assertStats(2, 3, 1, 4);
+
+    // Last-Modified is validated through If-Modified-Since, the headers of 304 responses replace the stored ones
+    HttpResponse_delete(get(expired, NULL));
+    for (size_t i = 0; i < 2; i++) {
+        response = get(expired, NULL);
+        assert_true(Text_startsWith(HttpResponse_getHeaders(response), "HTTP/1.1 200 OK\r\n", 17));
+        assert_true(hasHeader(response, "Last-Modified: Mon, 01 Jan 2018 00:00:00 GMT\r\n"));
+        assert_true(hasHeader(response, "Content-Length: 16\r\n"));
+        const char *revalidated = strstr(HttpResponse_getHeaders(response), "X-Revalidated: true\r\n");
+        assert_not_null(revalidated);
+        assert_null(strstr(revalidated + 1, "X-Revalidated"));
+        HttpResponse_delete(response);
+    }
+    assertStats(2, 4, 3, 7);
+    assert_equal(7, LoopbackServer_getRequests(server));
+
+    (void) Http_setCacheCapacity(0);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpCacheEntry_revalidate) {
+    char url[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%hu/cache/0;no-store", LoopbackServer_getPort(server));
+    (void) Http_setCacheCapacity(1024 * 1024);
+    HttpResponse_delete(get(url, NULL));
+    assert_equal(1, Http_getCacheStats().entries);
+
+    // 304 responses forbidding to store the merged headers drop the stored response
+    const struct HttpResponse *response = get(url, NULL);
+    assert_true(hasHeader(response, "no-store"));
+    HttpResponse_delete(response);
+    assertStats(0, 1, 1, 1);
+    assert_equal(0, Http_getCacheStats().entries);
+    HttpResponse_delete(get(url, NULL));
+    assertStats(0, 2, 1, 2);
+
+    (void) Http_setCacheCapacity(0);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+static const struct HttpResponse *follow(const char *url, bool followLocation, enum HttpStatus status) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(url));
+    HttpRequestBuilder_setFollowLocation(builder, followLocation);
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(result));
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    assert_equal(status, HttpResponse_getStatus(response));
+    return response;
+}
+
+Feature(HttpCache_redirect) {
+    char found[64], moved[64], target[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(found, sizeof(found), "http://127.0.0.1:%hu/redirect/302/cache/60", LoopbackServer_getPort(server));
+    snprintf(moved, sizeof(moved), "http://127.0.0.1:%hu/redirect/301/cache/60", LoopbackServer_getPort(server));
+    snprintf(target, sizeof(target), "http://127.0.0.1:%hu/cache/60", LoopbackServer_getPort(server));
+    (void) Http_setCacheCapacity(1024 * 1024);
+
+    // followed redirections are not stored under the url they started from
+    const struct HttpResponse *response = follow(found, true, HTTP_STATUS_OK);
+    assert_string_equal(target, HttpResponse_getUrl(response));
+    HttpResponse_delete(response);
+    HttpResponse_delete(follow(found, false, HTTP_STATUS_FOUND));
+    assert_equal(0, Http_getCacheStats().stores);
+
+    // stored redirections answer requests not following them only
+    HttpResponse_delete(follow(moved, false, HTTP_STATUS_MOVED_PERMANENTLY));
+    assert_equal(1, Http_getCacheStats().stores);
+    response = follow(moved, true, HTTP_STATUS_OK);
+    assert_true(HttpResponse_getTimings(response).total > 0);
+    assert_string_equal(target, HttpResponse_getUrl(response));
+    HttpResponse_delete(response);
+    response = follow(moved, false, HTTP_STATUS_MOVED_PERMANENTLY);
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    HttpResponse_delete(response);
+    assert_equal(1, Http_getCacheStats().hits);
+    assert_equal(1, Http_getCacheStats().stores);
+
+    (void) Http_setCacheCapacity(0);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
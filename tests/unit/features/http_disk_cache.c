@@ -0,0 +1,240 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <traits/traits.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_disk_cache.h>
+
+#define CAPACITY    (1024 * 1024)
+
+static size_t countFiles(const char *directory, const char *suffix) {
+    size_t count = 0;
+    DIR *handle = opendir(directory);
+    assert_not_null(handle);
+    struct dirent *item;
+    while (NULL != (item = readdir(handle))) {
+        const size_t length = strlen(item->d_name), suffixLength = strlen(suffix);
+        count += length > suffixLength && 0 == strcmp(item->d_name + length - suffixLength, suffix);
+    }
+    closedir(handle);
+    return count;
+}
+
+static void removeDirectory(const char *directory) {
+    DIR *handle = opendir(directory);
+    assert_not_null(handle);
+    struct dirent *item;
+    while (NULL != (item = readdir(handle))) {
+        if ('.' != item->d_name[0]) {
+            Text path = Text_format("%s/%s", directory, item->d_name);
+            assert_equal(0, unlink(path));
+            Text_delete(path);
+        }
+    }
+    closedir(handle);
+    assert_equal(0, rmdir(directory));
+}
+
+static const struct HttpResponse *get(const char *url) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(url));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(result));
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    assert_equal(HTTP_STATUS_OK, HttpResponse_getStatus(response));
+    assert_string_equal("xxxxxxxxxxxxxxxx", HttpResponse_getBody(response));
+    return response;
+}
+
+Feature(Http_openDiskCache) {
+    char directory[] = "/tmp/http-disk-cache-XXXXXX", fresh[64], stale[64], dropped[64];
+    assert_not_null(mkdtemp(directory));
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(fresh, sizeof(fresh), "http://127.0.0.1:%hu/cache/60", LoopbackServer_getPort(server));
+    snprintf(stale, sizeof(stale), "http://127.0.0.1:%hu/cache/0", LoopbackServer_getPort(server));
+    snprintf(dropped, sizeof(dropped), "http://127.0.0.1:%hu/cache/0;no-store", LoopbackServer_getPort(server));
+    assert_false(Http_isDiskCacheOpen());
+
+    // the in-memory cache stays disabled: responses are stored on disk only
+    assert_true(Http_openDiskCache(directory, CAPACITY));
+    assert_true(Http_isDiskCacheOpen());
+    HttpResponse_delete(get(fresh));
+    HttpResponse_delete(get(stale));
+    assert_equal(2, Http_getDiskCacheStats().stores);
+    assert_equal(2, Http_getDiskCacheStats().entries);
+    assert_equal(2, countFiles(directory, ".entry"));
+    Http_closeDiskCache();
+    assert_false(Http_isDiskCacheOpen());
+    assert_equal(0, Http_getDiskCacheStats().entries);
+
+    // after a restart fresh responses are served from disk, stale ones are revalidated
+    assert_true(Http_openDiskCache(directory, CAPACITY));
+    assert_equal(2, Http_getDiskCacheStats().entries);
+    const struct HttpResponse *response = get(fresh);
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    assert_true(Text_startsWith(HttpResponse_getHeaders(response), "HTTP/1.1 200 OK\r\n", 17));
+    HttpResponse_delete(response);
+    response = get(stale);
+    assert_true(HttpResponse_getTimings(response).total > 0);
+    HttpResponse_delete(response);
+
+    const struct HttpCacheStats stats = Http_getCacheStats();
+    assert_equal(1, stats.hits);
+    assert_equal(2, stats.diskLoads);
+    assert_equal(1, stats.revalidations);
+    assert_equal(0, stats.entries);
+
+    // revalidations refresh the index in place without rewriting the responses
+    assert_equal(0, Http_getDiskCacheStats().stores);
+    assert_equal(2, countFiles(directory, ".entry"));
+
+    // unless the 304 response forbids storing them, then they are removed
+    HttpResponse_delete(get(dropped));
+    assert_equal(3, countFiles(directory, ".entry"));
+    HttpResponse_delete(get(dropped));
+    assert_equal(2, Http_getDiskCacheStats().entries);
+    assert_equal(2, countFiles(directory, ".entry"));
+
+    Http_closeDiskCache();
+    LoopbackServer_stop(server);
+    Http_terminate();
+    removeDirectory(directory);
+}
+
+static bool store(uint64_t key, size_t size) {
+    char *bytes = calloc(size, 1);
+    assert_not_null(bytes);
+    const struct iovec part = {.iov_base=bytes, .iov_len=size};
+    const bool stored = HttpDiskCache_store(key, 0, (struct HttpCacheFreshness) {.lifetime=60}, &part, 1);
+    free(bytes);
+    return stored;
+}
+
+static bool find(uint64_t key) {
+    struct HttpCacheFreshness freshness;
+    uint64_t variant;
+    size_t cursor = 0;
+    Text path = Text_new();
+    const bool found = HttpDiskCache_find(key, &cursor, &path, &variant, &freshness);
+    if (found) {
+        assert_equal(0, variant);
+        assert_equal(60, freshness.lifetime);
+        assert_equal(0, access(path, R_OK));
+    }
+    Text_delete(path);
+    return found;
+}
+
+Feature(HttpDiskCache_recover) {
+    char directory[] = "/tmp/http-disk-cache-XXXXXX";
+    assert_not_null(mkdtemp(directory));
+    assert_true(Http_openDiskCache(directory, CAPACITY));
+    for (uint64_t key = 1; key <= 3; key++) {
+        assert_true(store(key, 128));
+    }
+    Http_closeDiskCache();
+
+    // responses stored by a process that crashed survive, while leftovers of unfinished writes are removed
+    const pid_t child = fork();
+    assert_true(child >= 0);
+    if (0 == child) {
+        _exit(Http_openDiskCache(directory, CAPACITY) && store(4, 128) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    int status = 0;
+    assert_equal(child, waitpid(child, &status, 0));
+    assert_true(WIFEXITED(status) && EXIT_SUCCESS == WEXITSTATUS(status));
+    Text leftover = Text_format("%s/00000000000000ff.tmp", directory);
+    FILE *file = fopen(leftover, "w");
+    assert_not_null(file);
+    fclose(file);
+    Text_delete(leftover);
+
+    assert_true(Http_openDiskCache(directory, CAPACITY));
+    assert_equal(4, Http_getDiskCacheStats().entries);
+    assert_true(find(4));
+    assert_equal(0, countFiles(directory, ".tmp"));
+    Http_closeDiskCache();
+
+    // torn slots are discarded along with the files they referred to
+    Text path = Text_format("%s/index", directory);
+    const int fd = open(path, O_RDWR);
+    assert_true(fd >= 0);
+    char garbage[4096];
+    memset(garbage, 0xff, sizeof(garbage));
+    for (off_t offset = 64; pwrite(fd, garbage, sizeof(garbage), offset) > 0; offset += sizeof(garbage)) {
+        if (offset > 1024 * 1024) {
+            break;
+        }
+    }
+    close(fd);
+    Text_delete(path);
+    assert_true(Http_openDiskCache(directory, CAPACITY));
+    assert_equal(0, Http_getDiskCacheStats().entries);
+    assert_false(find(4));
+    assert_equal(0, countFiles(directory, ".entry"));
+    Http_closeDiskCache();
+    removeDirectory(directory);
+}
+
+Feature(HttpDiskCache_evict) {
+    char directory[] = "/tmp/http-disk-cache-XXXXXX";
+    assert_not_null(mkdtemp(directory));
+    assert_true(Http_openDiskCache(directory, 4096));
+    assert_false(store(1, 4097));
+
+    for (uint64_t key = 1; key <= 16; key++) {
+        assert_true(store(key, 1024));
+    }
+    struct HttpDiskCacheStats stats = Http_getDiskCacheStats();
+    for (size_t i = 0; i < 200 && stats.bytes > 4096; i++) {
+        usleep(10 * 1000);
+        stats = Http_getDiskCacheStats();
+    }
+    assert_equal(16, stats.stores);
+    assert_true(stats.bytes <= 4096);
+    assert_equal(16, stats.entries + stats.evictions);
+    assert_equal(stats.entries, countFiles(directory, ".entry"));
+    assert_true(find(16));
+
+    // storing a response again replaces it
+    assert_true(store(16, 512));
+    assert_equal(stats.entries, Http_getDiskCacheStats().entries);
+    assert_equal(stats.entries, countFiles(directory, ".entry"));
+
+    Http_closeDiskCache();
+    removeDirectory(directory);
+}
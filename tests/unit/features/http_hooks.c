@@ -0,0 +1,157 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <traits/traits.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_hooks.h>
+
+struct Calls {
+    size_t beforeSend;
+    size_t headersReceived;
+    size_t firstBodyByte;
+    size_t completed;
+    size_t failed;
+    const struct HttpRequest *request;
+    const struct HttpResponse *response;
+    enum HttpStatus status;
+    struct HttpTimings headersTimings;
+    struct HttpTimings bodyTimings;
+    struct HttpTimings timings;
+    Error error;
+};
+
+static void beforeSend(const struct HttpRequest *request, void *context) {
+    struct Calls *calls = context;
+    calls->beforeSend++;
+    calls->request = request;
+}
+
+static void headersReceived(const struct HttpRequest *request, enum HttpStatus status,
+                            const struct HttpTimings *timings, void *context) {
+    struct Calls *calls = context;
+    calls->headersReceived += calls->request == request ? 1 : 0;
+    calls->status = status;
+    calls->headersTimings = *timings;
+}
+
+static void firstBodyByte(const struct HttpRequest *request, const struct HttpTimings *timings, void *context) {
+    struct Calls *calls = context;
+    calls->firstBodyByte += calls->request == request ? 1 : 0;
+    calls->bodyTimings = *timings;
+    // hooks registered while in flight apply from the next request on
+    (void) Http_registerHooks((struct HttpHooks) {.context=NULL});
+}
+
+static void completed(const struct HttpRequest *request, const struct HttpResponse *response,
+                      const struct HttpTimings *timings, void *context) {
+    struct Calls *calls = context;
+    calls->completed += calls->request == request ? 1 : 0;
+    calls->response = response;
+    calls->timings = *timings;
+}
+
+static void failed(const struct HttpRequest *request, Error error, const struct HttpTimings *timings, void *context) {
+    struct Calls *calls = context;
+    (void) timings;
+    calls->failed += calls->request == request ? 1 : 0;
+    calls->error = error;
+}
+
+Feature(Http_registerHooks) {
+    struct Calls calls = {.beforeSend=0, .failed=0, .request=NULL, .response=NULL, .error=Ok};
+    const struct HttpHooks hooks = {.beforeSend=beforeSend, .failed=failed, .context=&calls};
+    const struct HttpHooks previous = Http_registerHooks(hooks);
+    assert_null(previous.beforeSend);
+    assert_null(previous.failed);
+
+    Http_initialize();
+    // nothing listens on port 1, the connection is refused right away
+    struct HttpRequestBuilder *requestBuilder = HttpRequestBuilder_new(HTTP_METHOD_GET,
+                                                                       Atom_fromLiteral("http://127.0.0.1:1"));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&requestBuilder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isError(result));
+
+    assert_equal(calls.beforeSend, 1);
+    assert_equal(calls.failed, 1);
+    assert_equal(calls.error, Http_FireResult_unwrapError(result));
+
+    const struct HttpHooks registered = Http_registerHooks(previous);
+    assert_equal(registered.context, &calls);
+    HttpRequest_delete(request);
+    Http_terminate();
+}
+
+Feature(Http_registerHooks_lifecycle) {
+    char url[64];
+    struct Calls calls = {.beforeSend=0, .completed=0, .failed=0, .request=NULL, .response=NULL, .error=Ok};
+    const struct HttpHooks hooks = {
+            .beforeSend=beforeSend, .headersReceived=headersReceived, .firstBodyByte=firstBodyByte,
+            .completed=completed, .failed=failed, .context=&calls
+    };
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%hu/delay/50", LoopbackServer_getPort(server));
+    const struct HttpHooks previous = Http_registerHooks(hooks);
+
+    struct HttpRequestBuilder *requestBuilder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(url));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&requestBuilder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(result));
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+
+    // every hook is called once, in order, with the timings known at that point (partial ones are measured apart)
+    assert_equal(1, calls.beforeSend);
+    assert_equal(1, calls.headersReceived);
+    assert_equal(1, calls.firstBodyByte);
+    assert_equal(1, calls.completed);
+    assert_equal(0, calls.failed);
+    assert_equal(HTTP_STATUS_OK, calls.status);
+    assert_equal(response, calls.response);
+    assert_true(calls.headersTimings.firstByte >= 50 * 1000);
+    assert_true(calls.headersTimings.total <= calls.bodyTimings.total);
+    assert_true(calls.timings.firstByte >= 50 * 1000);
+    assert_equal(HttpResponse_getTimings(response).total, calls.timings.total);
+    assert_equal(16, calls.timings.bytesDownloaded);
+    HttpResponse_delete(response);
+
+    // the first body byte hook has unregistered every hook
+    requestBuilder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(url));
+    request = HttpRequestBuilder_build(&requestBuilder);
+    Http_FireResult unhookedResult = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(unhookedResult));
+    HttpResponse_delete(Http_FireResult_unwrap(unhookedResult));
+    assert_equal(1, calls.beforeSend);
+    assert_equal(1, calls.completed);
+
+    (void) Http_registerHooks(previous);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
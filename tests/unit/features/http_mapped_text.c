@@ -0,0 +1,92 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <string.h>
+#include <traits/traits.h>
+#include <alligator/alligator.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_mapped_text.h>
+
+Feature(HttpMappedText_fromFile) {
+    FILE *file = tmpfile();
+    assert_not_null(file);
+    fputs("skipped content", file);
+    rewind(file);
+    assert_equal(0, fseek(file, 8, SEEK_SET));
+
+    const struct HttpSharedText *sut = HttpMappedText_fromFile(file, 7);
+    fclose(file);
+    assert_string_equal(HttpSharedText_get(sut), "content");
+    assert_equal(7, Text_length(HttpSharedText_get(sut)));
+
+    const struct HttpSharedText *other = HttpSharedText_retain(sut);
+    HttpSharedText_release(sut);
+    assert_string_equal(HttpSharedText_get(other), "content");
+    HttpSharedText_release(other);
+}
+
+Feature(Http_setMappedBodyThreshold) {
+    const size_t bodySize = 64 * 1024;
+    assert_equal(HTTP_MAPPED_BODY_DEFAULT_THRESHOLD, Http_setMappedBodyThreshold(bodySize));
+    assert_equal(bodySize, Http_getMappedBodyThreshold());
+
+    char buffer[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(buffer, sizeof(buffer), "http://127.0.0.1:%hu/bytes/0", LoopbackServer_getPort(server));
+
+    // the first request pays for the per-thread state
+    struct HttpRequestBuilder *warmup = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(buffer));
+    const struct HttpRequest *warmupRequest = HttpRequestBuilder_build(&warmup);
+    HttpResponse_delete(Http_FireResult_unwrap(HttpRequest_fire(&warmupRequest)));
+
+    snprintf(buffer, sizeof(buffer), "http://127.0.0.1:%hu/bytes/%zu", LoopbackServer_getPort(server), bodySize);
+
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(buffer));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    const struct Alligator_Counters before = Alligator_getCounters();
+    Http_FireResult result = HttpRequest_fire(&request);
+    const struct Alligator_Counters after = Alligator_getCounters();
+    assert_true(Http_FireResult_isOk(result));
+
+    // the body is not on the heap and outlives the response as long as it is shared
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    assert_true(after.bytes - before.bytes < bodySize);
+    assert_equal(bodySize, Text_length(HttpResponse_getBody(response)));
+    const struct HttpSharedText *body = HttpResponse_shareBody(response);
+    HttpResponse_delete(response);
+    TextView sut = HttpSharedText_get(body);
+    assert_equal(bodySize, Text_length(sut));
+    assert_equal('x', sut[bodySize - 1]);
+    HttpSharedText_release(body);
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
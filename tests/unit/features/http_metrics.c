@@ -0,0 +1,83 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdlib.h>
+#include <string.h>
+#include <traits/traits.h>
+#include <unit/features/http_metrics.h>
+
+static bool contains(TextView text, const char *line) {
+    return NULL != strstr(text, line);
+}
+
+Feature(HttpMetrics_record) {
+    const struct HttpTimings fast = {.total=100, .bytesUploaded=10, .bytesDownloaded=20};
+    const struct HttpTimings slow = {.total=3000000, .bytesDownloaded=5};
+
+    HttpMetrics_record("http://user@record.test:8080/path?query", HTTP_STATUS_OK, Ok, &fast);
+    HttpMetrics_record("https://record.test:8080", HTTP_STATUS_NOT_FOUND, Ok, &fast);
+    HttpMetrics_record("record.test:8080/", HTTP_STATUS_OK, HttpError_ConnectionFailed, &slow);
+
+    Text sut = Text_new();
+    Http_exportMetrics(&sut);
+    assert_true(contains(sut, "http_client_requests_total{host=\"record.test:8080\",class=\"2xx\"} 1\n"));
+    assert_true(contains(sut, "http_client_requests_total{host=\"record.test:8080\",class=\"4xx\"} 1\n"));
+    assert_true(contains(sut, "http_client_requests_total{host=\"record.test:8080\",class=\"error\"} 1\n"));
+    assert_true(contains(sut, "http_client_sent_bytes_total{host=\"record.test:8080\"} 20\n"));
+    assert_true(contains(sut, "http_client_received_bytes_total{host=\"record.test:8080\"} 45\n"));
+    Text_delete(sut);
+}
+
+Feature(Http_exportMetrics) {
+    for (uint64_t i = 1; i <= 1000; i++) {
+        const struct HttpTimings timings = {.total=i * 1000};
+        HttpMetrics_record("http://export.test", HTTP_STATUS_OK, Ok, &timings);
+    }
+
+    Text sut = Text_new();
+    Http_exportMetrics(&sut);
+    assert_true(contains(sut, "# TYPE http_client_request_duration_seconds histogram\n"));
+    assert_true(contains(sut, "http_client_request_duration_seconds_bucket{host=\"export.test\",le=\"0.000256\"} 0\n"));
+    assert_true(contains(sut, "http_client_request_duration_seconds_bucket{host=\"export.test\",le=\"0.065536\"} 65\n"));
+    assert_true(contains(sut, "http_client_request_duration_seconds_bucket{host=\"export.test\",le=\"+Inf\"} 1000\n"));
+    assert_true(contains(sut, "http_client_request_duration_seconds_sum{host=\"export.test\"} 500.500000\n"));
+    assert_true(contains(sut, "http_client_request_duration_seconds_count{host=\"export.test\"} 1000\n"));
+
+    // quantiles are accurate within the 12.5% resolution of the recorded buckets
+    const char *p50 = strstr(sut, "http_client_request_duration_quantile_seconds{host=\"export.test\",quantile=\"0.5\"} ");
+    assert_not_null(p50);
+    const double value = strtod(strchr(p50, '}') + 2, NULL);
+    assert_true(value > 0.5 * 0.875 && value < 0.5 * 1.125);
+    Text_delete(sut);
+}
+
+Feature(HttpMetrics_recordCost) {
+    static const struct HttpTimings timings = {.total=1500, .bytesDownloaded=512};
+    HttpMetrics_record("http://benchmark.test/path", HTTP_STATUS_OK, Ok, &timings);
+}
@@ -0,0 +1,235 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <string.h>
+#include <traits/traits.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_request.h>
+
+#define BODY_SIZE   (64 * 1024)
+#define UPLOAD_SIZE (32 * 1024 * 1024)
+
+static Atom urlOf(struct LoopbackServer *server) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "http://127.0.0.1:%hu/bytes/0", LoopbackServer_getPort(server));
+    return Atom_fromBytes(buffer, strlen(buffer));
+}
+
+static const struct HttpResponse *fire(struct HttpRequestBuilder *builder, size_t threshold) {
+    assert_equal(HTTP_REQUEST_BODY_RELEASE_THRESHOLD, HttpRequestBuilder_setBodyReleaseThreshold(builder, threshold));
+    HttpRequestBuilder_emplaceHeaders(builder, "Content-Type: text/plain");
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    assert_equal(threshold, HttpRequest_getBodyReleaseThreshold(request));
+
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(result));
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    assert_equal(HTTP_STATUS_OK, HttpResponse_getStatus(response));
+    return response;
+}
+
+static void assertReleased(const struct HttpResponse *response, Atom url) {
+    const struct HttpRequest *request = HttpResponse_getRequest(response);
+    assert_equal(HTTP_METHOD_POST, HttpRequest_getMethod(request));
+    assert_equal(url, HttpRequest_getUrl(request));
+    assert_string_equal("Content-Type: text/plain", HttpRequest_getHeaders(request));
+    assert_true(Text_isEmpty(HttpRequest_getBody(request)));
+    assert_null(HttpRequest_getRope(request));
+    assert_true(HttpRequest_getMemoryUsage(request) < BODY_SIZE);
+}
+
+Feature(HttpRequest_releaseBodyAfterFire) {
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    const Atom url = urlOf(server);
+
+    // bodies below the threshold stay with the request
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_POST, url);
+    HttpRequestBuilder_emplaceBody(builder, "small body");
+    const struct HttpResponse *response = fire(builder, BODY_SIZE);
+    assert_string_equal("small body", HttpRequest_getBody(HttpResponse_getRequest(response)));
+    HttpResponse_delete(response);
+
+    // bodies at or above the threshold are released once sent
+    builder = HttpRequestBuilder_new(HTTP_METHOD_POST, url);
+    Text body = Text_withCapacity(BODY_SIZE);
+    memset(body, 'x', BODY_SIZE);
+    Text_setLength(body, BODY_SIZE);
+    HttpRequestBuilder_setBody(builder, &body);
+    response = fire(builder, BODY_SIZE);
+    assertReleased(response, url);
+    HttpResponse_delete(response);
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpRequest_releaseRopeAfterFire) {
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    const Atom url = urlOf(server);
+
+    struct HttpRope *rope = HttpRope_new();
+    for (size_t i = 0; i < BODY_SIZE / 16; i++) {
+        HttpRope_appendLiteral(rope, "0123456789abcdef");
+    }
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_POST, url);
+    HttpRequestBuilder_setRope(builder, &rope);
+    const struct HttpResponse *response = fire(builder, 0);
+    assertReleased(response, url);
+    HttpResponse_delete(response);
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpRequestBuilder_setTimeouts) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral("http://127.0.0.1"));
+    assert_equal(0, HttpRequestBuilder_setConnectTimeout(builder, 100));
+    assert_equal(100, HttpRequestBuilder_setConnectTimeout(builder, 150));
+    assert_equal(0, HttpRequestBuilder_setFirstByteTimeout(builder, 200));
+    assert_equal(0, HttpRequestBuilder_setLowSpeedLimit(builder, 300));
+    assert_equal(0, HttpRequestBuilder_setLowSpeedTime(builder, 400));
+    assert_equal(0, HttpRequestBuilder_setTimeout(builder, 2));
+    assert_equal(2000, HttpRequestBuilder_setTotalTimeout(builder, 500));
+
+    // sub-second total timeouts read back in seconds rounded up, since 0 means no timeout
+    assert_equal(1, HttpRequestBuilder_setTimeout(builder, 0));
+    assert_equal(0, HttpRequestBuilder_setTotalTimeout(builder, 2001));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    assert_equal(150, HttpRequest_getConnectTimeout(request));
+    assert_equal(200, HttpRequest_getFirstByteTimeout(request));
+    assert_equal(2001, HttpRequest_getTotalTimeout(request));
+    assert_equal(3, HttpRequest_getTimeout(request));
+    assert_equal(300, HttpRequest_getLowSpeedLimit(request));
+    assert_equal(400, HttpRequest_getLowSpeedTime(request));
+    HttpRequest_delete(request);
+}
+
+static struct HttpRequestBuilder *newBuilder(struct LoopbackServer *server, enum HttpMethod method, const char *path) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "http://127.0.0.1:%hu%s", LoopbackServer_getPort(server), path);
+    return HttpRequestBuilder_new(method, Atom_fromBytes(buffer, strlen(buffer)));
+}
+
+static Error fireError(struct HttpRequestBuilder *builder) {
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    if (Http_FireResult_isOk(result)) {
+        HttpResponse_delete(Http_FireResult_unwrap(result));
+        return Ok;
+    }
+    HttpRequest_delete(request);
+    return Http_FireResult_unwrapError(result);
+}
+
+Feature(HttpRequest_timeouts) {
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+
+    // the first byte timeout covers the wait for the response headers
+    struct HttpRequestBuilder *builder = newBuilder(server, HTTP_METHOD_GET, "/delay/500");
+    HttpRequestBuilder_setFirstByteTimeout(builder, 100);
+    assert_equal(HttpError_FirstByteTimedOut, fireError(builder));
+    builder = newBuilder(server, HTTP_METHOD_GET, "/stall/300");
+    HttpRequestBuilder_setFirstByteTimeout(builder, 100);
+    assert_equal(Ok, fireError(builder));
+
+    // the total timeout covers the whole transfer once connected, the connect timeout only the connection
+    builder = newBuilder(server, HTTP_METHOD_GET, "/delay/500");
+    HttpRequestBuilder_setTotalTimeout(builder, 100);
+    assert_equal(HttpError_TransferTimedOut, fireError(builder));
+    builder = newBuilder(server, HTTP_METHOD_GET, "/delay/300");
+    HttpRequestBuilder_setConnectTimeout(builder, 100);
+    assert_equal(Ok, fireError(builder));
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpRequest_stall) {
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+
+    // responses whose body stops flowing
+    struct HttpRequestBuilder *builder = newBuilder(server, HTTP_METHOD_GET, "/stall/1000");
+    HttpRequestBuilder_setLowSpeedLimit(builder, 1);
+    HttpRequestBuilder_setLowSpeedTime(builder, 100);
+    assert_equal(HttpError_TransferStalled, fireError(builder));
+
+    // slow responses are not stalls while waiting for the first byte
+    builder = newBuilder(server, HTTP_METHOD_GET, "/delay/300");
+    HttpRequestBuilder_setLowSpeedLimit(builder, 1);
+    HttpRequestBuilder_setLowSpeedTime(builder, 100);
+    assert_equal(Ok, fireError(builder));
+
+    // requests whose body stops being read by the server, large enough to fill the socket buffers
+    builder = newBuilder(server, HTTP_METHOD_POST, "/stall/3000");
+    Text body = Text_withCapacity(UPLOAD_SIZE);
+    memset(body, 'x', UPLOAD_SIZE);
+    Text_setLength(body, UPLOAD_SIZE);
+    HttpRequestBuilder_setBody(builder, &body);
+    HttpRequestBuilder_emplaceHeaders(builder, "Expect:");
+    HttpRequestBuilder_setLowSpeedLimit(builder, 1024);
+    HttpRequestBuilder_setLowSpeedTime(builder, 100);
+    assert_equal(HttpError_TransferStalled, fireError(builder));
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpRequestBuilder_setKeepAlive) {
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+
+    // connections are kept alive by default
+    for (size_t i = 0; i < 3; i++) {
+        struct HttpRequestBuilder *builder = newBuilder(server, HTTP_METHOD_GET, "/bytes/16");
+        assert_equal(Ok, fireError(builder));
+    }
+    assert_equal(1, LoopbackServer_getConnections(server));
+
+    // requests opting out open a new connection and close it
+    for (size_t i = 0; i < 3; i++) {
+        struct HttpRequestBuilder *builder = newBuilder(server, HTTP_METHOD_GET, "/bytes/16");
+        assert_true(HttpRequestBuilder_setKeepAlive(builder, false));
+        assert_false(HttpRequestBuilder_setKeepAlive(builder, false));
+        assert_equal(Ok, fireError(builder));
+    }
+    assert_equal(4, LoopbackServer_getConnections(server));
+
+    // leaving the connection kept alive before untouched
+    struct HttpRequestBuilder *builder = newBuilder(server, HTTP_METHOD_GET, "/bytes/16");
+    assert_equal(Ok, fireError(builder));
+    assert_equal(4, LoopbackServer_getConnections(server));
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
@@ -0,0 +1,138 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <string.h>
+#include <traits/traits.h>
+#include <alligator/alligator.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_response.h>
+
+static const struct HttpResponse *newResponse(void) {
+    struct HttpRequestBuilder *requestBuilder = HttpRequestBuilder_new(HTTP_METHOD_POST,
+                                                                       Atom_fromLiteral("http://compact.test"));
+    HttpRequestBuilder_emplaceHeaders(requestBuilder, "Content-Type: text/plain");
+    HttpRequestBuilder_emplaceBody(requestBuilder, "request body");
+    const struct HttpRequest *request = HttpRequestBuilder_build(&requestBuilder);
+
+    struct HttpResponseBuilder *responseBuilder = HttpResponseBuilder_new(&request);
+    HttpResponseBuilder_setStatus(responseBuilder, HTTP_STATUS_CREATED);
+    HttpResponseBuilder_setTimings(responseBuilder, (struct HttpTimings) {.total=42});
+    Text headers = Text_withCapacity(1024);
+    headers = Text_appendLiteral(&headers, "HTTP/1.1 201 Created\r\nContent-Length: 13\r\n\r\n");
+    HttpResponseBuilder_setHeaders(responseBuilder, &headers);
+    HttpResponseBuilder_emplaceBody(responseBuilder, "response body");
+    return HttpResponseBuilder_build(&responseBuilder);
+}
+
+Feature(HttpResponse_compact) {
+    const struct HttpResponse *response = newResponse();
+    const struct HttpSharedText *body = HttpResponse_shareBody(response);
+
+    const struct Alligator_Counters before = Alligator_getCounters();
+    const struct HttpResponse *sut = HttpResponse_compact(&response, false);
+    const struct Alligator_Counters after = Alligator_getCounters();
+    assert_null(response);
+    assert_equal(1, after.allocations - before.allocations);
+
+    assert_equal(HTTP_STATUS_CREATED, HttpResponse_getStatus(sut));
+    assert_string_equal("http://compact.test", HttpResponse_getUrl(sut));
+    assert_equal(42, HttpResponse_getTimings(sut).total);
+    assert_string_equal("HTTP/1.1 201 Created\r\nContent-Length: 13\r\n\r\n", HttpResponse_getHeaders(sut));
+    assert_equal(Text_length(HttpResponse_getHeaders(sut)), Text_capacity(HttpResponse_getHeaders(sut)));
+    assert_string_equal("response body", HttpResponse_getBody(sut));
+    assert_equal(13, Text_length(HttpResponse_getBody(sut)));
+    assert_string_equal("request body", HttpRequest_getBody(HttpResponse_getRequest(sut)));
+
+    // bodies shared before compaction outlive the original response
+    assert_string_equal("response body", HttpSharedText_get(body));
+    HttpSharedText_release(body);
+
+    // compacting twice drops the request body keeping everything else
+    sut = HttpResponse_compact(&sut, true);
+    const struct HttpRequest *request = HttpResponse_getRequest(sut);
+    assert_true(Text_isEmpty(HttpRequest_getBody(request)));
+    assert_string_equal("Content-Type: text/plain", HttpRequest_getHeaders(request));
+    assert_equal(HTTP_METHOD_POST, HttpRequest_getMethod(request));
+    assert_string_equal("response body", HttpResponse_getBody(sut));
+    HttpResponse_delete(sut);
+}
+
+Feature(HttpResponse_getMemoryUsage) {
+    const struct HttpResponse *sut = newResponse();
+    const size_t requestUsage = HttpRequest_getMemoryUsage(HttpResponse_getRequest(sut));
+    const size_t usage = HttpResponse_getMemoryUsage(sut);
+    assert_true(usage > requestUsage + 1024);
+
+    sut = HttpResponse_compact(&sut, true);
+    const size_t compactedRequestUsage = HttpRequest_getMemoryUsage(HttpResponse_getRequest(sut));
+    const size_t compactedUsage = HttpResponse_getMemoryUsage(sut);
+    assert_true(compactedRequestUsage < requestUsage);
+    assert_true(compactedUsage < usage - 1024);
+    assert_true(compactedUsage - compactedRequestUsage < 512);
+    HttpResponse_delete(sut);
+}
+
+Feature(HttpResponse_getTimings) {
+    char url[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%hu/delay/100", LoopbackServer_getPort(server));
+
+    for (size_t i = 0; i < 2; i++) {
+        struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_POST, Atom_fromLiteral(url));
+        HttpRequestBuilder_emplaceBody(builder, "request body");
+        const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+        Http_FireResult result = HttpRequest_fire(&request);
+        assert_true(Http_FireResult_isOk(result));
+        const struct HttpResponse *response = Http_FireResult_unwrap(result);
+        const struct HttpTimings timings = HttpResponse_getTimings(response);
+
+        // phases follow each other and, without redirects, add up to the total (on a new and a reused connection)
+        const uint64_t connected = timings.dns + timings.connect + timings.tls;
+        const uint64_t sent = connected + timings.pretransfer;
+        const uint64_t answered = sent + timings.firstByte;
+        assert_true(timings.dns <= connected && connected <= sent && sent <= answered);
+        assert_true(answered <= timings.total);
+        assert_equal(timings.total, answered + timings.transfer);
+        assert_equal(0, timings.tls);
+        assert_equal(0, timings.redirect);
+        assert_true(timings.firstByte >= 100 * 1000);
+
+        assert_equal(strlen("request body"), timings.bytesUploaded);
+        assert_equal(Text_length(HttpResponse_getBody(response)), timings.bytesDownloaded);
+        assert_equal(16, timings.bytesDownloaded);
+        assert_equal(Text_length(HttpResponse_getHeaders(response)), timings.headerBytes);
+        HttpResponse_delete(response);
+    }
+    assert_equal(1, LoopbackServer_getConnections(server));
+
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
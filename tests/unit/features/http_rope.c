@@ -0,0 +1,77 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <traits/traits.h>
+#include <unit/features/http_rope.h>
+
+Feature(HttpRope_append) {
+    struct HttpRope *sut = HttpRope_withSegmentSize(8);
+    assert_equal(HttpRope_length(sut), 0);
+
+    HttpRope_appendLiteral(sut, "0123456789");
+    assert_equal(HttpRope_length(sut), 10);
+
+    HttpRope_appendFormat(sut, "%s-%d", "abc", 42);
+    assert_equal(HttpRope_length(sut), 16);
+
+    HttpRope_appendFormat(sut, "%s", "a formatted string longer than a segment");
+    assert_equal(HttpRope_length(sut), 56);
+
+    char buffer[64] = {0};
+    HttpRope_Cursor cursor = HttpRope_begin(sut);
+    assert_equal(HttpRope_read(sut, &cursor, buffer, sizeof(buffer)), 56);
+    assert_string_equal(buffer, "0123456789abc-42a formatted string longer than a segment");
+
+    HttpRope_delete(sut);
+}
+
+Feature(HttpRope_read) {
+    struct HttpRope *sut = HttpRope_withSegmentSize(4);
+    HttpRope_appendLiteral(sut, "abcdefghijklmnopqrstuvwxyz");
+
+    char buffer[32] = {0};
+    HttpRope_Cursor cursor = HttpRope_begin(sut);
+    assert_equal(HttpRope_read(sut, &cursor, buffer, 3), 3);
+    assert_equal(HttpRope_read(sut, &cursor, buffer + 3, 6), 6);
+    assert_string_equal(buffer, "abcdefghi");
+
+    assert_true(HttpRope_seek(sut, &cursor, 24));
+    memset(buffer, 0, sizeof(buffer));
+    assert_equal(HttpRope_read(sut, &cursor, buffer, sizeof(buffer)), 2);
+    assert_string_equal(buffer, "yz");
+    assert_equal(HttpRope_read(sut, &cursor, buffer, sizeof(buffer)), 0);
+
+    assert_false(HttpRope_seek(sut, &cursor, 27));
+    assert_true(HttpRope_seek(sut, &cursor, 8));
+    memset(buffer, 0, sizeof(buffer));
+    assert_equal(HttpRope_read(sut, &cursor, buffer, 4), 4);
+    assert_string_equal(buffer, "ijkl");
+
+    HttpRope_delete(sut);
+}
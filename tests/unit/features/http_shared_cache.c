@@ -0,0 +1,221 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <traits/traits.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_shared_cache.h>
+
+#define CAPACITY    (1024 * 1024)
+
+static const struct HttpResponse *get(const char *url) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(url));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isOk(result));
+    const struct HttpResponse *response = Http_FireResult_unwrap(result);
+    assert_equal(HTTP_STATUS_OK, HttpResponse_getStatus(response));
+    assert_string_equal("xxxxxxxxxxxxxxxx", HttpResponse_getBody(response));
+    return response;
+}
+
+static void awaitChild(const pid_t child) {
+    int status = 0;
+    assert_equal(child, waitpid(child, &status, 0));
+    assert_true(WIFEXITED(status) && EXIT_SUCCESS == WEXITSTATUS(status));
+}
+
+static bool store(uint64_t key, size_t size) {
+    char *bytes = malloc(size);
+    assert_not_null(bytes);
+    memset(bytes, (int) (key & 0xff), size);
+    const struct iovec part = {.iov_base=bytes, .iov_len=size};
+    const bool stored = HttpSharedCache_store(key, key, (struct HttpCacheFreshness) {.lifetime=60}, &part, 1);
+    free(bytes);
+    return stored;
+}
+
+// Returns the size of the response stored with key, 0 if not found, checking that it has been copied whole.
+static size_t find(uint64_t key) {
+    struct HttpCacheFreshness freshness;
+    uint64_t variant;
+    size_t cursor = 0, size = 0;
+    unsigned char *copy = HttpSharedCache_find(key, &cursor, &size, &variant, &freshness);
+    if (NULL == copy) {
+        return 0;
+    }
+    assert_equal(key, variant);
+    for (size_t i = 0; i < size; i++) {
+        assert_equal(key & 0xff, copy[i]);
+    }
+    assert_equal(0, munmap(copy, size));
+    return size;
+}
+
+Feature(Http_openSharedCache) {
+    char fresh[64], stale[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(fresh, sizeof(fresh), "http://127.0.0.1:%hu/cache/60", LoopbackServer_getPort(server));
+    snprintf(stale, sizeof(stale), "http://127.0.0.1:%hu/cache/0", LoopbackServer_getPort(server));
+    assert_false(Http_isSharedCacheOpen());
+
+    // opened before forking, the segment is shared with the workers; their in-memory caches stay disabled
+    assert_true(Http_openSharedCache(NULL, CAPACITY));
+    assert_true(Http_isSharedCacheOpen());
+    const pid_t child = fork();
+    assert_true(child >= 0);
+    if (0 == child) {
+        HttpResponse_delete(get(fresh));
+        HttpResponse_delete(get(stale));
+        _exit(2 == Http_getSharedCacheStats().stores ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    awaitChild(child);
+    assert_equal(2, LoopbackServer_getRequests(server));
+    assert_equal(2, Http_getSharedCacheStats().entries);
+
+    // responses fetched by the other worker are served from the segment, stale ones are revalidated
+    const struct HttpResponse *response = get(fresh);
+    assert_equal(0, HttpResponse_getTimings(response).total);
+    assert_true(Text_startsWith(HttpResponse_getHeaders(response), "HTTP/1.1 200 OK\r\n", 17));
+    HttpResponse_delete(response);
+    assert_equal(2, LoopbackServer_getRequests(server));
+    response = get(stale);
+    assert_true(HttpResponse_getTimings(response).total > 0);
+    HttpResponse_delete(response);
+    assert_equal(3, LoopbackServer_getRequests(server));
+
+    const struct HttpCacheStats stats = Http_getCacheStats();
+    assert_equal(1, stats.hits);
+    assert_equal(2, stats.sharedLoads);
+    assert_equal(1, stats.revalidations);
+    assert_equal(0, stats.entries);
+    assert_equal(2, Http_getSharedCacheStats().stores);
+
+    Http_closeSharedCache();
+    assert_false(Http_isSharedCacheOpen());
+    assert_equal(0, Http_getSharedCacheStats().entries);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpSharedCache_named) {
+    char name[64];
+    snprintf(name, sizeof(name), "/http-shared-cache-%ld", (long) getpid());
+    assert_true(Http_openSharedCache(name, CAPACITY));
+    assert_true(store(1, 128));
+
+    // unrelated processes attach to the segment by name, with the same capacity
+    const pid_t child = fork();
+    assert_true(child >= 0);
+    if (0 == child) {
+        Http_closeSharedCache();
+        if (Http_openSharedCache(name, CAPACITY / 2)) {
+            _exit(EXIT_FAILURE);
+        }
+        _exit(Http_openSharedCache(name, CAPACITY) && 128 == find(1) && store(2, 256) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    awaitChild(child);
+    assert_equal(256, find(2));
+    assert_equal(2, Http_getSharedCacheStats().stores);
+
+    // the segment outlives its processes until unlinked
+    Http_closeSharedCache();
+    assert_true(Http_openSharedCache(name, CAPACITY));
+    assert_equal(2, Http_getSharedCacheStats().entries);
+    Http_closeSharedCache();
+    assert_true(Http_unlinkSharedCache(name));
+    assert_true(Http_openSharedCache(name, CAPACITY));
+    assert_equal(0, Http_getSharedCacheStats().entries);
+    Http_closeSharedCache();
+    assert_true(Http_unlinkSharedCache(name));
+    assert_false(Http_unlinkSharedCache(name));
+}
+
+Feature(HttpSharedCache_overwrite) {
+    assert_true(Http_openSharedCache(NULL, 16 * 1024));
+    assert_false(store(1, 4097));
+
+    // the ring overwrites the oldest responses once full
+    for (uint64_t key = 1; key <= 64; key++) {
+        assert_true(store(key, 1000));
+    }
+    struct HttpSharedCacheStats stats = Http_getSharedCacheStats();
+    assert_equal(64, stats.stores);
+    assert_true(stats.entries > 0 && stats.entries <= 16);
+    assert_equal(stats.entries * 1000, stats.bytes);
+    assert_equal(0, find(1));
+    assert_equal(1000, find(64));
+
+    // storing a response again replaces it, which may overwrite the oldest response as well
+    assert_true(store(64, 500));
+    assert_equal(500, find(64));
+    assert_true(Http_getSharedCacheStats().entries <= stats.entries);
+
+    // refreshes update the freshness in place
+    HttpSharedCache_refresh(64, 64, (struct HttpCacheFreshness) {.lifetime=120, .noCache=true});
+    struct HttpCacheFreshness freshness;
+    uint64_t variant;
+    size_t cursor = 0, size = 0;
+    void *copy = HttpSharedCache_find(64, &cursor, &size, &variant, &freshness);
+    assert_not_null(copy);
+    assert_equal(120, freshness.lifetime);
+    assert_true(freshness.noCache);
+    assert_equal(0, munmap(copy, size));
+    Http_closeSharedCache();
+}
+
+Feature(HttpSharedCache_concurrent) {
+    assert_true(Http_openSharedCache(NULL, 64 * 1024));
+    const time_t deadline = time(NULL) + 1;
+
+    // a writer keeps overwriting the ring while readers check that every copy they get is whole
+    const pid_t child = fork();
+    assert_true(child >= 0);
+    if (0 == child) {
+        srand(1);
+        for (uint64_t i = 0; time(NULL) <= deadline; i++) {
+            (void) store(1 + i % 32, 1 + (size_t) rand() % (16 * 1024));
+        }
+        _exit(EXIT_SUCCESS);
+    }
+    size_t found = 0;
+    for (uint64_t i = 0; time(NULL) <= deadline; i++) {
+        found += 0 != find(1 + i % 32);
+    }
+    awaitChild(child);
+    assert_true(found > 0);
+    Http_closeSharedCache();
+}
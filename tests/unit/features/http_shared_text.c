@@ -0,0 +1,63 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <traits/traits.h>
+#include <unit/features/http_shared_text.h>
+
+Feature(HttpSharedText_new) {
+    Text text = Text_fromLiteral("shared");
+    TextView view = text;
+
+    const struct HttpSharedText *sut = HttpSharedText_new(&text);
+    assert_null(text);
+    assert_equal(HttpSharedText_get(sut), view);
+
+    const struct HttpSharedText *other = HttpSharedText_retain(sut);
+    assert_equal(other, sut);
+
+    HttpSharedText_release(sut);
+    assert_string_equal(HttpSharedText_get(other), "shared");
+    HttpSharedText_release(other);
+}
+
+Feature(HttpResponse_shareBody) {
+    struct HttpRequestBuilder *requestBuilder = HttpRequestBuilder_new(HTTP_METHOD_GET,
+                                                                       Atom_fromLiteral("http://localhost"));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&requestBuilder);
+    struct HttpResponseBuilder *responseBuilder = HttpResponseBuilder_new(&request);
+    HttpResponseBuilder_emplaceBody(responseBuilder, "%s", "response body");
+    const struct HttpResponse *response = HttpResponseBuilder_build(&responseBuilder);
+
+    const struct HttpSharedText *sut = HttpResponse_shareBody(response);
+    assert_equal(HttpSharedText_get(sut), HttpResponse_getBody(response));
+
+    HttpResponse_delete(response);
+    assert_string_equal(HttpSharedText_get(sut), "response body");
+    HttpSharedText_release(sut);
+}
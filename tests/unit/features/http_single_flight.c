@@ -0,0 +1,243 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <traits/traits.h>
+#include <loopback/loopback_server.h>
+#include <unit/features/http_single_flight.h>
+
+#define THREADS     8
+
+struct Caller {
+    pthread_t thread;
+    pthread_barrier_t *barrier;
+    const char *url;
+    const char *headers;
+    const struct HttpResponse *response;
+};
+
+static const struct HttpRequest *newRequest(enum HttpMethod method, const char *url, const char *headers) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(method, Atom_fromLiteral(url));
+    if (NULL != headers) {
+        HttpRequestBuilder_emplaceHeaders(builder, "%s", headers);
+    }
+    return HttpRequestBuilder_build(&builder);
+}
+
+static void *call(void *argument) {
+    struct Caller *caller = argument;
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, caller->url, caller->headers);
+    pthread_barrier_wait(caller->barrier);
+    Http_FireResult result = HttpRequest_fire(&request);
+    caller->response = Http_FireResult_isOk(result) ? Http_FireResult_unwrap(result) : NULL;
+    return NULL;
+}
+
+// Fires concurrently one request per caller, returning the number of distinct bodies received.
+static size_t fireAll(struct Caller *callers, const size_t length) {
+    pthread_barrier_t barrier;
+    assert_equal(0, pthread_barrier_init(&barrier, NULL, (unsigned) length));
+    for (size_t i = 0; i < length; i++) {
+        callers[i].barrier = &barrier;
+        assert_equal(0, pthread_create(&callers[i].thread, NULL, call, &callers[i]));
+    }
+    size_t bodies = 0;
+    for (size_t i = 0; i < length; i++) {
+        assert_equal(0, pthread_join(callers[i].thread, NULL));
+        assert_not_null(callers[i].response);
+        assert_equal(HTTP_STATUS_OK, HttpResponse_getStatus(callers[i].response));
+        assert_string_equal("xxxxxxxxxxxxxxxx", HttpResponse_getBody(callers[i].response));
+        bool shared = false;
+        for (size_t j = 0; j < i && !shared; j++) {
+            shared = HttpResponse_getBody(callers[i].response) == HttpResponse_getBody(callers[j].response);
+        }
+        bodies += !shared;
+    }
+    for (size_t i = 0; i < length; i++) {
+        HttpResponse_delete(callers[i].response);
+    }
+    pthread_barrier_destroy(&barrier);
+    return bodies;
+}
+
+static bool accepts(enum HttpMethod method, const char *body) {
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(method, Atom_fromLiteral("http://flight.test"));
+    if (NULL != body) {
+        HttpRequestBuilder_emplaceBody(builder, "%s", body);
+    }
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    const bool accepted = HttpSingleFlight_accepts(request);
+    HttpRequest_delete(request);
+    return accepted;
+}
+
+Feature(Http_setSingleFlight) {
+    assert_false(Http_isSingleFlightEnabled());
+    assert_false(accepts(HTTP_METHOD_GET, NULL));
+
+    assert_false(Http_setSingleFlight(true));
+    assert_true(Http_isSingleFlightEnabled());
+    assert_true(accepts(HTTP_METHOD_GET, NULL));
+    assert_true(accepts(HTTP_METHOD_HEAD, NULL));
+    assert_false(accepts(HTTP_METHOD_GET, "body"));
+    assert_false(accepts(HTTP_METHOD_POST, NULL));
+    assert_false(accepts(HTTP_METHOD_DELETE, NULL));
+
+    assert_true(Http_setSingleFlight(false));
+    assert_false(accepts(HTTP_METHOD_GET, NULL));
+}
+
+Feature(HttpSingleFlight_fire) {
+    char url[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%hu/delay/300", LoopbackServer_getPort(server));
+    struct Caller callers[THREADS];
+
+    // without coalescing every request gets its own transfer
+    for (size_t i = 0; i < THREADS; i++) {
+        callers[i] = (struct Caller) {.url=url, .headers=NULL};
+    }
+    assert_equal(THREADS, fireAll(callers, THREADS));
+    assert_equal(0, Http_getSingleFlightStats().flights);
+
+    // identical requests in flight share the transfer and the body of the first one
+    (void) Http_setSingleFlight(true);
+    const size_t bodies = fireAll(callers, THREADS);
+    struct HttpSingleFlightStats stats = Http_getSingleFlightStats();
+    assert_equal(bodies, stats.flights);
+    assert_equal(THREADS, stats.flights + stats.followers);
+    assert_true(stats.followers > 0);
+
+    // requests with distinct headers do not
+    for (size_t i = 0; i < THREADS; i++) {
+        callers[i].headers = 0 == i % 2 ? "Accept: text/plain" : "Accept: text/html";
+    }
+    assert_true(fireAll(callers, THREADS) >= 2);
+    assert_true(Http_getSingleFlightStats().flights >= stats.flights + 2);
+
+    (void) Http_setSingleFlight(false);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
+
+Feature(HttpFlight_land) {
+    (void) Http_setSingleFlight(true);
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, "http://flight.test", NULL);
+    const struct HttpRequest *first = newRequest(HTTP_METHOD_GET, "http://flight.test", NULL);
+    const struct HttpRequest *second = newRequest(HTTP_METHOD_GET, "http://flight.test", NULL);
+
+    // followers get the error of the leader, their requests left untouched
+    bool leader = false;
+    struct HttpFlight *flight = HttpSingleFlight_join(request, &leader);
+    assert_true(leader);
+    struct HttpFlight *other = HttpSingleFlight_join(first, &leader);
+    assert_false(leader);
+    assert_equal(flight, other);
+    HttpFlight_land(flight, Http_FireResult_error(HttpError_ConnectionFailed));
+    Http_FireResult failure = HttpFlight_await(other, &first);
+    assert_true(Http_FireResult_isError(failure));
+    assert_equal(HttpError_ConnectionFailed, Http_FireResult_unwrapError(failure));
+    assert_not_null(first);
+
+    // landed flights are left, followers of the next one get a response of their own sharing the body
+    flight = HttpSingleFlight_join(first, &leader);
+    assert_true(leader);
+    other = HttpSingleFlight_join(second, &leader);
+    assert_false(leader);
+    struct HttpResponseBuilder *builder = HttpResponseBuilder_new(&first);
+    HttpResponseBuilder_setStatus(builder, HTTP_STATUS_CREATED);
+    HttpResponseBuilder_emplaceHeaders(builder, "HTTP/1.1 201 Created\r\n\r\n");
+    HttpResponseBuilder_emplaceBody(builder, "shared");
+    const struct HttpResponse *response = HttpResponseBuilder_build(&builder);
+    HttpFlight_land(flight, Http_FireResult_ok(response));
+    Http_FireResult success = HttpFlight_await(other, &second);
+    assert_true(Http_FireResult_isOk(success));
+    assert_null(second);
+    const struct HttpResponse *shared = Http_FireResult_unwrap(success);
+    HttpResponse_delete(response);
+    assert_equal(HTTP_STATUS_CREATED, HttpResponse_getStatus(shared));
+    assert_string_equal("HTTP/1.1 201 Created\r\n\r\n", HttpResponse_getHeaders(shared));
+    assert_string_equal("shared", HttpResponse_getBody(shared));
+    HttpResponse_delete(shared);
+
+    assert_equal(2, Http_getSingleFlightStats().flights);
+    assert_equal(2, Http_getSingleFlightStats().followers);
+    HttpRequest_delete(request);
+    (void) Http_setSingleFlight(false);
+}
+
+static void *fireLeader(void *argument) {
+    struct Caller *caller = argument;
+    const struct HttpRequest *request = newRequest(HTTP_METHOD_GET, caller->url, NULL);
+    Http_FireResult result = HttpRequest_fire(&request);
+    caller->response = Http_FireResult_isOk(result) ? Http_FireResult_unwrap(result) : NULL;
+    return NULL;
+}
+
+Feature(HttpFlight_await) {
+    char url[64];
+    Http_initialize();
+    struct LoopbackServer *server = LoopbackServer_start(true);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%hu/delay/1000", LoopbackServer_getPort(server));
+    (void) Http_setSingleFlight(true);
+    struct Caller leader = {.url=url, .headers=NULL, .response=NULL};
+    assert_equal(0, pthread_create(&leader.thread, NULL, fireLeader, &leader));
+    while (0 == Http_getSingleFlightStats().flights) {
+        usleep(1000);
+    }
+
+    // followers give up on their own total timeout, the flight goes on for the others
+    struct HttpRequestBuilder *builder = HttpRequestBuilder_new(HTTP_METHOD_GET, Atom_fromLiteral(url));
+    (void) HttpRequestBuilder_setTotalTimeout(builder, 100);
+    const struct HttpRequest *request = HttpRequestBuilder_build(&builder);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Http_FireResult result = HttpRequest_fire(&request);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    assert_true(Http_FireResult_isError(result));
+    assert_equal(HttpError_TransferTimedOut, Http_FireResult_unwrapError(result));
+    assert_not_null(request);
+    assert_equal(1, Http_getSingleFlightStats().followers);
+    const long elapsed = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    assert_true(elapsed >= 100 && elapsed < 800);
+
+    assert_equal(0, pthread_join(leader.thread, NULL));
+    assert_not_null(leader.response);
+    assert_string_equal("xxxxxxxxxxxxxxxx", HttpResponse_getBody(leader.response));
+    HttpResponse_delete(leader.response);
+    HttpRequest_delete(request);
+    (void) Http_setSingleFlight(false);
+    LoopbackServer_stop(server);
+    Http_terminate();
+}
@@ -0,0 +1,99 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <string.h>
+#include <traits/traits.h>
+#include <unit/features/http_slow_log.h>
+
+static size_t countLines(TextView text) {
+    size_t lines = 0;
+    for (const char *c = strchr(text, '\n'); NULL != c; c = strchr(c + 1, '\n')) {
+        lines++;
+    }
+    return lines;
+}
+
+Feature(HttpSlowLog_record) {
+    const struct HttpTimings fast = {.total=9999};
+    const struct HttpTimings slow = {.total=10000, .firstByte=8000, .bytesDownloaded=42};
+
+    Http_clearSlowRequests();
+    assert_equal(Http_setSlowRequestThreshold(10), 0);
+    HttpSlowLog_record("GET", "http://slow.test/fast", HTTP_STATUS_OK, Ok, &fast, false);
+    HttpSlowLog_record("GET", "http://slow.test/slow", HTTP_STATUS_OK, Ok, &slow, true);
+    HttpSlowLog_record("POST", "http://slow.test/failed", HTTP_STATUS_OK, HttpError_TransferTimedOut, &slow, false);
+
+    Text sut = Text_new();
+    Http_getSlowRequests(&sut);
+    assert_equal(countLines(sut), 2);
+    assert_null(strstr(sut, "/fast"));
+    assert_not_null(strstr(sut, " GET http://slow.test/slow 200 total=10000us "));
+    assert_not_null(strstr(sut, " firstByte=8000 "));
+    assert_not_null(strstr(sut, " received=42 sent=0 reused=yes\n"));
+    assert_not_null(strstr(sut, " POST http://slow.test/failed \"Transfer timed out\" total=10000us "));
+    assert_true(strstr(sut, "/slow") < strstr(sut, "/failed"));
+    Text_delete(sut);
+
+    // the log is bounded, the oldest entries get overwritten
+    for (size_t i = 0; i < HTTP_SLOW_LOG_SIZE; i++) {
+        HttpSlowLog_record("GET", "http://slow.test/many", HTTP_STATUS_OK, Ok, &slow, false);
+    }
+    sut = Text_new();
+    Http_getSlowRequests(&sut);
+    assert_equal(countLines(sut), HTTP_SLOW_LOG_SIZE);
+    assert_null(strstr(sut, "/failed"));
+    Text_delete(sut);
+
+    Http_clearSlowRequests();
+    Http_setSlowRequestThreshold(0);
+}
+
+Feature(Http_setSlowRequestSampleRate) {
+    const struct HttpTimings slow = {.total=1000000};
+
+    Http_clearSlowRequests();
+    Http_setSlowRequestThreshold(1);
+    assert_equal(Http_setSlowRequestSampleRate(0.0), 1.0);
+    HttpSlowLog_record("GET", "http://slow.test/sampled", HTTP_STATUS_OK, Ok, &slow, false);
+
+    Text sut = Text_new();
+    Http_getSlowRequests(&sut);
+    assert_true(Text_isEmpty(sut));
+    Text_delete(sut);
+
+    assert_equal(Http_setSlowRequestSampleRate(2.0), 0.0);
+    HttpSlowLog_record("GET", "http://slow.test/sampled", HTTP_STATUS_OK, Ok, &slow, false);
+    sut = Text_new();
+    Http_getSlowRequests(&sut);
+    assert_equal(countLines(sut), 1);
+    Text_delete(sut);
+
+    Http_clearSlowRequests();
+    Http_setSlowRequestThreshold(0);
+}
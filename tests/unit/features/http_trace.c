@@ -0,0 +1,64 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <string.h>
+#include <traits/traits.h>
+#include <unit/features/http_trace.h>
+
+Feature(Http_setTracing) {
+    const bool initial = Http_isTracing();
+    assert_equal(Http_setTracing(true), initial);
+    assert_true(Http_isTracing());
+    assert_true(Http_setTracing(false));
+    assert_false(Http_isTracing());
+    Http_setTracing(initial);
+}
+
+Feature(Http_dumpTrace) {
+    const bool initial = Http_setTracing(true);
+    Http_initialize();
+
+    // nothing listens on port 1, the connection is refused right away
+    struct HttpRequestBuilder *requestBuilder = HttpRequestBuilder_new(HTTP_METHOD_GET,
+                                                                       Atom_fromLiteral("http://127.0.0.1:1"));
+    const struct HttpRequest *request = HttpRequestBuilder_build(&requestBuilder);
+    Http_FireResult result = HttpRequest_fire(&request);
+    assert_true(Http_FireResult_isError(result));
+    HttpRequest_delete(request);
+
+    Text sut = Text_new();
+    Http_dumpTrace(&sut);
+    assert_not_null(strstr(sut, "thread "));
+    assert_not_null(strstr(sut, " started GET http://127.0.0.1:1\n"));
+    assert_not_null(strstr(sut, " failed "));
+    Text_delete(sut);
+
+    Http_terminate();
+    Http_setTracing(initial);
+}
@@ -0,0 +1,115 @@
+/*
+ * Author: daddinuz
+ * email:  daddinuz@gmail.com
+ *
+ * Copyright (c) 2018 Davide Di Carlo
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <http.h>
+#include <traits/traits.h>
+#include <unit/features/text.h>
+
+Feature(Text_quoted) {
+    {
+        Text sut = Text_quoted("", 0);
+        assert_string_equal(sut, "\"\"");
+        assert_equal(Text_length(sut), 2);
+        Text_delete(sut);
+    }
+
+    {
+        const char bytes[] = "say \"hi\"\\/\b\f\n\r\t\x01\x7f\xff";
+        Text sut = Text_quoted(bytes, sizeof(bytes) - 1);
+        assert_string_equal(sut, "\"say \\\"hi\\\"\\\\\\/\\b\\f\\n\\r\\t\\u0001\\u007f\\u00ff\"");
+        assert_equal(Text_length(sut), strlen(sut));
+        Text_delete(sut);
+    }
+
+    {
+        // escapes must be detected at every offset of the vectorized blocks
+        char bytes[97];
+        for (size_t position = 0; position < sizeof(bytes); position++) {
+            memset(bytes, 'a', sizeof(bytes));
+            bytes[position] = '"';
+            Text sut = Text_quoted(bytes, sizeof(bytes));
+            assert_equal(Text_length(sut), sizeof(bytes) + 3);
+            assert_equal(sut[position + 1], '\\');
+            assert_equal(sut[position + 2], '"');
+            Text_delete(sut);
+        }
+    }
+}
+
+Feature(Text_trim) {
+    {
+        Text sut = Text_fromLiteral(" \t\r\n  Content-Type: application/json \r\n\x7f");
+        Text_trim(sut);
+        assert_string_equal(sut, "Content-Type: application/json");
+        assert_equal(Text_length(sut), strlen(sut));
+        Text_delete(sut);
+    }
+
+    {
+        Text sut = Text_fromLiteral("\r\n \t \r\n \t \r\n \t \r\n \t \r\n \t \r\n");
+        Text_trim(sut);
+        assert_true(Text_isEmpty(sut));
+        Text_delete(sut);
+    }
+
+    {
+        Text sut = Text_fromLiteral("                                   x                                   ");
+        Text_trimLeft(sut);
+        assert_equal(Text_length(sut), 36);
+        Text_trimRight(sut);
+        assert_string_equal(sut, "x");
+        Text_delete(sut);
+    }
+}
+
+Feature(Text_lower) {
+    Text sut = Text_fromLiteral("X-Request-ID: AbCdEfGhIjKlMnOpQrStUvWxYz@[`{ \xc0\xdd");
+    Text_lower(sut);
+    assert_string_equal(sut, "x-request-id: abcdefghijklmnopqrstuvwxyz@[`{ \xc0\xdd");
+    Text_upper(sut);
+    assert_string_equal(sut, "X-REQUEST-ID: ABCDEFGHIJKLMNOPQRSTUVWXYZ@[`{ \xc0\xdd");
+    Text_delete(sut);
+}
+
+Feature(Text_equalsIgnoreCase) {
+    Text sut = Text_fromLiteral("Content-Type: Application/JSON; charset=UTF-8");
+    Text other = Text_fromLiteral("content-type: application/json; CHARSET=utf-8");
+    assert_true(Text_equalsIgnoreCase(sut, other));
+    assert_false(Text_equals(sut, other));
+    Text_put(other, Text_length(other) - 1, '9');
+    assert_false(Text_equalsIgnoreCase(sut, other));
+
+    assert_true(Text_startsWith(sut, "Content-Type:", 13));
+    assert_false(Text_startsWith(sut, "content-type:", 13));
+    assert_true(Text_startsWithIgnoreCase(sut, "CONTENT-TYPE:", 13));
+    assert_false(Text_startsWithIgnoreCase(sut, "Content-Length:", 15));
+    assert_false(Text_startsWithIgnoreCase(sut, "Content-Type: Application/JSON; charset=UTF-8!", 46));
+
+    Text_delete(other);
+    Text_delete(sut);
+}